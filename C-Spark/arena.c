@@ -0,0 +1,115 @@
+// arena.c
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT (2 * sizeof(void*))
+
+void arena_init(Arena* arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK;
+}
+
+// Add a block with room for `size` bytes at `alignment`, or return NULL if memory
+// runs out. A block made for one oversized request goes behind the current
+// block, which may still have room.
+static ArenaBlock* arena_add_block(Arena* arena, size_t size, size_t alignment) {
+    size_t capacity = size + alignment > arena->block_size ? size + alignment : arena->block_size;
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + capacity);
+    if (!block) {
+        return NULL;
+    }
+    block->used = 0;
+    block->size = capacity;
+    if (arena->head && capacity > arena->block_size) {
+        block->next = arena->head->next;
+        arena->head->next = block;
+    }
+    else {
+        block->next = arena->head;
+        arena->head = block;
+    }
+    return block;
+}
+
+// Offset of the first `alignment`-aligned byte at or after block->used
+static size_t arena_align(const ArenaBlock* block, size_t alignment) {
+    size_t address = (size_t)(block->data + block->used);
+    return block->used + ((alignment - address % alignment) % alignment);
+}
+
+static void* arena_alloc_aligned(Arena* arena, size_t size, size_t alignment) {
+    ArenaBlock* block = arena->head;
+    size_t offset = block ? arena_align(block, alignment) : 0;
+    if (!block || offset + size > block->size) {
+        block = arena_add_block(arena, size, alignment);
+        if (!block) {
+            return NULL;
+        }
+        offset = arena_align(block, alignment);
+    }
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+static void* arena_check(void* memory, size_t size) {
+    if (!memory) {
+        fprintf(stderr, "Error: Arena allocation of %zu bytes failed\n", size);
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    return arena_check(arena_alloc_aligned(arena, size, ARENA_ALIGNMENT), size);
+}
+
+char* arena_try_strndup(Arena* arena, const char* text, size_t length) {
+    char* copy = arena_alloc_aligned(arena, length + 1, 1);
+    if (copy) {
+        memcpy(copy, text, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+char* arena_strndup(Arena* arena, const char* text, size_t length) {
+    return arena_check(arena_try_strndup(arena, text, length), length + 1);
+}
+
+size_t arena_bytes(const Arena* arena) {
+    size_t bytes = 0;
+    for (const ArenaBlock* block = arena->head; block; block = block->next) {
+        bytes += block->used;
+    }
+    return bytes;
+}
+
+void arena_free(Arena* arena) {
+    while (arena->head) {
+        ArenaBlock* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+
+// Keep one regular block for the next round of allocations and release the rest
+void arena_reset(Arena* arena) {
+    ArenaBlock* keep = NULL;
+    while (arena->head) {
+        ArenaBlock* next = arena->head->next;
+        if (!keep && arena->head->size == arena->block_size) {
+            keep = arena->head;
+        }
+        else {
+            free(arena->head);
+        }
+        arena->head = next;
+    }
+    if (keep) {
+        keep->used = 0;
+        keep->next = NULL;
+    }
+    arena->head = keep;
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+
+// Arena block; allocations are carved from `data`
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+// Bump allocator: allocations are never freed individually, only all at once
+typedef struct {
+    ArenaBlock* head;      // Block currently being filled
+    size_t block_size;     // Size of regular blocks; larger requests get a block of their own
+} Arena;
+
+void arena_init(Arena* arena, size_t block_size);          // 0 selects ARENA_DEFAULT_BLOCK
+void* arena_alloc(Arena* arena, size_t size);              // Memory aligned for any object type; exits if memory runs out
+char* arena_strndup(Arena* arena, const char* text, size_t length); // NUL-terminated copy, unaligned; exits if memory runs out
+char* arena_try_strndup(Arena* arena, const char* text, size_t length); // Same, but NULL if memory runs out
+size_t arena_bytes(const Arena* arena);                    // Bytes handed out so far
+void arena_reset(Arena* arena);                            // Discard every allocation but keep one block for reuse
+void arena_free(Arena* arena);                             // Release every block; the arena can be reused
+
+#endif // ARENA_H
@@ -0,0 +1,287 @@
+// ast_cache.c
+#include "ast_cache.h"
+#include "flat_ast.h"
+#include "interner.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AST_CACHE_ALIGN(size) (((size) + 7) & ~(uint64_t)7)
+
+uint64_t ast_cache_hash(const char* source, int length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)source[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Flatten the tree, give each distinct text one string-table entry (found
+// through a hash table of entries, since literal text is not interned), then
+// lay the whole file out in one buffer and write it at once
+int ast_cache_write(const char* path, const ASTNode* program, const char* source, int source_length) {
+    FlatAst flat;
+    if (!program || !flat_ast_build(&flat, program)) return 0;
+
+    uint32_t capacity = 16;
+    while (capacity < flat.count * 2) capacity *= 2;
+    uint32_t* table = safe_malloc(capacity * sizeof(uint32_t));
+    memset(table, 0xff, capacity * sizeof(uint32_t));  // AST_CACHE_NONE marks an empty slot
+    const Token** firsts = safe_malloc(flat.count * sizeof(Token*));  // First token with each entry's text
+    uint32_t* entries = safe_malloc(flat.count * sizeof(uint32_t));
+    uint32_t string_count = 0;
+    uint64_t text_size = 0;
+    for (uint32_t i = 0; i < flat.count; i++) {
+        const char* text = token_text(&flat.tokens[i]);
+        int length = token_length(&flat.tokens[i]);
+        uint32_t slot = (uint32_t)ast_cache_hash(text, length) & (capacity - 1);
+        while (table[slot] != AST_CACHE_NONE) {
+            const Token* first = firsts[table[slot]];
+            if (token_length(first) == length && memcmp(token_text(first), text, length) == 0) break;
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == AST_CACHE_NONE) {
+            table[slot] = string_count;
+            firsts[string_count++] = &flat.tokens[i];
+            text_size += length + 1;
+        }
+        entries[i] = table[slot];
+    }
+    free(table);
+
+    AstCacheHeader header;
+    memset(&header, 0, sizeof(header));  // Also clears the padding, which is written to the file
+    header.magic = AST_CACHE_MAGIC;
+    header.version = AST_CACHE_VERSION;
+    header.endian = AST_CACHE_ENDIAN;
+    header.node_count = flat.count;
+    header.source_hash = ast_cache_hash(source, source_length);
+    header.source_length = (uint64_t)source_length;
+    header.nodes_offset = AST_CACHE_ALIGN(sizeof(AstCacheHeader));
+    header.strings_offset = AST_CACHE_ALIGN(header.nodes_offset + (uint64_t)flat.count * sizeof(AstCacheNode));
+    header.text_offset = AST_CACHE_ALIGN(header.strings_offset + (uint64_t)string_count * sizeof(AstCacheString));
+    header.text_size = text_size;
+    header.string_count = string_count;
+    size_t size = (size_t)(header.text_offset + text_size);
+
+    char* buffer = safe_malloc(size);
+    memset(buffer, 0, (size_t)header.text_offset);  // Padding between sections
+    memcpy(buffer, &header, sizeof(header));
+    AstCacheNode* nodes = (AstCacheNode*)(buffer + header.nodes_offset);
+    AstCacheString* strings = (AstCacheString*)(buffer + header.strings_offset);
+    char* text = buffer + header.text_offset;
+
+    // Texts go in the order their first node comes, which is the order entries were given out
+    uint32_t text_used = 0, next_string = 0;
+    for (uint32_t i = 0; i < flat.count; i++) {
+        const FlatNode* node = &flat.nodes[i];
+        const Token* token = &flat.tokens[i];
+        uint32_t entry = entries[i];
+        if (entry == next_string) {
+            int length = token_length(token);
+            strings[next_string++] = (AstCacheString){ .offset = text_used, .length = (uint32_t)length };
+            memcpy(text + text_used, token_text(token), length);
+            text[text_used + length] = '\0';
+            text_used += length + 1;
+        }
+        nodes[i] = (AstCacheNode){ .type = node->type, .inferred_type = node->inferred_type,
+            .token_type = (uint8_t)token->type, .punctuator = (uint8_t)token->punctuator,
+            .keyword = (uint16_t)token->keyword, .reserved = 0, .parent = node->parent,
+            .child_count = node->child_count, .subtree_size = node->subtree_size, .depth = node->depth,
+            .text = entry, .line = token->line, .column = token->column, .offset = token->offset };
+    }
+    free(entries);
+    free(firsts);
+
+    // flat_ast_build() does not keep the statement spans; they are in pre-order too
+    const ASTNode** stack = safe_malloc(flat.count * sizeof(ASTNode*));
+    uint32_t depth = 0, index = 0;
+    stack[depth++] = program;
+    while (depth > 0) {
+        const ASTNode* node = stack[--depth];
+        nodes[index].token_first = node->token_first;
+        nodes[index++].token_count = node->token_count;
+        for (int i = node->child_count - 1; i >= 0; i--) {
+            stack[depth++] = node->children[i];
+        }
+    }
+    free(stack);
+    flat_ast_free(&flat);
+
+    FILE* file = fopen(path, "wb");
+    int written = file && fwrite(buffer, 1, size, file) == size;
+    if (file && fclose(file) != 0) written = 0;
+    free(buffer);
+    if (!written) {
+        fprintf(stderr, "Error: Could not write AST cache %s\n", path);
+        remove(path);  // A partial file would only be rejected later
+        return 0;
+    }
+    return 1;
+}
+
+// Everything a reader relies on without looking at the nodes: the sections lie
+// inside the file, in order, and the text ends in a NUL
+static int header_valid(const AstCacheHeader* header, uint64_t file_size) {
+    if (header->nodes_offset < sizeof(AstCacheHeader) || header->node_count == 0 ||
+        header->string_count == 0 || header->text_size == 0) {
+        return 0;
+    }
+    if ((header->nodes_offset | header->strings_offset | header->text_offset) & 7) return 0;
+    uint64_t nodes_end = header->nodes_offset + (uint64_t)header->node_count * sizeof(AstCacheNode);
+    uint64_t strings_end = header->strings_offset + (uint64_t)header->string_count * sizeof(AstCacheString);
+    return nodes_end <= header->strings_offset && strings_end <= header->text_offset &&
+        header->text_offset <= file_size && header->text_size <= file_size - header->text_offset &&
+        header->text_size <= UINT32_MAX;
+}
+
+int ast_cache_open(AstCache* cache, const char* path, const char* source, int source_length) {
+    memset(cache, 0, sizeof(*cache));
+
+    // A cache that was never written is the usual miss; source_file_open() would report it
+    FILE* probe = fopen(path, "rb");
+    if (!probe) return 0;
+    fclose(probe);
+    if (!source_file_open(&cache->file, path)) return 0;
+
+    // The mapping is page-aligned, so the 8-byte-aligned sections can be used in place
+    const AstCacheHeader* header = (const AstCacheHeader*)cache->file.data;
+    if ((size_t)cache->file.length < sizeof(AstCacheHeader) || header->magic != AST_CACHE_MAGIC ||
+        header->endian != AST_CACHE_ENDIAN || header->version != AST_CACHE_VERSION ||
+        header->source_length != (uint64_t)source_length || !header_valid(header, (uint64_t)cache->file.length) ||
+        cache->file.data[header->text_offset + header->text_size - 1] != '\0' ||
+        header->source_hash != ast_cache_hash(source, source_length)) {
+        ast_cache_close(cache);
+        return 0;
+    }
+
+    cache->header = header;
+    cache->nodes = (const AstCacheNode*)(cache->file.data + header->nodes_offset);
+    cache->strings = (const AstCacheString*)(cache->file.data + header->strings_offset);
+    cache->text = cache->file.data + header->text_offset;
+    cache->node_count = header->node_count;
+    return 1;
+}
+
+void ast_cache_close(AstCache* cache) {
+    source_file_close(&cache->file);
+    cache->header = NULL;
+    cache->nodes = NULL;
+    cache->strings = NULL;
+    cache->text = NULL;
+    cache->node_count = 0;
+}
+
+// String indices are checked here rather than at open, so opening stays O(1) in the node count
+const char* ast_cache_text(const AstCache* cache, uint32_t node, int* length) {
+    uint32_t index = cache->nodes[node].text;
+    if (index < cache->header->string_count) {
+        const AstCacheString* string = &cache->strings[index];
+        if ((uint64_t)string->offset + string->length < cache->header->text_size) {
+            *length = (int)string->length;
+            return cache->text + string->offset;
+        }
+    }
+    *length = 0;
+    return "";
+}
+
+// Parents come before their children, so each node is attached as it is built.
+// Each distinct name is interned once and the nodes are handed their symbols, so
+// create_node_in() has no lookups left to do; other text it copies into the node.
+ASTNode* ast_cache_to_ast(const AstCache* cache, Arena* arena) {
+    uint32_t count = cache->node_count;
+    ASTNode** built = safe_malloc(count * sizeof(ASTNode*));
+    SymbolId* symbols = safe_malloc(cache->header->string_count * sizeof(SymbolId));
+    memset(symbols, 0, cache->header->string_count * sizeof(SymbolId));  // SYMBOL_NONE
+
+    for (uint32_t i = 0; i < count; i++) {
+        const AstCacheNode* record = &cache->nodes[i];
+        if (record->type > NODE_ERROR || (i == 0) != (record->parent == AST_CACHE_NONE) ||
+            (i > 0 && record->parent >= i)) {
+            fprintf(stderr, "Error: AST cache node %u is damaged\n", i);
+            if (i > 0 && !arena) free_ast(built[0]);
+            free(symbols);
+            free(built);
+            return NULL;
+        }
+
+        int length;
+        const char* text = ast_cache_text(cache, i, &length);
+
+        Token token;
+        memset(&token, 0, sizeof(token));
+        token.type = (TokenType)record->token_type;
+        token.line = record->line;
+        token.column = record->column;
+        token.start = text;
+        token.length = length;
+        token.offset = record->offset;
+        token.keyword = (KeywordId)record->keyword;
+        token.punctuator = (PunctuatorId)record->punctuator;
+        if (token.type == TOKEN_IDENTIFIER) {
+            SymbolId* symbol = &symbols[record->text < cache->header->string_count ? record->text : 0];
+            if (*symbol == SYMBOL_NONE) *symbol = intern(text, length);
+            token.symbol = *symbol;
+        }
+        else if (token.type == TOKEN_KEYWORD && token.keyword >= KEYWORD_USER_DEFINED) {
+            token.keyword = keyword_lookup(text, length);  // User-defined IDs follow the current keyword set
+        }
+        else if (token.type == TOKEN_LITERAL) {
+            token.number = number_literal_value(text, length);
+        }
+
+        ASTNode* node = create_node_in(arena, (NodeType)record->type, token);
+        node->inferred_type = (DataType)record->inferred_type;
+        node->token_first = record->token_first;
+        node->token_count = record->token_count;
+        built[i] = node;
+        if (i > 0) add_child(built[record->parent], node);
+    }
+
+    ASTNode* program = built[0];
+    free(symbols);
+    free(built);
+    return program;
+}
+
+ASTNode* ast_cache_parse_file(const char* source_path, const char* cache_path, Arena* arena, int* from_cache) {
+    SourceFile source;
+    if (!source_file_open(&source, source_path)) return NULL;
+
+    ASTNode* program = NULL;
+    AstCache cache;
+    if (ast_cache_open(&cache, cache_path, source.data, source.length)) {
+        program = ast_cache_to_ast(&cache, arena);
+        ast_cache_close(&cache);
+    }
+    if (from_cache) *from_cache = program != NULL;
+
+    if (!program) {
+        // Nodes hold their own text, so the tokens can go as soon as the tree is built
+        DiagnosticList diagnostics;
+        diagnostics_init(&diagnostics);
+        int token_count = 0;
+        Token* tokens = tokenize_recovering(source.data, source.length, &diagnostics, &token_count);
+        diagnostics_print(&diagnostics, "Lexer");
+        if (tokens) {
+            TokenSource tokens_source;
+            ParserState state;
+            token_source_init_array(&tokens_source, tokens, token_count);
+            parser_state_init(&state, &tokens_source);
+            state.arena = arena;
+            program = parse_with_state(&state);
+
+            // A later run that loaded this tree would not see the errors again
+            if (program && diagnostics.count == 0 && diagnostics.dropped == 0 &&
+                state.error_count == 0 && !state.aborted) {
+                ast_cache_write(cache_path, program, source.data, source.length);
+            }
+            free_tokens(tokens, token_count);
+        }
+        diagnostics_free(&diagnostics);
+    }
+    source_file_close(&source);
+    return program;
+}
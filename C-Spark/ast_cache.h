@@ -0,0 +1,99 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <stdint.h>
+#include "parser.h"
+#include "arena.h"
+#include "source_file.h"
+
+// On-disk cache of a parsed program (a .csast file), so a tool can skip lexing
+// and parsing when the source has not changed since the cache was written.
+//
+// Layout, every section 8-byte aligned and every field little-endian as written
+// by the host (files from a host of the other byte order are rejected):
+//     AstCacheHeader
+//     AstCacheNode[node_count]       pre-order, as in FlatAst
+//     AstCacheString[string_count]   offset and length of each distinct text
+//     char[text_size]                the texts, each followed by a NUL
+// The header records a hash of the source; a cache is only used for the exact
+// source it was written from.
+
+#define AST_CACHE_MAGIC 0x53415343u     // "CSAS"
+#define AST_CACHE_VERSION 1             // Bump on any change to the layout or to the parser's output
+#define AST_CACHE_ENDIAN 0x01020304u    // Reads back byte-swapped on a host of the other byte order
+#define AST_CACHE_NONE UINT32_MAX       // No parent
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t endian;
+    uint32_t node_count;
+    uint64_t source_hash;       // ast_cache_hash() of the source
+    uint64_t source_length;
+    uint64_t nodes_offset;      // File offsets of the sections
+    uint64_t strings_offset;
+    uint64_t text_offset;
+    uint64_t text_size;
+    uint32_t string_count;
+    uint32_t reserved;
+} AstCacheHeader;
+
+// One node: its kind, token and place in the tree. Children follow their parent
+// in order; the next sibling is at index + subtree_size.
+typedef struct {
+    uint8_t type;               // NodeType
+    uint8_t inferred_type;      // DataType
+    uint8_t token_type;         // TokenType
+    uint8_t punctuator;         // PunctuatorId
+    uint16_t keyword;           // KeywordId
+    uint16_t reserved;
+    uint32_t parent;            // AST_CACHE_NONE for the root
+    uint32_t child_count;
+    uint32_t subtree_size;      // Nodes in the subtree, including this one
+    uint32_t depth;             // 0 for the root
+    uint32_t text;              // Index into the string table
+    int32_t line;
+    int32_t column;
+    int32_t offset;
+    int32_t token_first;        // Statement span, as in ASTNode
+    int32_t token_count;
+} AstCacheNode;
+
+typedef struct {
+    uint32_t offset;            // Into the text section
+    uint32_t length;            // Bytes, not counting the NUL
+} AstCacheString;
+
+// A cache file mapped read-only. The sections are used in place: opening checks
+// the header once and decodes nothing per node.
+typedef struct AstCache {
+    SourceFile file;
+    const AstCacheHeader* header;
+    const AstCacheNode* nodes;
+    const AstCacheString* strings;
+    const char* text;
+    uint32_t node_count;
+} AstCache;
+
+uint64_t ast_cache_hash(const char* source, int length);  // 64-bit FNV-1a of the source
+
+// Write `program`, parsed from `source`, to `path` in a single write. Returns 1 on success, 0 on failure.
+int ast_cache_write(const char* path, const ASTNode* program, const char* source, int source_length);
+
+// Map the cache at `path` if it was written from exactly `source`. Returns 0,
+// quietly, if the file is missing, stale, of another version or damaged.
+int ast_cache_open(AstCache* cache, const char* path, const char* source, int source_length);
+void ast_cache_close(AstCache* cache);
+
+const char* ast_cache_text(const AstCache* cache, uint32_t node, int* length);  // Token text of a node (NUL-terminated)
+ASTNode* ast_cache_to_ast(const AstCache* cache, Arena* arena);  // Rebuild the pointer tree for passes that need it
+
+// Parse `source_path`, going through the cache at `cache_path`: a cache that
+// matches the source is loaded instead of parsing, and a missing or stale one
+// is rewritten, but only from a parse without lexer diagnostics or syntax
+// errors, so a file with problems is reported on every run. Nodes are allocated
+// in `arena`; *from_cache (if not NULL) tells which way the tree was built.
+// Returns NULL if the source cannot be read.
+ASTNode* ast_cache_parse_file(const char* source_path, const char* cache_path, Arena* arena, int* from_cache);
+
+#endif // AST_CACHE_H
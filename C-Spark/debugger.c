@@ -5,6 +5,7 @@
 #include "inline_hints.h"  // Include the Inline Hints system
 #include "parser.h"   // For AST traversal
 #include "transpile.h" // For execution tracking
+#include "ast_cache.h" // For printing cached trees
 
 
 void enable_debugging() {
@@ -63,7 +64,7 @@ void visualize_ast(ASTNode* node, int depth) {
     for (int i = 0; i < depth; i++) printf("  ");
 
     // Print the node's type and associated token
-    printf("[%d] %s\n", node->type, node->token.value);  // Assuming token has a 'value' field
+    printf("[%d] " TOKEN_FMT "\n", node->type, TOKEN_ARG(&node->token));
 
     // Recursively print children
     for (int i = 0; i < node->child_count; i++) {
@@ -71,6 +72,18 @@ void visualize_ast(ASTNode* node, int depth) {
     }
 }
 
+// Same output as visualize_ast(), straight from a mapped .csast file: the nodes
+// are in print order and carry their depth, so no tree has to be built
+void visualize_cached_ast(const AstCache* cache) {
+    for (uint32_t i = 0; i < cache->node_count; i++) {
+        for (uint32_t d = 0; d < cache->nodes[i].depth; d++) printf("  ");
+
+        int length;
+        const char* text = ast_cache_text(cache, i, &length);
+        printf("[%d] %.*s\n", cache->nodes[i].type, length, text);
+    }
+}
+
 
 // Hook into Transpiler for Execution Tracking
 void track_execution(IRNode* ir) {
@@ -2,6 +2,7 @@
 #define DEBUGGER_H
 
 #include <stdbool.h>
+#include "ast_cache.h"
 // Declare debugging_enabled globally
 static int debugging_enabled = 0; // 0 = Off, 1 = On
 void debug_print(const char* message);
@@ -10,4 +11,5 @@ void step_debug(const char* statement, int line);
 void inspect_variable(const char* var_name, int value);
 void enable_debugging();
 void disable_debugging();
+void visualize_cached_ast(const AstCache* cache); // Print a cached tree as visualize_ast() prints the parsed one
 #endif // DEBUGGER_H
@@ -71,3 +71,72 @@ void free_error_log() {
     }
     error_count = 0;
 }
+
+// Start an empty diagnostics buffer
+void diagnostics_init(DiagnosticList* list) {
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->error_count = 0;
+    list->dropped = 0;
+}
+
+// Record a diagnostic; on allocation failure it is counted as dropped instead
+void diagnostics_add(DiagnosticList* list, DiagnosticSeverity severity, int line, int column, int offset, int length, const char* message) {
+    if (severity == DIAGNOSTIC_ERROR) {
+        list->error_count++;
+    }
+    if (list->count == list->capacity) {
+        int new_capacity = list->capacity ? list->capacity * 2 : 16;
+        Diagnostic* items = realloc(list->items, new_capacity * sizeof(Diagnostic));
+        if (!items) {
+            list->dropped++;
+            return;
+        }
+        list->items = items;
+        list->capacity = new_capacity;
+    }
+    size_t size = strlen(message) + 1;
+    char* copy = malloc(size);
+    if (!copy) {
+        list->dropped++;
+        return;
+    }
+    memcpy(copy, message, size);
+    list->items[list->count++] = (Diagnostic){ severity, line, column, offset, length, copy };
+}
+
+// Print every diagnostic in the order it was recorded
+void diagnostics_print(const DiagnosticList* list, const char* stage) {
+    for (int i = 0; i < list->count; i++) {
+        const Diagnostic* diagnostic = &list->items[i];
+        if (diagnostic->severity == DIAGNOSTIC_ERROR) {
+            fprintf(stderr, COLOR_RED "[%s Error] Line %d, Column %d: %s\n" COLOR_RESET,
+                stage, diagnostic->line, diagnostic->column, diagnostic->message);
+        }
+        else {
+            fprintf(stderr, COLOR_YELLOW "  Warning (Line %d, Column %d): %s\n" COLOR_RESET,
+                diagnostic->line, diagnostic->column, diagnostic->message);
+        }
+    }
+    if (list->dropped > 0) {
+        fprintf(stderr, "%d more diagnostics could not be recorded.\n", list->dropped);
+    }
+}
+
+// Drop all diagnostics, keeping the buffer so a host can reuse it for the next source
+void diagnostics_clear(DiagnosticList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->items[i].message);
+    }
+    list->count = 0;
+    list->error_count = 0;
+    list->dropped = 0;
+}
+
+// Free the diagnostics buffer
+void diagnostics_free(DiagnosticList* list) {
+    diagnostics_clear(list);
+    free(list->items);
+    diagnostics_init(list);
+}
@@ -32,4 +32,36 @@ void report_warning(int line, int column, const char* message);
 void print_error_log();
 void free_error_log();
 
+// Severity of a collected diagnostic
+typedef enum {
+    DIAGNOSTIC_WARNING,
+    DIAGNOSTIC_ERROR
+} DiagnosticSeverity;
+
+// One problem found in a source buffer
+typedef struct {
+    DiagnosticSeverity severity;
+    int line;
+    int column;
+    int offset;        // Byte offset of the offending text
+    int length;        // Length of the offending text in bytes
+    char* message;     // Owned copy of the message
+} Diagnostic;
+
+// Growable diagnostics buffer filled by the recovering lexer. Recording never
+// exits the process: diagnostics that cannot be stored are only counted.
+typedef struct {
+    Diagnostic* items;
+    int count;
+    int capacity;
+    int error_count;   // Number of DIAGNOSTIC_ERROR entries recorded (including dropped ones)
+    int dropped;       // Diagnostics lost to allocation failure
+} DiagnosticList;
+
+void diagnostics_init(DiagnosticList* list);
+void diagnostics_add(DiagnosticList* list, DiagnosticSeverity severity, int line, int column, int offset, int length, const char* message);
+void diagnostics_print(const DiagnosticList* list, const char* stage);
+void diagnostics_clear(DiagnosticList* list);  // Drop all diagnostics but keep the buffer for reuse
+void diagnostics_free(DiagnosticList* list);
+
 #endif // ERROR_REPORTING_H
@@ -0,0 +1,98 @@
+// flat_ast.c
+#include "flat_ast.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Pending node of the pre-order walk in flat_ast_build()
+typedef struct {
+    const ASTNode* node;
+    uint32_t parent;
+    uint32_t depth;
+} FlatPending;
+
+// Lay the tree out in pre-order with an explicit stack, so deep trees cannot
+// overflow the call stack, then total the subtree sizes in one backward sweep:
+// every node comes after its parent, so each size is final before it is added.
+int flat_ast_build(FlatAst* ast, const ASTNode* root) {
+    ast->nodes = NULL;
+    ast->tokens = NULL;
+    ast->count = 0;
+    if (!root) return 0;
+
+    uint32_t capacity = 256, stack_capacity = 64, depth = 0;
+    ast->nodes = safe_malloc(capacity * sizeof(FlatNode));
+    ast->tokens = safe_malloc(capacity * sizeof(Token));
+    FlatPending* stack = safe_malloc(stack_capacity * sizeof(FlatPending));
+    stack[depth++] = (FlatPending){ root, FLAT_AST_NONE, 0 };
+
+    while (depth > 0) {
+        FlatPending pending = stack[--depth];
+        const ASTNode* node = pending.node;
+        if (ast->count == capacity) {
+            capacity *= 2;
+            ast->nodes = safe_realloc(ast->nodes, capacity * sizeof(FlatNode));
+            ast->tokens = safe_realloc(ast->tokens, capacity * sizeof(Token));
+        }
+        uint32_t index = ast->count++;
+        ast->nodes[index] = (FlatNode){ (uint8_t)node->type, (uint8_t)node->inferred_type, 1,
+            pending.parent, (uint32_t)node->child_count, pending.depth };
+        ast->tokens[index] = node->token;
+
+        if (depth + node->child_count > stack_capacity) {
+            while (depth + node->child_count > stack_capacity) stack_capacity *= 2;
+            stack = safe_realloc(stack, stack_capacity * sizeof(FlatPending));
+        }
+        for (int i = node->child_count - 1; i >= 0; i--) {  // Reversed, so the first child pops first
+            stack[depth++] = (FlatPending){ node->children[i], index, pending.depth + 1 };
+        }
+    }
+    free(stack);
+
+    for (uint32_t i = ast->count - 1; i > 0; i--) {
+        ast->nodes[ast->nodes[i].parent].subtree_size += ast->nodes[i].subtree_size;
+    }
+    return (int)ast->count;
+}
+
+void flat_ast_free(FlatAst* ast) {
+    free(ast->nodes);
+    free(ast->tokens);
+    ast->nodes = NULL;
+    ast->tokens = NULL;
+    ast->count = 0;
+}
+
+uint32_t flat_ast_first_child(const FlatAst* ast, uint32_t node) {
+    return ast->nodes[node].subtree_size > 1 ? node + 1 : FLAT_AST_NONE;
+}
+
+uint32_t flat_ast_next_sibling(const FlatAst* ast, uint32_t node) {
+    uint32_t parent = ast->nodes[node].parent;
+    if (parent == FLAT_AST_NONE) return FLAT_AST_NONE;
+    uint32_t next = node + ast->nodes[node].subtree_size;
+    return next < parent + ast->nodes[parent].subtree_size ? next : FLAT_AST_NONE;
+}
+
+uint32_t flat_ast_subtree_end(const FlatAst* ast, uint32_t node) {
+    return node + ast->nodes[node].subtree_size;
+}
+
+uint32_t flat_ast_child(const FlatAst* ast, uint32_t node, uint32_t n) {
+    if (n >= ast->nodes[node].child_count) return FLAT_AST_NONE;
+    uint32_t child = node + 1;
+    while (n-- > 0) child += ast->nodes[child].subtree_size;
+    return child;
+}
+
+// Pre-order is print order, and each node carries its depth, so printing is one linear scan
+void flat_ast_print(const FlatAst* ast) {
+    for (uint32_t i = 0; i < ast->count; i++) {
+        const FlatNode* node = &ast->nodes[i];
+        for (uint32_t d = 0; d < node->depth; d++) {
+            printf("  ");
+        }
+        printf("NodeType: %d, Token: '" TOKEN_FMT "', Line: %d, Column: %d, Children: %u\n",
+            node->type, TOKEN_ARG(&ast->tokens[i]), ast->tokens[i].line, ast->tokens[i].column, node->child_count);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <stdint.h>
+#include "parser.h"
+
+#define FLAT_AST_NONE UINT32_MAX   // "No node": no parent, child or sibling
+
+// One node of a flattened AST. Nodes are stored in pre-order, so a node's first
+// child is the next node and its subtree is the subtree_size nodes starting at it;
+// the next sibling is index + subtree_size.
+typedef struct {
+    uint8_t type;              // NodeType
+    uint8_t inferred_type;     // DataType
+    uint32_t subtree_size;     // Nodes in the subtree, including this one
+    uint32_t parent;           // FLAT_AST_NONE for the root
+    uint32_t child_count;
+    uint32_t depth;            // 0 for the root
+} FlatNode;
+
+// Pre-order node array plus a parallel array of tokens, kept apart so passes
+// that only look at the tree shape stream through 20-byte nodes
+typedef struct {
+    FlatNode* nodes;
+    Token* tokens;             // tokens[i] belongs to nodes[i]; text stays owned by the source AST or interner
+    uint32_t count;
+} FlatAst;
+
+int flat_ast_build(FlatAst* ast, const ASTNode* root);  // Flatten a pointer AST; returns the node count (0 for NULL)
+void flat_ast_free(FlatAst* ast);
+
+// Navigation
+uint32_t flat_ast_first_child(const FlatAst* ast, uint32_t node);  // FLAT_AST_NONE if the node is a leaf
+uint32_t flat_ast_next_sibling(const FlatAst* ast, uint32_t node); // FLAT_AST_NONE for the last child
+uint32_t flat_ast_subtree_end(const FlatAst* ast, uint32_t node);  // One past the node's last descendant
+uint32_t flat_ast_child(const FlatAst* ast, uint32_t node, uint32_t n); // n-th child, FLAT_AST_NONE if out of range
+
+// Visit each child of `node`:
+//     FLAT_AST_FOR_EACH_CHILD(ast, node, child) { ... }
+#define FLAT_AST_FOR_EACH_CHILD(ast, node, child) \
+    for (uint32_t child = flat_ast_first_child(ast, node); child != FLAT_AST_NONE; child = flat_ast_next_sibling(ast, child))
+
+void flat_ast_print(const FlatAst* ast); // Same output as print_ast(root, 0), with no recursion
+
+#endif // FLAT_AST_H
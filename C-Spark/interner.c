@@ -0,0 +1,155 @@
+// interner.c
+#include "interner.h"
+#include "threads.h"
+#include "error_reporting.h"
+#include "arena.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SYMBOL_PAGE_SIZE 4096            // Symbols per page; pages never move once allocated
+#define SYMBOL_MAX_PAGES 4096
+
+typedef struct {
+    const char* text;
+    int length;
+} Symbol;
+
+// Open-addressing slot; symbol == SYMBOL_NONE marks an empty slot
+typedef struct {
+    unsigned int hash;
+    SymbolId symbol;
+} InternSlot;
+
+static InternSlot* slots;
+static unsigned int slot_mask;
+static Symbol* symbol_pages[SYMBOL_MAX_PAGES];
+static int count;                       // Symbols interned; IDs run from 1 to count
+static Arena text_arena = { NULL, ARENA_DEFAULT_BLOCK };  // Canonical text
+static Mutex interner_lock = MUTEX_INIT;
+
+static int full_reported;                // "Too many distinct symbols" is reported once
+
+static Symbol* symbol_entry(SymbolId symbol) {
+    return &symbol_pages[(symbol - 1) / SYMBOL_PAGE_SIZE][(symbol - 1) % SYMBOL_PAGE_SIZE];
+}
+
+// Double the table, keeping the load factor at or below one half. Returns 0,
+// leaving the table as it was, if memory runs out.
+static int grow_slots(void) {
+    unsigned int capacity = slots ? (slot_mask + 1) * 2 : 1024;
+    InternSlot* grown = calloc(capacity, sizeof(InternSlot));
+    if (!grown) return 0;
+
+    if (slots) {
+        for (unsigned int i = 0; i <= slot_mask; i++) {
+            if (slots[i].symbol == SYMBOL_NONE) continue;
+            unsigned int slot = slots[i].hash & (capacity - 1);
+            while (grown[slot].symbol != SYMBOL_NONE) slot = (slot + 1) & (capacity - 1);
+            grown[slot] = slots[i];
+        }
+        free(slots);
+    }
+    slots = grown;
+    slot_mask = capacity - 1;
+    return 1;
+}
+
+// Look a span up, adding it if it is new. A host process keeps running when
+// the interner is full or out of memory: the span just gets SYMBOL_NONE.
+SymbolId intern(const char* text, int length) {
+    unsigned int hash = utils_hash_span(text, length);
+
+    mutex_lock(&interner_lock);
+    if ((!slots || (unsigned int)(count + 1) * 2 > slot_mask + 1) && !grow_slots()) {
+        mutex_unlock(&interner_lock);
+        report_error("Interner", 0, 0, "Memory allocation failed while interning a string");
+        return SYMBOL_NONE;
+    }
+
+    unsigned int slot = hash & slot_mask;
+    while (slots[slot].symbol != SYMBOL_NONE) {
+        if (slots[slot].hash == hash) {
+            Symbol* entry = symbol_entry(slots[slot].symbol);
+            if (entry->length == length && memcmp(entry->text, text, length) == 0) {
+                SymbolId found = slots[slot].symbol;
+                mutex_unlock(&interner_lock);
+                return found;
+            }
+        }
+        slot = (slot + 1) & slot_mask;
+    }
+
+    int page = count / SYMBOL_PAGE_SIZE;
+    if (page >= SYMBOL_MAX_PAGES) {
+        int reported = full_reported;
+        full_reported = 1;
+        mutex_unlock(&interner_lock);
+        if (!reported) report_error("Interner", 0, 0, "Too many distinct symbols");
+        return SYMBOL_NONE;
+    }
+    if (!symbol_pages[page]) {
+        symbol_pages[page] = malloc(SYMBOL_PAGE_SIZE * sizeof(Symbol));
+        if (!symbol_pages[page]) {
+            mutex_unlock(&interner_lock);
+            report_error("Interner", 0, 0, "Memory allocation failed while interning a string");
+            return SYMBOL_NONE;
+        }
+    }
+
+    char* canonical = arena_try_strndup(&text_arena, text, length);
+    if (!canonical) {
+        mutex_unlock(&interner_lock);
+        report_error("Interner", 0, 0, "Memory allocation failed while interning a string");
+        return SYMBOL_NONE;
+    }
+
+    SymbolId symbol = ++count;
+    *symbol_entry(symbol) = (Symbol){ canonical, length };
+    slots[slot] = (InternSlot){ hash, symbol };
+    mutex_unlock(&interner_lock);
+    return symbol;
+}
+
+// A hit is confirmed against the canonical text, which needs no lock to read
+SymbolId intern_cached(InternCache* cache, const char* text, int length) {
+    SymbolId* entry = &cache->entries[utils_hash_span(text, length) & (INTERN_CACHE_SIZE - 1)];
+    if (*entry != SYMBOL_NONE && symbol_length(*entry) == length && memcmp(symbol_text(*entry), text, length) == 0) {
+        return *entry;
+    }
+    *entry = intern(text, length);
+    return *entry;
+}
+
+SymbolId intern_cstr(const char* text) {
+    return intern(text, (int)strlen(text));
+}
+
+// Symbols are never moved or removed, so reads need no lock
+const char* symbol_text(SymbolId symbol) {
+    return symbol > SYMBOL_NONE ? symbol_entry(symbol)->text : "";
+}
+
+int symbol_length(SymbolId symbol) {
+    return symbol > SYMBOL_NONE ? symbol_entry(symbol)->length : 0;
+}
+
+int symbol_count(void) {
+    return count;
+}
+
+// Release the table, the symbol pages and the text arena
+void interner_free(void) {
+    mutex_lock(&interner_lock);
+    free(slots);
+    slots = NULL;
+    slot_mask = 0;
+    for (int page = 0; page < SYMBOL_MAX_PAGES && symbol_pages[page]; page++) {
+        free(symbol_pages[page]);
+        symbol_pages[page] = NULL;
+    }
+    arena_free(&text_arena);
+    count = 0;
+    full_reported = 0;
+    mutex_unlock(&interner_lock);
+}
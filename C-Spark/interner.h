@@ -0,0 +1,30 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+// Global string interner: every distinct spelling gets one stable symbol ID and
+// one canonical NUL-terminated copy, so equal names compare as equal integers.
+// Safe to call from several threads. Symbols live until interner_free(), so only
+// names are interned; the parser keeps literal and string text with its nodes.
+
+typedef int SymbolId;
+
+#define SYMBOL_NONE 0   // Marks "not interned yet"; intern() returns it only on failure
+
+SymbolId intern(const char* text, int length);   // Symbol for a span, adding it on first sight; SYMBOL_NONE (after reporting) if the interner is full or out of memory
+SymbolId intern_cstr(const char* text);          // Symbol for a NUL-terminated string
+const char* symbol_text(SymbolId symbol);        // Canonical text (NUL-terminated); "" for SYMBOL_NONE
+int symbol_length(SymbolId symbol);              // Length of the canonical text
+int symbol_count(void);                          // Number of distinct symbols interned so far
+void interner_free(void);                        // Release every symbol; all IDs and canonical pointers become invalid
+
+#define INTERN_CACHE_SIZE 1024  // Entries in an InternCache; a power of two
+
+// Per-thread front for intern(): recently seen symbols are found without taking
+// the interner's lock. Zero-initialize before use; invalidated by interner_free().
+typedef struct {
+    SymbolId entries[INTERN_CACHE_SIZE];
+} InternCache;
+
+SymbolId intern_cached(InternCache* cache, const char* text, int length); // Same symbol intern() returns
+
+#endif // INTERNER_H
@@ -3,6 +3,9 @@
 #include "utils.h"
 #include "debugger.h"
 #include "error_reporting.h"
+#include "lexer_simd.h"
+#include "suggestions.h"
+#include "threads.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -14,7 +17,7 @@
 #define COLOR_YELLOW "\033[1;33m"
 #define COLOR_RESET "\033[0m"
 
-// List of keywords
+// List of keywords, in KeywordId order
 // --- Updated Keywords Array ---
 const char* keywords[] = {
     "let", "print", "if", "else", "for", "func", "return",
@@ -26,38 +29,57 @@ const char* keywords[] = {
 static const char** user_defined_keywords = NULL;
 static int user_defined_keywords_count = 0;
 
+// Open-addressing hash set over the user-defined keywords, rebuilt by set_user_defined_keywords()
+typedef struct {
+    const char* word;  // NULL for an empty slot
+    int length;
+    KeywordId keyword;
+} KeywordSlot;
 
-// Compute the Levenshtein distance between two strings
-int levenshtein_distance(const char* s1, const char* s2) {
-    int len1 = strlen(s1), len2 = strlen(s2);
-    int** dp = malloc((len1 + 1) * sizeof(int*));
-    for (int i = 0; i <= len1; i++) {
-        dp[i] = malloc((len2 + 1) * sizeof(int));
-    }
-    for (int i = 0; i <= len1; i++) dp[i][0] = i;
-    for (int j = 0; j <= len2; j++) dp[0][j] = j;
-    for (int i = 1; i <= len1; i++) {
-        for (int j = 1; j <= len2; j++) {
-            if (s1[i - 1] == s2[j - 1])
-                dp[i][j] = dp[i - 1][j - 1];
-            else {
-                int min = dp[i - 1][j - 1];
-                if (dp[i - 1][j] < min) min = dp[i - 1][j];
-                if (dp[i][j - 1] < min) min = dp[i][j - 1];
-                dp[i][j] = 1 + min;
-            }
-        }
-    }
-    int result = dp[len1][len2];
-    for (int i = 0; i <= len1; i++) free(dp[i]);
-    free(dp);
-    return result;
-}
+static KeywordSlot* user_keyword_table = NULL;
+static unsigned int user_keyword_mask = 0;  // Table capacity - 1 (capacity is a power of two)
+
+// "Did you mean" index over the built-in and user-defined keywords, built on first use
+static SuggestionIndex keyword_suggestions;
+static int keyword_suggestions_ready = 0;
+static Mutex keyword_suggestions_lock = MUTEX_INIT;  // Unknown characters are reported from lexer worker threads too
 
 // Function to set user-defined keywords
 void set_user_defined_keywords(const char** keywords, int count) {
     user_defined_keywords = keywords;
     user_defined_keywords_count = count;
+
+    mutex_lock(&keyword_suggestions_lock);
+    suggestion_index_free(&keyword_suggestions);
+    keyword_suggestions_ready = 0;
+    mutex_unlock(&keyword_suggestions_lock);
+
+    free(user_keyword_table);
+    user_keyword_table = NULL;
+    user_keyword_mask = 0;
+    if (count <= 0) return;
+
+    // Keep the load factor at or below one half
+    unsigned int capacity = 8;
+    while (capacity < (unsigned int)count * 2) capacity *= 2;
+    user_keyword_table = calloc(capacity, sizeof(KeywordSlot));
+    if (!user_keyword_table) {
+        report_error("Lexer", 0, 0, "Memory allocation failed while building the keyword table");
+        exit(1);
+    }
+    user_keyword_mask = capacity - 1;
+
+    for (int i = 0; i < count; i++) {
+        int length = (int)strlen(keywords[i]);
+        unsigned int slot = utils_hash_span(keywords[i], length) & user_keyword_mask;
+        while (user_keyword_table[slot].word &&
+            !(user_keyword_table[slot].length == length && memcmp(user_keyword_table[slot].word, keywords[i], length) == 0)) {
+            slot = (slot + 1) & user_keyword_mask;
+        }
+        if (!user_keyword_table[slot].word) {  // The first spelling of a duplicate wins
+            user_keyword_table[slot] = (KeywordSlot){ keywords[i], length, (KeywordId)(KEYWORD_USER_DEFINED + i) };
+        }
+    }
 }
 
 // Collect an error
@@ -68,36 +90,201 @@ void collect_error(Error* errors, int* error_count, int line, int column, const
     (*error_count)++;
 }
 
-// Check if a string is a keyword
-int is_keyword(const char* str) {
-    // Check built-in keywords
-    for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
-        if (strcmp(str, keywords[i]) == 0) {
-            return 1;
-        }
+// Match a built-in keyword by length bucket, then by spelling
+#define MATCH_KEYWORD(word, id) if (memcmp(text, word, sizeof(word) - 1) == 0) return id
+
+static KeywordId builtin_keyword(const char* text, int length) {
+    switch (length) {
+    case 2:
+        MATCH_KEYWORD("if", KEYWORD_IF);
+        break;
+    case 3:
+        MATCH_KEYWORD("let", KEYWORD_LET);
+        MATCH_KEYWORD("for", KEYWORD_FOR);
+        MATCH_KEYWORD("try", KEYWORD_TRY);
+        break;
+    case 4:
+        MATCH_KEYWORD("func", KEYWORD_FUNC);
+        MATCH_KEYWORD("else", KEYWORD_ELSE);
+        MATCH_KEYWORD("case", KEYWORD_CASE);
+        MATCH_KEYWORD("enum", KEYWORD_ENUM);
+        break;
+    case 5:
+        MATCH_KEYWORD("print", KEYWORD_PRINT);
+        MATCH_KEYWORD("catch", KEYWORD_CATCH);
+        MATCH_KEYWORD("defer", KEYWORD_DEFER);
+        MATCH_KEYWORD("break", KEYWORD_BREAK);
+        break;
+    case 6:
+        MATCH_KEYWORD("return", KEYWORD_RETURN);
+        MATCH_KEYWORD("struct", KEYWORD_STRUCT);
+        MATCH_KEYWORD("record", KEYWORD_RECORD);
+        MATCH_KEYWORD("switch", KEYWORD_SWITCH);
+        break;
+    case 7:
+        MATCH_KEYWORD("virtual", KEYWORD_VIRTUAL);
+        MATCH_KEYWORD("default", KEYWORD_DEFAULT);
+        break;
+    case 9:
+        MATCH_KEYWORD("interface", KEYWORD_INTERFACE);
+        break;
     }
-    // Check user-defined keywords
-    for (int i = 0; i < user_defined_keywords_count; i++) {
-        if (strcmp(str, user_defined_keywords[i]) == 0) {
-            return 1;
+    return KEYWORD_NONE;
+}
+
+#undef MATCH_KEYWORD
+
+// Keyword ID of a source span, KEYWORD_NONE if it is not a keyword
+KeywordId keyword_lookup(const char* text, int length) {
+    KeywordId keyword = builtin_keyword(text, length);
+    if (keyword != KEYWORD_NONE || !user_keyword_table) {
+        return keyword;
+    }
+
+    unsigned int slot = utils_hash_span(text, length) & user_keyword_mask;
+    while (user_keyword_table[slot].word) {
+        if (user_keyword_table[slot].length == length && memcmp(user_keyword_table[slot].word, text, length) == 0) {
+            return user_keyword_table[slot].keyword;
         }
+        slot = (slot + 1) & user_keyword_mask;
+    }
+    return KEYWORD_NONE;
+}
+
+// Spelling of a keyword ID
+const char* keyword_name(KeywordId keyword) {
+    if (keyword > KEYWORD_NONE && keyword < KEYWORD_USER_DEFINED) {
+        return keywords[keyword - 1];
+    }
+    int user_defined = (int)keyword - KEYWORD_USER_DEFINED;
+    if (user_defined >= 0 && user_defined < user_defined_keywords_count) {
+        return user_defined_keywords[user_defined];
+    }
+    return NULL;
+}
+
+// Spellings of the punctuator IDs, indexed by PunctuatorId
+static const char* const punctuators[PUNCT_COUNT] = {
+    NULL, "(", ")", "{", "}", ",", ";", ":",
+    "=", "==", "!", "!=", "<", "<=", ">", ">=",
+    "+", "+=", "-", "-=", "*", "/",
+    "&", "&&", "|", "||"
+};
+
+// Take `next` as the second character of a two-character operator
+#define MATCH_PAIR(second, pair, single) \
+    if (next == second) { *length = 2; return pair; } \
+    return single
+
+// Punctuator spelled by `c`, or by `c` and `next` when the two form one operator;
+// stores the length of the spelling (1 or 2) in `length`
+static PunctuatorId scan_punctuator(char c, char next, int* length) {
+    *length = 1;
+    switch (c) {
+    case '(': return PUNCT_LPAREN;
+    case ')': return PUNCT_RPAREN;
+    case '{': return PUNCT_LBRACE;
+    case '}': return PUNCT_RBRACE;
+    case ',': return PUNCT_COMMA;
+    case ';': return PUNCT_SEMICOLON;
+    case ':': return PUNCT_COLON;
+    case '*': return PUNCT_STAR;
+    case '/': return PUNCT_SLASH;
+    case '=': MATCH_PAIR('=', PUNCT_EQ, PUNCT_ASSIGN);
+    case '!': MATCH_PAIR('=', PUNCT_NE, PUNCT_NOT);
+    case '<': MATCH_PAIR('=', PUNCT_LE, PUNCT_LT);
+    case '>': MATCH_PAIR('=', PUNCT_GE, PUNCT_GT);
+    case '+': MATCH_PAIR('=', PUNCT_PLUS_ASSIGN, PUNCT_PLUS);
+    case '-': MATCH_PAIR('=', PUNCT_MINUS_ASSIGN, PUNCT_MINUS);
+    case '&': MATCH_PAIR('&', PUNCT_AND_AND, PUNCT_AND);
+    case '|': MATCH_PAIR('|', PUNCT_OR_OR, PUNCT_OR);
+    default:  return PUNCT_NONE;
     }
-    return 0;
+}
+
+#undef MATCH_PAIR
+
+// Punctuator ID of a source span
+PunctuatorId punctuator_lookup(const char* text, int length) {
+    if (length < 1 || length > 2) return PUNCT_NONE;
+    int spelled;
+    PunctuatorId punctuator = scan_punctuator(text[0], length == 2 ? text[1] : '\0', &spelled);
+    return spelled == length ? punctuator : PUNCT_NONE;
+}
+
+// Spelling of a punctuator ID
+const char* punctuator_name(PunctuatorId punctuator) {
+    return punctuator > PUNCT_NONE && punctuator < PUNCT_COUNT ? punctuators[punctuator] : NULL;
+}
+
+// Check if a string is a keyword
+int is_keyword(const char* str) {
+    return keyword_lookup(str, (int)strlen(str)) != KEYWORD_NONE;
 }
 
 // --- Token Array Resizing & Freeing ---
+// Double the token array; returns NULL (leaving `tokens` intact) on allocation failure
+static Token* grow_tokens(Token* tokens, int* capacity) {
+    Token* new_tokens = realloc(tokens, *capacity * 2 * sizeof(Token));
+    if (new_tokens) {
+        *capacity *= 2;
+    }
+    return new_tokens;
+}
+
 Token* resize_tokens(Token* tokens, int* capacity) {
-    int new_capacity = *capacity * 2;
-    Token* new_tokens = realloc(tokens, new_capacity * sizeof(Token));
+    Token* new_tokens = grow_tokens(tokens, capacity);
     if (!new_tokens) {
         report_error("Lexer", 0, 0, "Memory allocation failed during token resizing");
         free_tokens(tokens, *capacity);
         exit(1);
     }
-    *capacity = new_capacity;
     return new_tokens;
 }
 
+// Build a token whose text is the source span [start, end)
+static Token make_token(TokenType type, const char* code, int start, int end, int offset, int line, int column) {
+    return (Token){ .type = type, .value = NULL, .line = line, .column = column, .start = code + start,
+        .length = end - start, .offset = offset, .keyword = KEYWORD_NONE, .punctuator = PUNCT_NONE,
+        .symbol = SYMBOL_NONE, .number = { .kind = NUMBER_NONE } };
+}
+
+// Copy the text of zero-copy tokens into owned, NUL-terminated values
+static void materialize_tokens(Token* tokens, int count) {
+    for (int i = 0; i < count; i++) {
+        tokens[i].value = utils_safe_strndup(tokens[i].start, tokens[i].length);
+        tokens[i].start = tokens[i].value;
+    }
+}
+
+// --- Token Text Accessors ---
+const char* token_text(const Token* token) {
+    if (token->start) return token->start;
+    return token->value ? token->value : "";
+}
+
+int token_length(const Token* token) {
+    if (token->start) return token->length;
+    return token->value ? (int)strlen(token->value) : 0;
+}
+
+int token_equals(const Token* token, const char* text) {
+    size_t length = strlen(text);
+    return token_length(token) == (int)length && memcmp(token_text(token), text, length) == 0;
+}
+
+char* token_strdup(const Token* token) {
+    return utils_safe_strndup(token_text(token), token_length(token));
+}
+
+// Intern the token text on first use; equal spellings then compare by ID
+SymbolId token_symbol(Token* token) {
+    if (token->symbol == SYMBOL_NONE) {
+        token->symbol = intern(token_text(token), token_length(token));
+    }
+    return token->symbol;
+}
+
 // Free tokens array
 void free_tokens(Token* tokens, int count) {
     if (!tokens) return; // Prevent double-free errors
@@ -132,124 +319,118 @@ void handle_unterminated_comment(int line, int column, Token* tokens, int count)
     exit(1);
 }
 
+// Closest keyword within max_distance of a span, NULL if there is none.
+// Built-in keywords win ties over user-defined ones.
+static const char* closest_keyword(const char* text, int length, int max_distance) {
+    mutex_lock(&keyword_suggestions_lock);
+    if (!keyword_suggestions_ready) {
+        for (int i = 0; i < (int)(sizeof(keywords) / sizeof(keywords[0])); i++) {
+            suggestion_index_add(&keyword_suggestions, keywords[i], (int)strlen(keywords[i]));
+        }
+        for (int i = 0; i < user_defined_keywords_count; i++) {
+            suggestion_index_add(&keyword_suggestions, user_defined_keywords[i], (int)strlen(user_defined_keywords[i]));
+        }
+        keyword_suggestions_ready = 1;
+    }
+    const char* match = suggestion_index_closest(&keyword_suggestions, text, length, max_distance, NULL);
+    mutex_unlock(&keyword_suggestions_lock);
+    return match;
+}
+
 // Handle unknown characters
 void handle_unknown_character(char character, int line, int column) {
-    char tmp[2] = { character, '\0' };
     report_warning(line, column, "Unknown character encountered");
 
-    const char* closest_keyword = NULL;
-    int best_score = INT_MAX;
-
-    // Check built-in keywords
-    for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
-        int score = levenshtein_distance(tmp, keywords[i]);
-        if (score < best_score) {
-            best_score = score;
-            closest_keyword = keywords[i];
-        }
-    }
-    // Check user-defined keywords
-    for (int i = 0; i < user_defined_keywords_count; i++) {
-        int score = levenshtein_distance(tmp, user_defined_keywords[i]);
-        if (score < best_score) {
-            best_score = score;
-            closest_keyword = user_defined_keywords[i];
-        }
-    }
-    if (closest_keyword && best_score <= 2) {
+    const char* match = closest_keyword(&character, 1, 2);
+    if (match) {
         char suggestion[256];
-        snprintf(suggestion, sizeof(suggestion), "Did you mean '%s'?", closest_keyword);
+        snprintf(suggestion, sizeof(suggestion), "Did you mean '%s'?", match);
         report_warning(line, column, suggestion);
     }
 }
 
 // Tokenize identifiers and keywords
 void tokenize_identifier(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
-    char buffer[256] = { 0 };
-    int j = 0, start_column = *column;
+    int start = *i, start_column = *column;
     while (isalnum(code[*i]) || code[*i] == '_') {
-        buffer[j++] = code[(*i)++];
+        (*i)++;
         (*column)++;
     }
-    buffer[j] = '\0';
 
-    tokens[(*count)++] = (Token){
-        is_keyword(buffer) ? TOKEN_KEYWORD : TOKEN_IDENTIFIER,
-        utils_safe_strdup(buffer),
-        line,
-        start_column
-    };
+    KeywordId keyword = keyword_lookup(code + start, *i - start);
+    tokens[*count] = make_token(
+        keyword != KEYWORD_NONE ? TOKEN_KEYWORD : TOKEN_IDENTIFIER,
+        code, start, *i, start, line, start_column
+    );
+    tokens[(*count)++].keyword = keyword;
 }
 
 // Tokenize operators
 void tokenize_operator(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
-    char buffer[3] = { 0 };
-    int start_column = *column;
-    buffer[0] = code[*i];
+    int start = *i, start_column = *column;
 
     if ((strchr("=<>!+-", code[*i]) && code[*i + 1] == '=') ||
         ((code[*i] == '&' || code[*i] == '|') && code[*i + 1] == code[*i])) {
-        buffer[1] = code[++(*i)];
+        (*i)++;
         (*column)++;
     }
-    buffer[2] = '\0';
-
-    tokens[(*count)++] = (Token){ TOKEN_OPERATOR, utils_safe_strdup(buffer), line, start_column };
     (*i)++;
     (*column)++;
+
+    tokens[*count] = make_token(TOKEN_OPERATOR, code, start, *i, start, line, start_column);
+    tokens[(*count)++].punctuator = punctuator_lookup(code + start, *i - start);
 }
 
 // Process hexadecimal or binary literals
-void process_hex_or_binary_literal(
-    const char* code,
-    int* i,
-    int* column,
-    char* buffer,
-    int* j
-) {
-    buffer[(*j)++] = code[(*i)++];
-    buffer[(*j)++] = code[(*i)++];
+void process_hex_or_binary_literal(const char* code, int* i, int* column) {
+    int is_binary = code[*i + 1] == 'b';
+    (*i) += 2;
     (*column) += 2;
 
     while (isxdigit(code[*i]) ||
-        (buffer[1] == 'b' && (code[*i] == '0' || code[*i] == '1'))) {
-        buffer[(*j)++] = code[(*i)++];
+        (is_binary && (code[*i] == '0' || code[*i] == '1'))) {
+        (*i)++;
         (*column)++;
     }
 }
 
 // Process decimal literals
-void process_decimal_literal(
-    const char* code,
-    int* i,
-    int* column,
-    char* buffer,
-    int* j
-) {
+void process_decimal_literal(const char* code, int* i, int* column) {
     int has_decimal = 0;
     while (isdigit(code[*i]) || (code[*i] == '.' && !has_decimal)) {
         if (code[*i] == '.') has_decimal = 1;
-        buffer[(*j)++] = code[(*i)++];
+        (*i)++;
         (*column)++;
     }
 }
 
 // Tokenize literals
 void tokenize_literal(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
-    char buffer[256] = { 0 };
-    int j = 0, start_column = *column;
+    int start = *i, start_column = *column;
 
     if (code[*i] == '0' && (code[*i + 1] == 'x' || code[*i + 1] == 'b')) {
         // Process hexadecimal or binary literal
-        process_hex_or_binary_literal(code, i, column, buffer, &j);
+        process_hex_or_binary_literal(code, i, column);
     }
     else {
         // Process decimal literal
-        process_decimal_literal(code, i, column, buffer, &j);
+        process_decimal_literal(code, i, column);
     }
 
-    buffer[j] = '\0'; // Null-terminate the string
-    tokens[(*count)++] = (Token){ TOKEN_LITERAL, utils_safe_strdup(buffer), line, start_column };
+    tokens[*count] = make_token(TOKEN_LITERAL, code, start, *i, start, line, start_column);
+    tokens[(*count)++].number = number_literal_value(code + start, *i - start);
+}
+
+// Advance past one character, keeping line and column in step with the offset
+static void advance_char(const char* code, int* i, int* column, int* line) {
+    if (code[*i] == '\n') {
+        (*line)++;
+        *column = 1;
+    }
+    else {
+        (*column)++;
+    }
+    (*i)++;
 }
 
 // Process string content
@@ -257,84 +438,71 @@ void process_string_content(
     const char* code,
     int* i,
     int* column,
-    char* buffer,
-    int* j,
-    int line,
+    int* line,
+    int start_line,
     int start_column,
     int start_position,
     Token* tokens,
     int* count
 ) {
     while (code[*i] != '"' && code[*i] != '\0') {
-        if (code[*i] == '\\') {  // Handle escape sequences
-            buffer[(*j)++] = code[(*i)++];
+        if (code[*i] == '\\') {  // Handle escape sequences: skip the backslash and the escaped character
+            advance_char(code, i, column, line);
+            if (code[*i] != '\0') {
+                advance_char(code, i, column, line);
+            }
         }
         else if (code[*i] == '$' && code[*i + 1] == '{') {  // Start of interpolation
-            buffer[(*j)++] = code[(*i)++];
-            buffer[(*j)++] = code[(*i)++];
+            (*i) += 2;
+            (*column) += 2;
             while (code[*i] != '}' && code[*i] != '\0') {  // Read until closing brace
-                buffer[(*j)++] = code[(*i)++];
+                advance_char(code, i, column, line);
             }
             if (code[*i] == '}') {  // Include closing brace
-                buffer[(*j)++] = code[(*i)++];
+                (*i)++;
+                (*column)++;
             }
             else {  // Unterminated interpolation
-                handle_unterminated_string(line, start_column, code, start_position, tokens, *count, NULL);
+                handle_unterminated_string(start_line, start_column, code, start_position, tokens, *count, start_position);
             }
         }
         else {
-            buffer[(*j)++] = code[(*i)++];
+            advance_char(code, i, column, line);
         }
-        (*column)++;
     }
 }
 
-// Tokenize string literals
-void tokenize_string(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
-    char buffer[256] = { 0 };  // Buffer to hold the string value
-    int j = 0, start_column = *column;
+// Tokenize string literals (the token text excludes the quotes)
+void tokenize_string(const char* code, int* i, int* column, int* line, Token* tokens, int* count) {
+    int start_line = *line;
+    int start_column = *column;
     int start_position = *i;
 
     (*i)++; // Skip the opening quote
     (*column)++;
 
     // Process the string content
-    process_string_content(code, i, column, buffer, &j, line, start_column, start_position, tokens, count);
+    process_string_content(code, i, column, line, start_line, start_column, start_position, tokens, count);
+    int end = *i;
 
     if (code[*i] == '"') {  // Closing quote
         (*i)++;
         (*column)++;
     }
     else {  // Handle unterminated string
-        handle_unterminated_string(line, start_column, code, start_position, tokens, *count, NULL);
+        handle_unterminated_string(start_line, start_column, code, start_position, tokens, *count, start_position);
     }
 
-    buffer[j] = '\0';  // Null-terminate the string
-    tokens[(*count)++] = (Token){ TOKEN_STRING,utils_safe_strdup(buffer), line, start_column };
+    tokens[(*count)++] = make_token(TOKEN_STRING, code, start_position + 1, end, start_position, start_line, start_column);
 }
 
 // Tokenize symbols
 void tokenize_symbol(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
-    char buffer[2] = { code[*i], '\0' };
-
-    // Handle semicolon as an optional symbol
-    if (code[*i] == ';') {
-        tokens[(*count)++] = (Token){ TOKEN_SYMBOL, utils_safe_strdup(buffer), line, *column };
-        (*i)++;  // Move past semicolon
-        (*column)++;
-        return;  // Stop further processing
-    }
+    // Handle colon for switch-case and type; semicolons and other symbols are plain symbols
+    TokenType type = code[*i] == ':' ? TOKEN_COLON : TOKEN_SYMBOL;
 
-    // Handle colon for switch-case and type
-    if (code[*i] == ':') {
-        tokens[(*count)++] = (Token){ TOKEN_COLON, utils_safe_strdup(buffer), line, *column };
-        (*i)++;
-        (*column)++;
-        return;
-    }
-
-    // Default handling for other symbols
-    tokens[(*count)++] = (Token){ TOKEN_SYMBOL, utils_safe_strdup(buffer), line, *column };
+    tokens[*count] = make_token(type, code, *i, *i + 1, *i, line, *column);
+    tokens[(*count)++].punctuator = punctuator_lookup(code + *i, 1);
     (*i)++;
     (*column)++;
 }
@@ -379,14 +547,14 @@ void process_multi_line_comment(
 }
 
 // Tokenize comments
-void tokenize_comment(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
+void tokenize_comment(const char* code, int* i, int* column, int* line, Token* tokens, int* count) {
     if (code[*i + 1] == '/') {
         // Process single-line comment
         process_single_line_comment(code, i, column);
     }
     else if (code[*i + 1] == '*') {
         // Process multi-line comment
-        process_multi_line_comment(code, i, column, &line, tokens, count);
+        process_multi_line_comment(code, i, column, line, tokens, count);
     }
 }
 
@@ -413,30 +581,30 @@ int dispatch_tokenizer(
     const char* code,
     int* i,
     int* column,
-    int line,
+    int* line,
     Token* tokens,
     int* count
 ) {
     if (isalpha(code[*i]) || code[*i] == '_') {
-        tokenize_identifier(code, i, column, line, tokens, count);
+        tokenize_identifier(code, i, column, *line, tokens, count);
     }
     else if (strchr("=+*-<>!&|", code[*i])) {
-        tokenize_operator(code, i, column, line, tokens, count);
+        tokenize_operator(code, i, column, *line, tokens, count);
     }
     else if (isdigit(code[*i]) || (code[*i] == '0' && (code[*i + 1] == 'x' || code[*i + 1] == 'b'))) {
-        tokenize_literal(code, i, column, line, tokens, count);
+        tokenize_literal(code, i, column, *line, tokens, count);
     }
     else if (code[*i] == '"') {
         tokenize_string(code, i, column, line, tokens, count);
     }
     else if (strchr(";(){}", code[*i])) {
-        tokenize_symbol(code, i, column, line, tokens, count);
+        tokenize_symbol(code, i, column, *line, tokens, count);
     }
     else if (code[*i] == '/' && (code[*i + 1] == '/' || code[*i + 1] == '*')) {
         tokenize_comment(code, i, column, line, tokens, count);
     }
     else if (strchr(",;(){}", code[*i])) {
-        tokenize_symbol(code, i, column, line, tokens, count);
+        tokenize_symbol(code, i, column, *line, tokens, count);
     }
     else {
         return 0; // Unknown character
@@ -445,12 +613,14 @@ int dispatch_tokenizer(
 }
 
 // Add EOF token
-void add_eof_token(Token* tokens, int* count, int line, int column) {
-    tokens[(*count)++] = (Token){ TOKEN_EOF, utils_safe_strdup(""), line, column };
+void add_eof_token(const char* code, int position, Token* tokens, int* count, int line, int column) {
+    tokens[(*count)++] = make_token(TOKEN_EOF, code, position, position, position, line, column);
 }
 
-// Tokenize the input
-Token* tokenize(const char* code, int* token_count) {
+// Reference tokenizer: the original strchr/isalpha dispatch, kept so the
+// table-driven lexer can be checked and benchmarked against it
+
+Token* tokenize_reference(const char* code, int* token_count) {
     int capacity = 100;
     Token* tokens = malloc(capacity * sizeof(Token));
     if (!tokens) {
@@ -473,18 +643,564 @@ Token* tokenize(const char* code, int* token_count) {
         }
 
         // Dispatch tokenizer
-        if (!dispatch_tokenizer(code, &i, &column, line, tokens, &count)) {
+        if (!dispatch_tokenizer(code, &i, &column, &line, tokens, &count)) {
             handle_unknown_character_and_advance(code, &i, &column, line);
         }
     }
 
     // Add EOF token
-    add_eof_token(tokens, &count, line, column);
+    if (count >= capacity) {
+        tokens = resize_tokens(tokens, &capacity);
+    }
+    add_eof_token(code, i, tokens, &count, line, column);
+
+    *token_count = count;
+    return tokens;
+}
+
+// --- Table-Driven Lexer ---
+// Every byte maps to one entry: the low bits are the character class the
+// lexer dispatches on, the high bits flag the inner-loop membership tests.
+enum {
+    CHAR_OTHER, CHAR_END, CHAR_SPACE, CHAR_NEWLINE, CHAR_IDENT,
+    CHAR_DIGIT, CHAR_OPERATOR, CHAR_QUOTE, CHAR_SYMBOL, CHAR_SLASH
+};
+#define CHAR_CLASS_MASK 0x0F
+#define CHAR_FLAG_IDENT 0x10  // May continue an identifier: [A-Za-z0-9_]
+#define CHAR_FLAG_HEX   0x20  // Hexadecimal digit: [0-9A-Fa-f]
+
+#define OT CHAR_OTHER
+#define CE CHAR_END
+#define SP CHAR_SPACE
+#define NL CHAR_NEWLINE
+#define ID (CHAR_IDENT | CHAR_FLAG_IDENT)
+#define IH (CHAR_IDENT | CHAR_FLAG_IDENT | CHAR_FLAG_HEX)
+#define DG (CHAR_DIGIT | CHAR_FLAG_IDENT | CHAR_FLAG_HEX)
+#define OP CHAR_OPERATOR
+#define QT CHAR_QUOTE
+#define SY CHAR_SYMBOL
+#define SL CHAR_SLASH
+
+static const unsigned char char_table[256] = {
+    CE, OT, OT, OT, OT, OT, OT, OT, OT, SP, NL, SP, SP, SP, OT, OT,  // 0x00
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0x10
+    SP, OP, QT, OT, OT, OT, OP, OT, SY, SY, OP, OP, SY, OP, OT, SL,  // 0x20  !"#$%&'()*+,-./
+    DG, DG, DG, DG, DG, DG, DG, DG, DG, DG, OT, SY, OP, OP, OP, OT,  // 0x30 0123456789:;<=>?
+    OT, IH, IH, IH, IH, IH, IH, ID, ID, ID, ID, ID, ID, ID, ID, ID,  // 0x40 @ABCDEFGHIJKLMNO
+    ID, ID, ID, ID, ID, ID, ID, ID, ID, ID, ID, OT, OT, OT, OT, ID,  // 0x50 PQRSTUVWXYZ[\]^_
+    OT, IH, IH, IH, IH, IH, IH, ID, ID, ID, ID, ID, ID, ID, ID, ID,  // 0x60 `abcdefghijklmno
+    ID, ID, ID, ID, ID, ID, ID, ID, ID, ID, ID, SY, OP, SY, OT, OT,  // 0x70 pqrstuvwxyz{|}~
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0x80
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0x90
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0xA0
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0xB0
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0xC0
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0xD0
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0xE0
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  // 0xF0
+};
+
+#undef OT
+#undef CE
+#undef SP
+#undef NL
+#undef ID
+#undef IH
+#undef DG
+#undef OP
+#undef QT
+#undef SY
+#undef SL
+
+#define CHAR_CLASS(c) (char_table[(unsigned char)(c)] & CHAR_CLASS_MASK)
+#define CHAR_HAS(c, flag) (char_table[(unsigned char)(c)] & (flag))
+#define LEXER_COLUMN(lexer, position) ((position) - (lexer)->line_start + 1)
+
+// Initialize a lexer over `length` bytes of source; the buffer need not be NUL-terminated
+void lexer_init_length(Lexer* lexer, const char* code, int length) {
+    lexer_init_range(lexer, code, 0, length, 1);
+}
+
+// Initialize a lexer over code[start, end); `start` must begin line `line`.
+// Token offsets stay relative to `code`.
+void lexer_init_range(Lexer* lexer, const char* code, int start, int end, int line) {
+    lexer->code = code;
+    lexer->length = end;
+    lexer->kernels = scan_kernels();
+    lexer->position = start;
+    lexer->line = line;
+    lexer->line_start = start;
+    lexer->diagnostics = NULL;
+}
+
+// Initialize a lexer over a NUL-terminated source buffer
+void lexer_init(Lexer* lexer, const char* code) {
+    lexer_init_length(lexer, code, (int)strlen(code));
+}
+
+// Byte at `position`, or '\0' past the end of the source; all lookahead goes through here
+static char lexer_char(const Lexer* lexer, int position) {
+    return position < lexer->length ? lexer->code[position] : '\0';
+}
+
+// Record the newline at `position`
+static void lexer_newline(Lexer* lexer, int position) {
+    lexer->line++;
+    lexer->line_start = position + 1;
+}
+
+// Exact powers of ten: a float with at most 15-16 significant digits and at most
+// 22 fractional digits is one correctly rounded IEEE division away from its value
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAX_MANTISSA_DIGITS 19  // Decimal digits that always fit in an unsigned long long
+
+// Slow path for floats the fast path cannot round exactly
+static double parse_float_slow(const char* text, int length) {
+    char small[64];
+    char* copy = length < (int)sizeof(small) ? small : safe_malloc(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    double value = strtod(copy, NULL);
+    if (copy != small) free(copy);
+    return value;
+}
+
+static int hex_digit_value(char c) {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+// Scan a number literal starting at `p` and compute its value on the way;
+// returns the offset just past the literal
+static int scan_number(const char* code, int p, int end, NumberValue* number) {
+#define NUMBER_CHAR(i) ((i) < end ? code[i] : '\0')
+    int start = p;
+
+    // Hexadecimal or binary: overflow-checked shift-and-add
+    if (NUMBER_CHAR(p) == '0' && (NUMBER_CHAR(p + 1) == 'x' || NUMBER_CHAR(p + 1) == 'b')) {
+        int shift = NUMBER_CHAR(p + 1) == 'x' ? 4 : 1;
+        int invalid = 0, overflow = 0;
+        unsigned long long value = 0;
+        p += 2;
+        int digits = p;
+        while (CHAR_HAS(NUMBER_CHAR(p), CHAR_FLAG_HEX)) {
+            int digit = hex_digit_value(code[p++]);
+            if (digit >> shift) invalid = 1;  // Non-binary digit in a binary literal
+            if (value > ((unsigned long long)LLONG_MAX - digit) >> shift) overflow = 1;
+            else value = (value << shift) | digit;
+        }
+        if (invalid || p == digits) {
+            number->kind = NUMBER_INVALID;
+            number->integer = 0;
+        }
+        else {
+            number->kind = overflow ? NUMBER_OVERFLOW : NUMBER_INT;
+            number->integer = overflow ? LLONG_MAX : (long long)value;
+        }
+        return p;
+    }
+
+    // Decimal: accumulate up to 19 significant digits as value = mantissa * 10^exponent
+    unsigned long long mantissa = 0;
+    int significant = 0, exponent = 0, truncated = 0;
+    while (CHAR_CLASS(NUMBER_CHAR(p)) == CHAR_DIGIT) {
+        if (significant < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (code[p] - '0');
+            if (mantissa) significant++;
+        }
+        else {
+            exponent++;
+            truncated = 1;
+        }
+        p++;
+    }
+    if (NUMBER_CHAR(p) != '.') {
+        number->kind = truncated || mantissa > LLONG_MAX ? NUMBER_OVERFLOW : NUMBER_INT;
+        number->integer = number->kind == NUMBER_INT ? (long long)mantissa : LLONG_MAX;
+        return p;
+    }
+    p++;
+    while (CHAR_CLASS(NUMBER_CHAR(p)) == CHAR_DIGIT) {
+        if (significant < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (code[p] - '0');
+            if (mantissa) significant++;
+            exponent--;
+        }
+        else if (code[p] != '0') {
+            truncated = 1;
+        }
+        p++;
+    }
+
+    number->kind = NUMBER_FLOAT;
+    if (!truncated && mantissa <= (1ULL << 53) && exponent >= -22) {
+        number->real = (double)mantissa / exact_powers_of_ten[-exponent];
+    }
+    else {
+        number->real = parse_float_slow(code + start, p - start);
+    }
+    return p;
+#undef NUMBER_CHAR
+}
+
+// Scan a number literal at `p`; returns the position just past it
+static int lexer_scan_number(const Lexer* lexer, int p, NumberValue* number) {
+    return scan_number(lexer->code, p, lexer->length, number);
+}
+
+// Value of a number literal spelled by text[0, length)
+NumberValue number_literal_value(const char* text, int length) {
+    NumberValue number = { NUMBER_NONE };
+    if (length > 0 && CHAR_CLASS(text[0]) == CHAR_DIGIT) {
+        scan_number(text, 0, length, &number);
+    }
+    return number;
+}
+
+// Record a problem in recovering mode
+static void lexer_diagnose(Lexer* lexer, DiagnosticSeverity severity, int line, int column, int start, int end, const char* message) {
+    diagnostics_add(lexer->diagnostics, severity, line, column, start, end - start, message);
+}
+
+// Report a string opened at `start` that never closes. Recovering mode rewinds
+// to the opening line and returns the end of that line, so scanning resumes
+// on the next line instead of swallowing the rest of the source.
+static int lexer_unterminated_string(Lexer* lexer, int start, int start_line, int start_line_start) {
+    int start_column = start - start_line_start + 1;
+    if (!lexer->diagnostics) {
+        handle_unterminated_string(start_line, start_column, lexer->code, start, NULL, 0, start);
+        return lexer->length;
+    }
+
+    lexer->line = start_line;
+    lexer->line_start = start_line_start;
+    const char* newline = memchr(lexer->code + start, '\n', lexer->length - start);
+    int end = newline ? (int)(newline - lexer->code) : lexer->length;
+    lexer_diagnose(lexer, DIAGNOSTIC_ERROR, start_line, start_column, start, end,
+        "Unterminated string literal. Hint: Ensure the string is closed with a matching quote.");
+    return end;
+}
+
+// Scan the body of a string whose opening quote is at `p`. Returns 1 and
+// stores the position of the closing quote in `end`; an unterminated string
+// returns 0 and stores the end of its error span
+static int lexer_scan_string(Lexer* lexer, int p, int* end) {
+    const char* code = lexer->code;
+    int start = p, start_line = lexer->line, start_line_start = lexer->line_start;
+
+    p++;
+    for (;;) {
+        // Jump to the next quote, backslash or '$'
+        p = lexer->kernels->find_string_special(code, p, lexer->length, &lexer->line, &lexer->line_start);
+        if (p >= lexer->length) {
+            *end = lexer_unterminated_string(lexer, start, start_line, start_line_start);
+            return 0;
+        }
+        switch (code[p]) {
+        case '"':
+            *end = p;
+            return 1;
+        case '\\':  // Escape sequence: skip the backslash and the escaped character
+            if (lexer_char(lexer, p + 1) == '\n') lexer_newline(lexer, p + 1);
+            p += p + 1 < lexer->length ? 2 : 1;
+            break;
+        case '$':
+            if (lexer_char(lexer, p + 1) != '{') {
+                p++;
+                break;
+            }
+            for (p += 2; p < lexer->length && code[p] != '}'; p++) {  // Interpolation runs to the closing brace
+                if (code[p] == '\n') lexer_newline(lexer, p);
+            }
+            if (p >= lexer->length) {
+                *end = lexer_unterminated_string(lexer, start, start_line, start_line_start);
+                return 0;
+            }
+            p++;
+            break;
+        }
+    }
+}
+
+// Warn about an unknown character, which is skipped
+static void lexer_unknown_character(Lexer* lexer, int p) {
+    if (!lexer->diagnostics) {
+        handle_unknown_character(lexer->code[p], lexer->line, LEXER_COLUMN(lexer, p));
+        return;
+    }
+    char message[64];
+    unsigned char c = (unsigned char)lexer->code[p];
+    if (c >= 0x20 && c < 0x7F) {
+        snprintf(message, sizeof(message), "Unknown character '%c'", c);
+    }
+    else {
+        snprintf(message, sizeof(message), "Unknown character 0x%02X", c);
+    }
+    lexer_diagnose(lexer, DIAGNOSTIC_WARNING, lexer->line, LEXER_COLUMN(lexer, p), p, p + 1, message);
+}
+
+// Skip whitespace, comments and unknown characters starting at `p`;
+// returns the position of the next token
+static int lexer_skip_trivia(Lexer* lexer, int p) {
+    const char* code = lexer->code;
+
+    for (;;) {
+        char c = lexer_char(lexer, p);
+        switch (CHAR_CLASS(c)) {
+        case CHAR_SPACE: {
+            int next = CHAR_CLASS(lexer_char(lexer, p + 1));
+            if (next != CHAR_SPACE && next != CHAR_NEWLINE) {
+                p++;  // A lone separator is cheaper to step over than to scan
+                break;
+            }
+        }
+            // fall through
+        case CHAR_NEWLINE:
+            p = lexer->kernels->skip_whitespace(code, p, lexer->length, &lexer->line, &lexer->line_start);
+            break;
+        case CHAR_SLASH:
+            if (lexer_char(lexer, p + 1) == '/') {  // Single-line comment
+                p = lexer->kernels->find_line_end(code, p + 2, lexer->length);
+                break;
+            }
+            if (lexer_char(lexer, p + 1) == '*') {  // Multi-line comment
+                int line = lexer->line, line_start = lexer->line_start;
+                int end = lexer->kernels->find_comment_end(code, p + 2, lexer->length, &lexer->line, &lexer->line_start);
+                if (end >= lexer->length) {
+                    if (lexer->diagnostics) {  // Rewind; lexer_next_token turns the comment into an error token
+                        lexer->line = line;
+                        lexer->line_start = line_start;
+                        return p;
+                    }
+                    handle_unterminated_comment(lexer->line, LEXER_COLUMN(lexer, lexer->length), NULL, 0);
+                    return lexer->length;
+                }
+                p = end + 2;
+                break;
+            }
+            // A lone '/' is not a token
+            lexer_unknown_character(lexer, p);
+            p++;
+            break;
+        case CHAR_END:
+            if (p >= lexer->length) {
+                return p;
+            }
+            // An embedded NUL byte is an unknown character, not the end of the source
+            // fall through
+        case CHAR_OTHER:
+            lexer_unknown_character(lexer, p);
+            p++;
+            break;
+        default:
+            return p;
+        }
+    }
+}
+
+// Produce the next token; returns 0 once the EOF token has been produced
+int lexer_next_token(Lexer* lexer, Token* token) {
+    const char* code = lexer->code;
+    int start = lexer_skip_trivia(lexer, lexer->position);
+    int line = lexer->line, column = LEXER_COLUMN(lexer, start);
+    int end = start + 1;
+    char c = lexer_char(lexer, start);
+
+    switch (CHAR_CLASS(c)) {
+    case CHAR_IDENT: {
+        while (end < lexer->length && CHAR_HAS(code[end], CHAR_FLAG_IDENT)) end++;
+        KeywordId keyword = keyword_lookup(code + start, end - start);
+        *token = make_token(keyword != KEYWORD_NONE ? TOKEN_KEYWORD : TOKEN_IDENTIFIER,
+            code, start, end, start, line, column);
+        token->keyword = keyword;
+        break;
+    }
+    case CHAR_DIGIT: {
+        NumberValue number;
+        end = lexer_scan_number(lexer, start, &number);
+        *token = make_token(TOKEN_LITERAL, code, start, end, start, line, column);
+        token->number = number;
+        break;
+    }
+    case CHAR_OPERATOR: {  // Every multi-character operator is recognized by scan_punctuator
+        int length;
+        PunctuatorId punctuator = scan_punctuator(c, lexer_char(lexer, start + 1), &length);
+        end = start + length;
+        *token = make_token(TOKEN_OPERATOR, code, start, end, start, line, column);
+        token->punctuator = punctuator;
+        break;
+    }
+    case CHAR_QUOTE:
+        if (!lexer_scan_string(lexer, start, &end)) {
+            *token = make_token(TOKEN_ERROR, code, start, end, start, line, column);
+            break;
+        }
+        *token = make_token(TOKEN_STRING, code, start + 1, end, start, line, column);
+        end++;  // Closing quote
+        break;
+    case CHAR_SYMBOL: {
+        int length;
+        *token = make_token(TOKEN_SYMBOL, code, start, end, start, line, column);
+        token->punctuator = scan_punctuator(c, '\0', &length);
+        break;
+    }
+    case CHAR_SLASH:  // Only an unterminated comment stops lexer_skip_trivia here (recovering mode)
+        lexer->kernels->find_comment_end(code, start + 2, lexer->length, &lexer->line, &lexer->line_start);
+        end = lexer->length;
+        lexer_diagnose(lexer, DIAGNOSTIC_ERROR, line, column, start, end,
+            "Unterminated multi-line comment. Multi-line comments must end with '*/'.");
+        *token = make_token(TOKEN_ERROR, code, start, end, start, line, column);
+        break;
+    default:  // End of the source
+        *token = make_token(TOKEN_EOF, code, start, start, start, line, column);
+        lexer->position = start;
+        return 0;
+    }
+
+    lexer->position = end;
+    return 1;
+}
+
+// lexer_next_token() through the reference strchr/isalpha dispatch chain, so
+// the two engines can be timed producing the same stream into the same slot.
+// Needs NUL-terminated, well-formed source: the reference error paths exit.
+int lexer_next_token_reference(Lexer* lexer, Token* token) {
+    const char* code = lexer->code;
+    int i = lexer->position, line = lexer->line, column = LEXER_COLUMN(lexer, i);
+    int count = 0;
+    while (count == 0) {  // Comments produce no token
+        if (code[i] == '\0') {
+            add_eof_token(code, i, token, &count, line, column);
+            lexer->position = i;
+            lexer->line = line;
+            lexer->line_start = i - column + 1;
+            return 0;
+        }
+        if (isspace(code[i])) {
+            handle_whitespace(code, &i, &line, &column);
+        }
+        else if (!dispatch_tokenizer(code, &i, &column, &line, token, &count)) {
+            handle_unknown_character_and_advance(code, &i, &column, line);
+        }
+    }
+    lexer->position = i;
+    lexer->line = line;
+    lexer->line_start = i - column + 1;
+    return 1;
+}
+
+// Run a lexer to EOF, collecting its tokens
+static Token* tokenize_with_lexer(Lexer* lexer, int* token_count) {
+    int capacity = 100, count = 0;
+    Token* tokens = malloc(capacity * sizeof(Token));
+    if (!tokens) {
+        fprintf(stderr, "Error: Initial memory allocation failed\n");
+        exit(1);
+    }
+
+    do {
+        if (count >= capacity) {
+            tokens = resize_tokens(tokens, &capacity);
+        }
+    } while (lexer_next_token(lexer, &tokens[count++]));
 
     *token_count = count;
     return tokens;
 }
 
+// Tokenize `length` bytes of source, recording every problem in `diagnostics`
+// and continuing: unterminated strings become TOKEN_ERROR tokens up to the end
+// of their line, unterminated comments become TOKEN_ERROR tokens up to the end
+// of the source, and unknown characters are skipped with a warning. Never
+// exits; if memory runs out, records an error and returns NULL.
+// Token text points into `code`.
+Token* tokenize_recovering(const char* code, int length, DiagnosticList* diagnostics, int* token_count) {
+    Lexer lexer;
+    lexer_init_length(&lexer, code, length);
+    lexer.diagnostics = diagnostics;
+
+    int capacity = 100, count = 0;
+    Token* tokens = malloc(capacity * sizeof(Token));
+    for (;;) {
+        if (tokens && count >= capacity) {
+            Token* grown = grow_tokens(tokens, &capacity);
+            if (!grown) {
+                free(tokens);
+            }
+            tokens = grown;
+        }
+        if (!tokens) {
+            diagnostics_add(diagnostics, DIAGNOSTIC_ERROR, lexer.line, LEXER_COLUMN(&lexer, lexer.position),
+                lexer.position, 0, "Out of memory while tokenizing");
+            *token_count = 0;
+            return NULL;
+        }
+        if (!lexer_next_token(&lexer, &tokens[count++])) {
+            break;
+        }
+    }
+
+    *token_count = count;
+    return tokens;
+}
+
+// Tokenize `length` bytes of source; token text points into `code`, which need not be NUL-terminated
+Token* tokenize_buffer(const char* code, int length, int* token_count) {
+    Lexer lexer;
+    lexer_init_length(&lexer, code, length);
+    return tokenize_with_lexer(&lexer, token_count);
+}
+
+// Tokenize code[start, end), where `start` begins line `line`; ends with an EOF token at `end`
+Token* tokenize_range(const char* code, int start, int end, int line, int* token_count) {
+    Lexer lexer;
+    lexer_init_range(&lexer, code, start, end, line);
+    return tokenize_with_lexer(&lexer, token_count);
+}
+
+// Measure every token span, then copy all token text into one right-sized arena allocation
+Token* tokenize_arena(const char* code, int length, Arena* arena, int* token_count) {
+    Token* tokens = tokenize_buffer(code, length, token_count);
+
+    size_t total = 0;
+    for (int i = 0; i < *token_count; i++) {
+        total += tokens[i].length + 1;
+    }
+    char* text = arena_alloc(arena, total);
+    for (int i = 0; i < *token_count; i++) {
+        memcpy(text, tokens[i].start, tokens[i].length);
+        text[tokens[i].length] = '\0';
+        tokens[i].start = text;
+        text += tokens[i].length + 1;
+    }
+    return tokens;
+}
+
+// Tokenize the input; token text points into `code`
+Token* tokenize_zero_copy(const char* code, int* token_count) {
+    return tokenize_buffer(code, (int)strlen(code), token_count);
+}
+
+// Map `path` into `source` and tokenize it; token text points into the mapping,
+// so close `source` only after the tokens are freed. Returns NULL if the file cannot be mapped.
+Token* tokenize_file(const char* path, SourceFile* source, int* token_count) {
+    if (!source_file_open(source, path)) {
+        *token_count = 0;
+        return NULL;
+    }
+    return tokenize_buffer(source->data, source->length, token_count);
+}
+
+// Tokenize the input; every token owns a copy of its text
+Token* tokenize(const char* code, int* token_count) {
+    Token* tokens = tokenize_zero_copy(code, token_count);
+    materialize_tokens(tokens, *token_count);
+    return tokens;
+}
+
 // Summarize errors
 void summarize_errors(int error_count, int warning_count) {
     if (error_count > 0) {
@@ -502,7 +1218,8 @@ bool is_whitespace(char c) {
 }
 void tokenize_for_loop(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
     if (strncmp(&code[*i], "let", 3) == 0 && is_whitespace(code[*i + 3])) {
-        tokens[(*count)++] = (Token){ TOKEN_KEYWORD, utils_safe_strdup("let"), line, *column };
+        tokens[*count] = make_token(TOKEN_KEYWORD, code, *i, *i + 3, *i, line, *column);
+        tokens[(*count)++].keyword = KEYWORD_LET;
         *i += 3;
         *column += 3;
         return;
@@ -511,7 +1228,8 @@ void tokenize_for_loop(const char* code, int* i, int* column, int line, Token* t
 
 void tokenize_record(const char* code, int* i, int* column, int line, Token* tokens, int* count) {
     if (strncmp(&code[*i], "record", 6) == 0 && is_whitespace(code[*i + 6])) {
-        tokens[(*count)++] = (Token){ TOKEN_KEYWORD, utils_safe_strdup("record"), line, *column };
+        tokens[*count] = make_token(TOKEN_KEYWORD, code, *i, *i + 6, *i, line, *column);
+        tokens[(*count)++].keyword = KEYWORD_RECORD;
         *i += 6;
         *column += 6;
         return;
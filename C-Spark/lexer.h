@@ -5,27 +5,118 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#include "source_file.h"
+#include "interner.h"
+#include "arena.h"
+#include "error_reporting.h"
 
 // Define token types
 typedef enum {
     TOKEN_KEYWORD, TOKEN_IDENTIFIER, TOKEN_OPERATOR,
     TOKEN_LITERAL, TOKEN_SYMBOL, TOKEN_STRING,
-    TOKEN_COMMENT, TOKEN_EOF, TOKEN_COLON // Added TOKEN_COLON
+    TOKEN_COMMENT, TOKEN_EOF, TOKEN_COLON, // Added TOKEN_COLON
+    TOKEN_ERROR  // Malformed text skipped by the recovering lexer (see tokenize_recovering)
 } TokenType;
 
+// Keyword IDs; keywords[] in lexer.c is indexed by (id - 1)
+typedef enum {
+    KEYWORD_NONE,
+    KEYWORD_LET, KEYWORD_PRINT, KEYWORD_IF, KEYWORD_ELSE, KEYWORD_FOR, KEYWORD_FUNC, KEYWORD_RETURN,
+    KEYWORD_STRUCT, KEYWORD_RECORD, KEYWORD_INTERFACE, KEYWORD_VIRTUAL, KEYWORD_TRY, KEYWORD_CATCH, KEYWORD_DEFER,
+    KEYWORD_SWITCH, KEYWORD_CASE, KEYWORD_DEFAULT, KEYWORD_BREAK, KEYWORD_ENUM,
+    KEYWORD_USER_DEFINED  // User-defined keyword i gets ID KEYWORD_USER_DEFINED + i
+} KeywordId;
+
+// Operator and punctuator IDs, so the parser can switch on a token instead of
+// comparing its text; punctuator_name() gives the spelling
+typedef enum {
+    PUNCT_NONE,
+    PUNCT_LPAREN, PUNCT_RPAREN, PUNCT_LBRACE, PUNCT_RBRACE, PUNCT_COMMA, PUNCT_SEMICOLON, PUNCT_COLON,
+    PUNCT_ASSIGN, PUNCT_EQ, PUNCT_NOT, PUNCT_NE, PUNCT_LT, PUNCT_LE, PUNCT_GT, PUNCT_GE,
+    PUNCT_PLUS, PUNCT_PLUS_ASSIGN, PUNCT_MINUS, PUNCT_MINUS_ASSIGN, PUNCT_STAR, PUNCT_SLASH,
+    PUNCT_AND, PUNCT_AND_AND, PUNCT_OR, PUNCT_OR_OR,
+    PUNCT_COUNT
+} PunctuatorId;
+
+// Kind of value a number literal holds
+typedef enum {
+    NUMBER_NONE,       // Not a number literal
+    NUMBER_INT,        // Fits in a long long
+    NUMBER_FLOAT,      // Has a decimal point (correctly rounded; +inf past the double range)
+    NUMBER_OVERFLOW,   // Integer too large for a long long; integer is LLONG_MAX
+    NUMBER_INVALID     // Malformed, e.g. "0x" with no digits or "0b12"
+} NumberKind;
+
+// Value of a number literal, computed while it is scanned
+typedef struct {
+    NumberKind kind;
+    union {
+        long long integer; // NUMBER_INT, NUMBER_OVERFLOW
+        double real;       // NUMBER_FLOAT
+    };
+} NumberValue;
+
 // Token structure
 typedef struct {
     TokenType type;
-    char* value; // Dynamically allocated value
+    char* value;       // Owned copy of the token text (NULL for zero-copy tokens)
     int line;
     int column;
+    const char* start; // Token text; points into the source buffer for zero-copy tokens
+    int length;        // Length of the token text in bytes
+    int offset;        // Byte offset of the token in the source buffer
+    KeywordId keyword; // Keyword ID for TOKEN_KEYWORD tokens, KEYWORD_NONE otherwise
+    PunctuatorId punctuator; // ID of TOKEN_OPERATOR and TOKEN_SYMBOL tokens, PUNCT_NONE otherwise
+    SymbolId symbol;   // Interned text, SYMBOL_NONE until token_symbol() is first called
+    NumberValue number; // Value of TOKEN_LITERAL tokens; kind NUMBER_NONE for other tokens
 } Token;
 
+// printf helpers for token text, which is not NUL-terminated for zero-copy tokens:
+//     printf("'" TOKEN_FMT "'", TOKEN_ARG(token));
+#define TOKEN_FMT "%.*s"
+#define TOKEN_ARG(token) token_length(token), token_text(token)
+
+// Table-driven lexer state; produces one token per lexer_next_token() call
+typedef struct {
+    const char* code;  // Source buffer (need not be NUL-terminated)
+    int length;        // End offset of the source; the lexer never reads at or past it
+    const struct ScanKernels* kernels; // Whitespace/comment/string scanners chosen for this CPU
+    int position;      // Offset of the next unread byte
+    int line;          // Current line (1-based)
+    int line_start;    // Offset of the first byte of the current line
+    DiagnosticList* diagnostics; // Recovering mode when set: problems are recorded here instead of printed or fatal
+} Lexer;
+
 // Public API functions
 int is_keyword(const char* str);                      // Check if a string is a keyword
+NumberValue number_literal_value(const char* text, int length); // Value of a number literal spelled by a source span
+KeywordId keyword_lookup(const char* text, int length); // Keyword ID of a source span, KEYWORD_NONE if it is not a keyword
+const char* keyword_name(KeywordId keyword);          // Spelling of a keyword ID (NULL if unknown)
+PunctuatorId punctuator_lookup(const char* text, int length); // Punctuator ID of a source span, PUNCT_NONE if it is not one
+const char* punctuator_name(PunctuatorId punctuator); // Spelling of a punctuator ID (NULL if unknown)
+void set_user_defined_keywords(const char** keywords, int count); // Register extra keywords (the strings must outlive the lexer)
 Token* resize_tokens(Token* tokens, int* capacity);   // Resize the token array
 void free_tokens(Token* tokens, int count);           // Free the tokens array
 Token* tokenize(const char* code, int* token_count);  // Main tokenize function
+Token* tokenize_zero_copy(const char* code, int* token_count); // Tokenize without copying token text (code must outlive the tokens)
+Token* tokenize_buffer(const char* code, int length, int* token_count); // Zero-copy tokenize of `length` bytes (no NUL terminator needed)
+Token* tokenize_arena(const char* code, int length, Arena* arena, int* token_count); // Tokenize, copying all token text once into `arena` (tokens no longer need `code`)
+Token* tokenize_range(const char* code, int start, int end, int line, int* token_count); // Zero-copy tokenize of code[start, end); `start` begins line `line`
+Token* tokenize_recovering(const char* code, int length, DiagnosticList* diagnostics, int* token_count); // Tokenize without ever exiting; problems go to `diagnostics` (NULL only if out of memory)
+Token* tokenize_file(const char* path, SourceFile* source, int* token_count); // Map a file and tokenize it zero-copy; close `source` after freeing the tokens
+Token* tokenize_reference(const char* code, int* token_count); // Original strchr-based tokenizer, kept for equivalence checks and benchmarks
+void lexer_init(Lexer* lexer, const char* code);      // Start lexing NUL-terminated `code` from the beginning
+void lexer_init_length(Lexer* lexer, const char* code, int length); // Start lexing `length` bytes of `code`
+void lexer_init_range(Lexer* lexer, const char* code, int start, int end, int line); // Lex code[start, end); `start` begins line `line`
+int lexer_next_token(Lexer* lexer, Token* token);     // Produce the next token; returns 0 once EOF has been produced
+int lexer_next_token_reference(Lexer* lexer, Token* token); // Same, through tokenize_reference()'s dispatch chain (NUL-terminated, well-formed `code`)
 void summarize_errors(int error_count, int warning_count); // Summarize tokenization errors and warnings
 
+// Token text accessors
+const char* token_text(const Token* token);           // Start of the token text (not NUL-terminated for zero-copy tokens)
+int token_length(const Token* token);                 // Length of the token text
+int token_equals(const Token* token, const char* text); // Compare the token text with a NUL-terminated string
+char* token_strdup(const Token* token);               // Heap copy of the token text
+SymbolId token_symbol(Token* token);                  // Interned symbol of the token text (cached in the token)
+
 #endif // LEXER_H
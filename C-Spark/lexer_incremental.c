@@ -0,0 +1,160 @@
+// lexer_incremental.c
+#include "lexer_incremental.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Apply an edit to a copy of the source
+char* apply_text_edit(const char* code, int length, const TextEdit* edit, int* new_length) {
+    int tail = length - edit->offset - edit->deleted_length;
+    *new_length = length - edit->deleted_length + edit->inserted_length;
+    char* edited = malloc(*new_length + 1);
+    if (!edited) {
+        fprintf(stderr, "Error: Memory allocation failed while applying an edit\n");
+        exit(1);
+    }
+    memcpy(edited, code, edit->offset);
+    memcpy(edited + edit->offset, edit->inserted, edit->inserted_length);
+    memcpy(edited + edit->offset + edit->inserted_length, code + edit->offset + edit->deleted_length, tail);
+    edited[*new_length] = '\0';
+    return edited;
+}
+
+// Point a zero-copy token at its text in the new source buffer
+static void rebase_token(Token* token, const char* code) {
+    if (!token->value) {
+        token->start = code + token->offset + (token->type == TOKEN_STRING);  // String text follows the quote
+    }
+}
+
+// Index of the last token starting before `offset`, or 0 if there is none
+static int last_token_before(const Token* tokens, int count, int offset) {
+    int low = 0, high = count - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (tokens[middle].offset < offset) low = middle;
+        else high = middle - 1;
+    }
+    return low;
+}
+
+// Re-lex the edited region and splice the result into the token array
+Token* relex_tokens(Token* tokens, int* token_count, const char* code, int length,
+    const TextEdit* edit, DiagnosticList* diagnostics, RelexRange* changed) {
+    int count = *token_count;
+    int delta = edit->inserted_length - edit->deleted_length;
+    int old_edit_end = edit->offset + edit->deleted_length;
+    int new_edit_end = edit->offset + edit->inserted_length;
+
+    // Restart one token early: a token ending at the edit may grow into it, and
+    // the token before that may have looked ahead past its own end
+    int first = last_token_before(tokens, count, edit->offset);
+    if (first > 0) first--;
+
+    // A token always starts in the lexer's start state, so lexing can resume there.
+    // Before the second token it resumes at the start of the source instead, so
+    // text inserted ahead of the first token is lexed too.
+    Lexer lexer;
+    if (first > 0) {
+        lexer_init_range(&lexer, code, tokens[first].offset, length, tokens[first].line);
+        lexer.line_start = tokens[first].offset - tokens[first].column + 1;
+    }
+    else {
+        lexer_init_range(&lexer, code, 0, length, 1);
+    }
+    DiagnosticList dropped;
+    diagnostics_init(&dropped);
+    lexer.diagnostics = diagnostics ? diagnostics : &dropped;
+
+    // Lex until a token starts past the edit exactly where an old token started;
+    // from there on the text, and so the token stream, is unchanged
+    int capacity = 16, relexed = 0, old_index = first, resync = count;
+    Token* fresh = malloc(capacity * sizeof(Token));
+    if (!fresh) {
+        fprintf(stderr, "Error: Memory allocation failed while re-lexing\n");
+        exit(1);
+    }
+    for (;;) {
+        if (relexed >= capacity) {
+            fresh = resize_tokens(fresh, &capacity);
+        }
+        int more = lexer_next_token(&lexer, &fresh[relexed]);
+        Token* token = &fresh[relexed];
+
+        if (token->offset >= new_edit_end) {
+            int old_offset = token->offset - delta;
+            while (old_index < count && tokens[old_index].offset < old_offset) old_index++;
+            if (old_index < count && tokens[old_index].offset == old_offset && old_offset >= old_edit_end) {
+                resync = old_index;
+                break;
+            }
+        }
+        relexed++;
+        if (!more) break;
+    }
+
+    // Shift the unchanged tail; columns move only on the line the re-lexed region ends on
+    if (resync < count) {
+        const Token* anchor = &fresh[relexed];
+        int line_delta = anchor->line - tokens[resync].line;
+        int column_delta = anchor->column - tokens[resync].column;
+        int anchor_line = tokens[resync].line;
+        for (int i = resync; i < count && tokens[i].line == anchor_line; i++) {
+            tokens[i].column += column_delta;
+        }
+        for (int i = resync; i < count; i++) {
+            tokens[i].line += line_delta;
+            tokens[i].offset += delta;
+            rebase_token(&tokens[i], code);
+        }
+    }
+
+    // Lexing restarts early, so the first few tokens usually come out as they
+    // were; they are not reported as changed
+    int unchanged = 0;
+    while (unchanged < relexed && first + unchanged < resync) {
+        const Token* before = &tokens[first + unchanged];
+        const Token* after = &fresh[unchanged];
+        int end = before->offset + before->length + (before->type == TOKEN_STRING ? 2 : 0);  // Quotes around string text
+        if (end > edit->offset || before->offset != after->offset ||
+            before->length != after->length || before->type != after->type) {
+            break;
+        }
+        unchanged++;
+    }
+
+    // Splice: tokens[0, first) + fresh[0, relexed) + tokens[resync, count)
+    for (int i = first; i < resync; i++) {
+        free(tokens[i].value);
+    }
+    int tail = count - resync;
+    int new_count = first + relexed + tail;
+    if (new_count > count) {
+        Token* grown = realloc(tokens, new_count * sizeof(Token));
+        if (!grown) {
+            fprintf(stderr, "Error: Memory reallocation failed while re-lexing\n");
+            exit(1);
+        }
+        tokens = grown;
+    }
+    if (first + relexed != resync) {
+        memmove(tokens + first + relexed, tokens + resync, tail * sizeof(Token));
+    }
+    memcpy(tokens + first, fresh, relexed * sizeof(Token));
+    free(fresh);
+    diagnostics_free(&dropped);
+
+    // Every token must point into the new buffer; the prefix only needs it if the buffer moved
+    if (first > 0 && !tokens[0].value && tokens[0].start != code + tokens[0].offset + (tokens[0].type == TOKEN_STRING)) {
+        for (int i = 0; i < first; i++) {
+            rebase_token(&tokens[i], code);
+        }
+    }
+
+    if (changed) {
+        changed->first = first + unchanged;
+        changed->old_end = resync;
+        changed->new_end = first + relexed;
+    }
+    *token_count = new_count;
+    return tokens;
+}
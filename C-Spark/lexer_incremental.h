@@ -0,0 +1,36 @@
+#ifndef LEXER_INCREMENTAL_H
+#define LEXER_INCREMENTAL_H
+
+#include "lexer.h"
+
+// One editor change: `deleted_length` bytes at `offset` replaced by `inserted`
+typedef struct {
+    int offset;              // Byte offset of the change in the old source
+    int deleted_length;      // Bytes removed at `offset`
+    const char* inserted;    // Text inserted in their place (need not be NUL-terminated)
+    int inserted_length;     // Length of `inserted`
+} TextEdit;
+
+// Tokens changed by relex_tokens(): old[first, old_end) became new[first, new_end),
+// and the tokens around them are the same before and after the edit
+typedef struct {
+    int first;
+    int old_end;
+    int new_end;
+} RelexRange;
+
+// Apply `edit` to code[0, length); returns a new NUL-terminated buffer and its length
+char* apply_text_edit(const char* code, int length, const TextEdit* edit, int* new_length);
+
+// Update zero-copy `tokens` of the old source for `edit`, given the edited source
+// code[0, length). Only tokens from the last boundary before the edit up to the
+// point where lexing re-synchronizes with the old stream are re-lexed; the rest
+// are shifted. Returns the (possibly moved) token array, like realloc.
+//
+// The region is lexed in recovering mode, since half-typed strings and comments
+// are the normal state of a buffer being edited: they become TOKEN_ERROR tokens
+// and their problems are recorded in `diagnostics` (dropped when it is NULL).
+Token* relex_tokens(Token* tokens, int* token_count, const char* code, int length,
+    const TextEdit* edit, DiagnosticList* diagnostics, RelexRange* changed);
+
+#endif // LEXER_INCREMENTAL_H
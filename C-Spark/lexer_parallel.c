@@ -0,0 +1,158 @@
+// lexer_parallel.c
+#include "lexer_parallel.h"
+#include "lexer_simd.h"
+#include "threads.h"
+#include <stdlib.h>
+#include <string.h>
+
+// One chunk of a parallel tokenize
+typedef struct {
+    const char* code;
+    int start;
+    int end;
+    int line;
+    Token* tokens;
+    int count;
+} LexJob;
+
+// Skip a string literal whose opening quote is at `p`, counting its newlines;
+// mirrors lexer_scan_string. Returns the offset past the closing quote.
+static int prescan_string(const ScanKernels* kernels, const char* code, int p, int length, int* line) {
+    int line_start = 0;
+    p++;
+    for (;;) {
+        p = kernels->find_string_special(code, p, length, line, &line_start);
+        if (p >= length) return length;
+
+        if (code[p] == '"') return p + 1;
+        if (code[p] == '\\') {  // Escape sequence
+            if (p + 1 < length && code[p + 1] == '\n') (*line)++;
+            p += p + 1 < length ? 2 : 1;
+        }
+        else if (p + 1 < length && code[p + 1] == '{') {  // Interpolation runs to the closing brace
+            for (p += 2; p < length && code[p] != '}'; p++) {
+                if (code[p] == '\n') (*line)++;
+            }
+            if (p >= length) return length;
+            p++;
+        }
+        else {
+            p++;
+        }
+    }
+}
+
+// Find chunk boundaries: a cut may only follow a newline in the lexer's start state
+int lexer_prescan_cuts(const char* code, int length, int chunk_count, int* cuts, int* lines) {
+    const ScanKernels* kernels = scan_kernels();
+    int chunks = 1, p = 0, line = 1, line_start = 0;
+    cuts[0] = 0;
+    lines[0] = 1;
+
+    while (p < length && chunks < chunk_count) {
+        char c = code[p];
+        if (c == '\n') {
+            line++;
+            p++;
+            if (p < length && p >= (int)((long long)length * chunks / chunk_count)) {
+                cuts[chunks] = p;
+                lines[chunks] = line;
+                chunks++;
+            }
+        }
+        else if (c == '"') {
+            p = prescan_string(kernels, code, p, length, &line);
+        }
+        else if (c == '/' && p + 1 < length && code[p + 1] == '/') {
+            p = kernels->find_line_end(code, p + 2, length);
+        }
+        else if (c == '/' && p + 1 < length && code[p + 1] == '*') {
+            p = kernels->find_comment_end(code, p + 2, length, &line, &line_start);
+            p = p < length ? p + 2 : length;
+        }
+        else {
+            p++;
+        }
+    }
+
+    cuts[chunks] = length;
+    return chunks;
+}
+
+static void run_lex_job(void* argument) {
+    LexJob* job = argument;
+    job->tokens = tokenize_range(job->code, job->start, job->end, job->line, &job->count);
+}
+
+// Tokenize chunks in parallel and stitch the token arrays together
+Token* tokenize_parallel(const char* code, int length, int thread_count, int* token_count) {
+    if (thread_count <= 0) {
+        thread_count = thread_hardware_concurrency();
+    }
+    if (thread_count > length / PARALLEL_LEX_MIN_CHUNK) {
+        thread_count = length / PARALLEL_LEX_MIN_CHUNK;
+    }
+    if (thread_count <= 1) {
+        return tokenize_buffer(code, length, token_count);
+    }
+
+    int* cuts = malloc((thread_count + 1) * sizeof(int));
+    int* lines = malloc((thread_count + 1) * sizeof(int));
+    LexJob* jobs = malloc(thread_count * sizeof(LexJob));
+    Thread* threads = malloc(thread_count * sizeof(Thread));
+    int* started = calloc(thread_count, sizeof(int));
+    if (!cuts || !lines || !jobs || !threads || !started) {
+        free(cuts);
+        free(lines);
+        free(jobs);
+        free(threads);
+        free(started);
+        return tokenize_buffer(code, length, token_count);
+    }
+
+    int chunks = lexer_prescan_cuts(code, length, thread_count, cuts, lines);
+    for (int i = 0; i < chunks; i++) {
+        jobs[i] = (LexJob){ code, cuts[i], cuts[i + 1], lines[i], NULL, 0 };
+    }
+
+    // Chunk 0 runs on this thread; a chunk whose thread fails to start runs here too
+    for (int i = 1; i < chunks; i++) {
+        started[i] = thread_start(&threads[i], run_lex_job, &jobs[i]);
+    }
+    run_lex_job(&jobs[0]);
+    for (int i = 1; i < chunks; i++) {
+        if (started[i]) {
+            thread_join(&threads[i]);
+        }
+        else {
+            run_lex_job(&jobs[i]);
+        }
+    }
+
+    // Stitch: every chunk but the last ends with an EOF token at its cut, which is dropped
+    int total = 1;
+    for (int i = 0; i < chunks; i++) {
+        total += jobs[i].count - 1;
+    }
+    Token* tokens = malloc(total * sizeof(Token));
+    if (!tokens) {
+        fprintf(stderr, "Error: Memory allocation failed while stitching tokens\n");
+        exit(1);
+    }
+    int count = 0;
+    for (int i = 0; i < chunks; i++) {
+        int keep = i + 1 < chunks ? jobs[i].count - 1 : jobs[i].count;
+        memcpy(tokens + count, jobs[i].tokens, keep * sizeof(Token));
+        count += keep;
+        free(jobs[i].tokens);
+    }
+
+    free(cuts);
+    free(lines);
+    free(jobs);
+    free(threads);
+    free(started);
+
+    *token_count = count;
+    return tokens;
+}
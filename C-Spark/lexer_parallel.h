@@ -0,0 +1,19 @@
+#ifndef LEXER_PARALLEL_H
+#define LEXER_PARALLEL_H
+
+#include "lexer.h"
+
+// Chunks smaller than this are not worth a thread of their own
+#define PARALLEL_LEX_MIN_CHUNK (64 * 1024)
+
+// Split code[0, length) into at most `chunk_count` chunks that each start right
+// after a newline outside any string, interpolation or comment. cuts[i] and
+// lines[i] receive each chunk's start offset and line number (both arrays need
+// chunk_count + 1 entries; cuts[n] = length). Returns the number of chunks n.
+int lexer_prescan_cuts(const char* code, int length, int chunk_count, int* cuts, int* lines);
+
+// Zero-copy tokenize on up to `thread_count` threads (0 = one per processor).
+// Produces exactly the tokens tokenize_buffer() would.
+Token* tokenize_parallel(const char* code, int length, int thread_count, int* token_count);
+
+#endif // LEXER_PARALLEL_H
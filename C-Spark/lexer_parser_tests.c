@@ -1,31 +1,44 @@
 #include "lexer_parser_tests.h"
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <limits.h>
 #include "lexer.h"
 #include "parser.h"
+#include "lexer_simd.h"
+#include "token_source.h"
+#include "token_stream.h"
+#include "lexer_parallel.h"
+#include "lexer_incremental.h"
+#include "interner.h"
+#include "threads.h"
+#include "flat_ast.h"
+#include "parser_parallel.h"
+#include "parser_incremental.h"
+#include "ast_cache.h"
 
 // Run a single test case
 void run_test_case(const TestCase* test) {
     printf("Running test: %s\n", test->description);
 
     // Tokenization
-    int token_count = 0;
-    Token* tokens = tokenize(test->code, &token_count);
-
-    if (!tokens) {
-        printf("  Tokenization failed!\n\n");
-        return;
-    }
+    TokenStream stream;
+    int token_count = token_stream_build(&stream, test->code, (int)strlen(test->code));
 
     printf("  Tokenization completed. Tokens:\n");
+    int line_entry = 0;
     for (int i = 0; i < token_count; i++) {
-        printf("    Token[%d]: '%s', Type: %d, Line: %d, Column: %d\n",
-            i, tokens[i].value, tokens[i].type, tokens[i].line, tokens[i].column);
+        Token token = token_stream_expand(&stream, i, &line_entry);
+        printf("    Token[%d]: '" TOKEN_FMT "', Type: %d, Line: %d, Column: %d\n",
+            i, TOKEN_ARG(&token), token.type, token.line, token.column);
     }
 
     // Parsing
     printf("  Starting parsing...\n");
-    ASTNode* root = parse_program(tokens, token_count);
+    TokenSource source;
+    token_source_init_stream(&source, &stream);
+    ASTNode* root = parse_token_source(&source);
 
     if (root) {
         printf("  AST successfully created.\n");
@@ -45,8 +58,8 @@ void run_test_case(const TestCase* test) {
         printf("  Traversing AST for detailed node analysis...\n");
         for (int i = 0; i < root->child_count; i++) {
             ASTNode* child = root->children[i];
-            printf("    Child[%d]: NodeType = %d, Token = '%s', Line = %d, Column = %d\n",
-                i, child->type, child->token.value, child->token.line, child->token.column);
+            printf("    Child[%d]: NodeType = %d, Token = '" TOKEN_FMT "', Line = %d, Column = %d\n",
+                i, child->type, TOKEN_ARG(&child->token), child->token.line, child->token.column);
         }
 
         // Free memory for the AST
@@ -57,7 +70,7 @@ void run_test_case(const TestCase* test) {
     }
 
     // Free tokens
-    free_tokens(tokens, token_count);
+    token_stream_free(&stream);
     printf("\n");
 }
 
@@ -202,6 +215,1484 @@ void test_invalid_record_syntax() {
     free_tokens(tokens, token_count);
 }
 
+// Zero-copy tokens must match owned tokens and reference the source buffer
+void test_zero_copy_tokens() {
+    const char* input = "func add(a, b) { let s = \"sum\"; return a + b; } // done";
+    int owned_count = 0, view_count = 0;
+    Token* owned = tokenize(input, &owned_count);
+    Token* view = tokenize_zero_copy(input, &view_count);
+
+    assert(owned_count == view_count);
+    for (int i = 0; i < view_count; i++) {
+        assert(view[i].value == NULL);
+        assert(view[i].start >= input && view[i].start + view[i].length <= input + strlen(input));
+        assert(owned[i].type == view[i].type);
+        assert(owned[i].line == view[i].line && owned[i].column == view[i].column);
+        assert(token_length(&view[i]) == (int)strlen(owned[i].value));
+        assert(memcmp(owned[i].value, token_text(&view[i]), token_length(&view[i])) == 0);
+    }
+    assert(token_equals(&view[0], "func"));
+    printf("test_zero_copy_tokens passed.\n");
+
+    free_tokens(view, view_count);
+    free_tokens(owned, owned_count);
+}
+
+// The table-driven lexer must produce the same token stream as the reference tokenizer
+void test_table_lexer_matches_reference() {
+    const char* inputs[] = {
+        "let x = 0x1F + 0b101 - 3.25 * y;",
+        "if (a >= b && c != d || e <= f) { x += 1; y -= 2; z == w; !q; }",
+        "func f(a, b) {\n    return a + b; // trailing comment\n}\n",
+        "/* multi\n   line\n   comment */ let after = 1;",
+        "print(\"value: ${x + 1}\\n\", \"esc \\\" quote\", \"two\nlines\");",
+        "struct Point { x, y }\r\n\tlet _under_score9 = 12.5.6;",
+        "a @ b / c # d"
+    };
+
+    for (int n = 0; n < (int)(sizeof(inputs) / sizeof(inputs[0])); n++) {
+        int reference_count = 0, table_count = 0;
+        Token* reference = tokenize_reference(inputs[n], &reference_count);
+        Token* table = tokenize_zero_copy(inputs[n], &table_count);
+
+        assert(reference_count == table_count);
+        for (int i = 0; i < table_count; i++) {
+            assert(reference[i].type == table[i].type && reference[i].punctuator == table[i].punctuator);
+            assert(reference[i].offset == table[i].offset);
+            assert(reference[i].start == table[i].start && reference[i].length == table[i].length);
+            assert(reference[i].line == table[i].line && reference[i].column == table[i].column);
+        }
+
+        // Streaming through the reference chain gives the same tokens, one at a time
+        Lexer lexer;
+        Token token;
+        int streamed = 0, more = 1;
+        lexer_init(&lexer, inputs[n]);
+        while (more) {
+            more = lexer_next_token_reference(&lexer, &token);
+            assert(streamed < reference_count && token.type == reference[streamed].type);
+            assert(token.start == reference[streamed].start && token.length == reference[streamed].length);
+            assert(token.line == reference[streamed].line && token.column == reference[streamed].column);
+            streamed++;
+        }
+        assert(streamed == reference_count);
+
+        free_tokens(table, table_count);
+        free_tokens(reference, reference_count);
+    }
+
+    // Line numbers advance through multi-line comments and strings
+    int count = 0;
+    Token* tokens = tokenize("/* a\nb */ x \"c\nd\" y", &count);
+    assert(count == 4);
+    assert(tokens[0].line == 2 && tokens[0].column == 6);
+    assert(tokens[1].line == 2 && tokens[1].column == 8);
+    assert(tokens[2].line == 3 && tokens[2].column == 4);
+    free_tokens(tokens, count);
+
+    printf("test_table_lexer_matches_reference passed.\n");
+}
+
+// Keyword lookup returns stable IDs for built-in and user-defined keywords
+void test_keyword_ids() {
+    for (int id = KEYWORD_LET; id < KEYWORD_USER_DEFINED; id++) {
+        const char* name = keyword_name(id);
+        assert(name && keyword_lookup(name, (int)strlen(name)) == (KeywordId)id);
+    }
+    assert(keyword_lookup("lets", 4) == KEYWORD_NONE);
+    assert(keyword_lookup("letter", 3) == KEYWORD_LET);  // Spans need not be NUL-terminated
+    assert(keyword_lookup("unless", 6) == KEYWORD_NONE);
+
+    const char* extra[] = { "unless", "loop", "yield" };
+    set_user_defined_keywords(extra, 3);
+    assert(keyword_lookup("unless", 6) == KEYWORD_USER_DEFINED);
+    assert(keyword_lookup("yield", 5) == KEYWORD_USER_DEFINED + 2);
+    assert(strcmp(keyword_name(KEYWORD_USER_DEFINED + 1), "loop") == 0);
+
+    int count = 0;
+    Token* tokens = tokenize("loop let x", &count);
+    assert(tokens[0].type == TOKEN_KEYWORD && tokens[0].keyword == KEYWORD_USER_DEFINED + 1);
+    assert(tokens[1].type == TOKEN_KEYWORD && tokens[1].keyword == KEYWORD_LET);
+    assert(tokens[2].type == TOKEN_IDENTIFIER && tokens[2].keyword == KEYWORD_NONE);
+    free_tokens(tokens, count);
+
+    set_user_defined_keywords(NULL, 0);
+    assert(keyword_lookup("unless", 6) == KEYWORD_NONE);
+    printf("test_keyword_ids passed.\n");
+}
+
+// Every SIMD scanning kernel must agree with the scalar kernel
+void test_scan_kernels() {
+    const char alphabet[] = "  \t\n\r\v*/\"\\${}ax";
+    char input[300];
+    unsigned int seed = 12345;
+    for (int i = 0; i < (int)sizeof(input); i++) {
+        seed = seed * 1103515245u + 12345u;
+        // Long runs of one character exercise the full-block paths
+        input[i] = (i % 97 < 60) ? alphabet[(i / 40) % 4] : alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    int length = (int)sizeof(input);
+
+    const ScanKernels* scalar = scan_kernels_for(SIMD_SCALAR);
+    for (int level = SIMD_SSE2; level <= SIMD_AVX2; level++) {
+        const ScanKernels* simd = scan_kernels_for(level);
+        if (!simd) continue;
+
+        for (int start = 0; start < length; start++) {
+            int expected_line = 1, expected_line_start = 0, line = 1, line_start = 0;
+
+            assert(simd->skip_whitespace(input, start, length, &line, &line_start) ==
+                scalar->skip_whitespace(input, start, length, &expected_line, &expected_line_start));
+            assert(line == expected_line && line_start == expected_line_start);
+
+            assert(simd->find_line_end(input, start, length) == scalar->find_line_end(input, start, length));
+
+            assert(simd->find_comment_end(input, start, length, &line, &line_start) ==
+                scalar->find_comment_end(input, start, length, &expected_line, &expected_line_start));
+            assert(line == expected_line && line_start == expected_line_start);
+
+            assert(simd->find_string_special(input, start, length, &line, &line_start) ==
+                scalar->find_string_special(input, start, length, &expected_line, &expected_line_start));
+            assert(line == expected_line && line_start == expected_line_start);
+        }
+        printf("  %s kernels match scalar.\n", simd->name);
+    }
+    printf("test_scan_kernels passed (using %s).\n", scan_kernels()->name);
+}
+
+// Length-bounded lexing must never read past the buffer and must match NUL-terminated lexing
+void test_tokenize_buffer_bounds() {
+    const char* inputs[] = { "let x = 1 // tail", "x <", "a &", "0x", "1.", "/* ok */ y /", "print(\"${v}\")", "" };
+
+    for (int n = 0; n < (int)(sizeof(inputs) / sizeof(inputs[0])); n++) {
+        int length = (int)strlen(inputs[n]);
+        char* exact = malloc(length + 1);  // No room is left for a terminator past `length`
+        memcpy(exact, inputs[n], length);
+
+        int expected_count = 0, count = 0;
+        Token* expected = tokenize_zero_copy(inputs[n], &expected_count);
+        Token* tokens = tokenize_buffer(exact, length, &count);
+
+        assert(count == expected_count);
+        for (int i = 0; i < count; i++) {
+            assert(tokens[i].type == expected[i].type && tokens[i].offset == expected[i].offset);
+            assert(tokens[i].length == expected[i].length);
+            assert(tokens[i].line == expected[i].line && tokens[i].column == expected[i].column);
+        }
+
+        free_tokens(tokens, count);
+        free_tokens(expected, expected_count);
+        free(exact);
+    }
+
+    // An embedded NUL is skipped like any unknown character instead of ending the source
+    int count = 0;
+    Token* tokens = tokenize_buffer("a\0b", 3, &count);
+    assert(count == 3 && token_equals(&tokens[1], "b") && tokens[2].type == TOKEN_EOF);
+    free_tokens(tokens, count);
+
+    printf("test_tokenize_buffer_bounds passed.\n");
+}
+
+// tokenize_file maps the source and lexes it in place
+void test_tokenize_file() {
+    const char* path = "csark_source_test.tmp";
+    const char* code = "func f(a) {\n    return a + 1;\n}\n";
+    FILE* file = fopen(path, "wb");
+    assert(file);
+    fwrite(code, 1, strlen(code), file);
+    fclose(file);
+
+    SourceFile source;
+    int count = 0, expected_count = 0;
+    Token* tokens = tokenize_file(path, &source, &count);
+    Token* expected = tokenize_zero_copy(code, &expected_count);
+
+    assert(tokens && count == expected_count && source.length == (int)strlen(code));
+    for (int i = 0; i < count; i++) {
+        assert(tokens[i].start >= source.data && tokens[i].start <= source.data + source.length);
+        assert(tokens[i].type == expected[i].type && tokens[i].length == expected[i].length);
+        assert(memcmp(tokens[i].start, expected[i].start, tokens[i].length) == 0);
+    }
+
+    free_tokens(expected, expected_count);
+    free_tokens(tokens, count);
+    source_file_close(&source);
+    remove(path);
+
+    assert(tokenize_file("csark_missing_source.tmp", &source, &count) == NULL && count == 0);
+    printf("test_tokenize_file passed.\n");
+}
+
+// A lexer-backed token source must yield the same stream as tokenize(), with bounded lookahead and history
+void test_token_source_window() {
+    char code[4096];
+    int length = 0;
+    for (int i = 0; i < 150; i++) {
+        length += snprintf(code + length, sizeof(code) - length, "let v%d = %d;\n", i, i);
+    }
+
+    int count = 0;
+    Token* expected = tokenize_zero_copy(code, &count);
+    TokenSource source;
+    token_source_init(&source, code, length);
+
+    assert(token_source_peek(&source, TOKEN_MAX_LOOKAHEAD) == &source.window[TOKEN_MAX_LOOKAHEAD]);
+    assert(token_source_peek(&source, TOKEN_MAX_LOOKAHEAD + 1) == NULL);
+    for (int i = 0; i < count; i++) {
+        Token* ahead = token_source_peek(&source, 3);
+        Token* token = token_source_next(&source);
+        assert(token && token->type == expected[i].type && token->offset == expected[i].offset);
+        assert(ahead ? ahead->offset == expected[i + 3].offset : i + 3 >= count);
+        assert(token_source_previous(&source, 1) == token);
+        if (i >= TOKEN_HISTORY_SIZE) {
+            assert(token_source_previous(&source, TOKEN_HISTORY_SIZE)->offset == expected[i + 1 - TOKEN_HISTORY_SIZE].offset);
+        }
+    }
+    assert(token_source_next(&source) == NULL && token_source_peek(&source, 0) == NULL);
+
+    token_source_unread(&source);
+    assert(token_source_next(&source)->type == TOKEN_EOF);
+
+    free_tokens(expected, count);
+    printf("test_token_source_window passed.\n");
+}
+
+// Structural comparison of two ASTs (node types, token text and shape)
+static int ast_equal(const ASTNode* a, const ASTNode* b) {
+    if (!a || !b) return a == b;
+    if (a->type != b->type || a->child_count != b->child_count) return 0;
+    if (token_length(&a->token) != token_length(&b->token) ||
+        memcmp(token_text(&a->token), token_text(&b->token), token_length(&a->token)) != 0) return 0;
+    for (int i = 0; i < a->child_count; i++) {
+        if (!ast_equal(a->children[i], b->children[i])) return 0;
+    }
+    return 1;
+}
+
+// Parsing through the pull-based token window must build the same AST as parsing a token array
+void test_parse_source_matches_array() {
+    char code[8192];
+    int length = snprintf(code, sizeof(code), "func f(a, b) { (a + b * 2) }\nrecord Big {");
+    for (int i = 0; i < 120; i++) {  // Longer than the token history, so held tokens must be copies
+        length += snprintf(code + length, sizeof(code) - length, " field%d = %d + x;", i, i);
+    }
+    length += snprintf(code + length, sizeof(code) - length, " }\nenum Color { Red, Green = 2, Blue }\n");
+
+    int count = 0;
+    Token* tokens = tokenize(code, &count);
+    ASTNode* from_array = parse_program(tokens, count);
+    ASTNode* from_source = parse_source(code, length);
+
+    assert(from_array && from_source);
+    assert(from_source->child_count == 3);
+    assert(ast_equal(from_array, from_source));
+
+    free_ast(from_source);
+    free_ast(from_array);
+    free_tokens(tokens, count);
+    printf("test_parse_source_matches_array passed.\n");
+}
+
+// Parallel lexing must reproduce the serial token stream exactly, whatever the chunking
+void test_parallel_lexer_matches_serial() {
+    // Newlines inside comments, strings, escapes and interpolations are not valid cut points
+    const char* snippet =
+        "let a = 1; /* block\ncomment \" with quote\n*/ print(\"multi\nline ${x +\n y} \\\" esc\\\n\"); // tail \" quote\n"
+        "func f(b) { return b * 0x1F + 2.5; }\n";
+    size_t snippet_length = strlen(snippet);
+    size_t capacity = 8 * PARALLEL_LEX_MIN_CHUNK + 2 * snippet_length;
+    char* code = malloc(capacity);
+    size_t length = 0;
+    while (length + snippet_length < capacity / 2) {
+        memcpy(code + length, snippet, snippet_length);
+        length += snippet_length;
+    }
+    // One comment spanning many would-be cut points
+    memcpy(code + length, "/*", 2);
+    length += 2;
+    for (int i = 0; i < PARALLEL_LEX_MIN_CHUNK / 4; i++) {
+        memcpy(code + length, "x\n\"/", 4);
+        length += 4;
+    }
+    memcpy(code + length, "*/\n", 3);
+    length += 3;
+    while (length + snippet_length < capacity) {
+        memcpy(code + length, snippet, snippet_length);
+        length += snippet_length;
+    }
+
+    int cuts[9], lines[9];
+    int chunks = lexer_prescan_cuts(code, (int)length, 8, cuts, lines);
+    assert(chunks > 1 && cuts[0] == 0 && cuts[chunks] == (int)length);
+    for (int i = 1; i < chunks; i++) {
+        assert(cuts[i] > cuts[i - 1] && code[cuts[i] - 1] == '\n');
+    }
+
+    int expected_count = 0;
+    Token* expected = tokenize_buffer(code, (int)length, &expected_count);
+    for (int threads = 0; threads <= 8; threads++) {
+        int count = 0;
+        Token* tokens = tokenize_parallel(code, (int)length, threads, &count);
+        assert(count == expected_count);
+        for (int i = 0; i < count; i++) {
+            assert(tokens[i].type == expected[i].type && tokens[i].keyword == expected[i].keyword &&
+                tokens[i].punctuator == expected[i].punctuator);
+            assert(tokens[i].start == expected[i].start && tokens[i].length == expected[i].length);
+            assert(tokens[i].offset == expected[i].offset);
+            assert(tokens[i].line == expected[i].line && tokens[i].column == expected[i].column);
+        }
+        free_tokens(tokens, count);
+    }
+
+    free_tokens(expected, expected_count);
+    free(code);
+    printf("test_parallel_lexer_matches_serial passed (%d chunks).\n", chunks);
+}
+
+// Incremental re-lexing must leave the same tokens as lexing the edited source from scratch
+void test_relex_matches_full_lex() {
+    const char* seed =
+        "  /* header */\nfunc f(a, b) {\n    let total = a + 0x1F * b; // tail\n    /* block\n       comment */\n"
+        "    print(\"sum ${a +\n b} \\\" done\", total);\n    if (total >= 10 && b != 0) { return 1.5; }\n}\n";
+    const char* fragments[] = { " x ", "\n", " \"s\nt\" ", " /* c\n */ ", " // note\n", " 42 ", "<=", "=", "abc", "9" };
+    int length = (int)strlen(seed);
+    char* code = apply_text_edit(seed, length, &(TextEdit){ 0, 0, "", 0 }, &length);
+    int count = 0;
+    Token* tokens = tokenize_buffer(code, length, &count);
+    unsigned int random = 12345;
+
+    for (int step = 0; step < 400; step++) {
+        random = random * 1103515245u + 12345u;
+        Token* target = &tokens[(random >> 8) % count];
+        TextEdit edit = { target->offset, 0, "", 0 };
+        switch ((random >> 4) % 5) {
+        case 0:  // Insert a fragment at a token start
+            edit.inserted = fragments[(random >> 16) % (sizeof(fragments) / sizeof(fragments[0]))];
+            edit.inserted_length = (int)strlen(edit.inserted);
+            break;
+        case 1:  // Delete a token and the trivia after it
+            if (target->type != TOKEN_EOF) edit.deleted_length = (target + 1)->offset - target->offset;
+            break;
+        case 2:  // Type inside a string body or after a comment opener
+            if (target->type == TOKEN_STRING) edit.offset++;
+            else if (strstr(code + target->offset, "/*")) edit.offset = (int)(strstr(code + target->offset, "/*") - code) + 2;
+            edit.inserted = "q\n";
+            edit.inserted_length = 2;
+            break;
+        case 3:  // Insert a fragment at the start of the source, ahead of the leading trivia
+            edit.offset = 0;
+            edit.inserted = fragments[(random >> 16) % (sizeof(fragments) / sizeof(fragments[0]))];
+            edit.inserted_length = (int)strlen(edit.inserted);
+            break;
+        default:  // Retype the last character of an identifier
+            if (target->type != TOKEN_IDENTIFIER) continue;
+            edit.offset += target->length - 1;
+            edit.deleted_length = 1;
+            edit.inserted = "z7" + (random >> 20) % 2;
+            edit.inserted_length = 1;
+            break;
+        }
+
+        int new_length = 0;
+        char* edited = apply_text_edit(code, length, &edit, &new_length);
+        RelexRange changed;
+        tokens = relex_tokens(tokens, &count, edited, new_length, &edit, NULL, &changed);
+        free(code);
+        code = edited;
+        length = new_length;
+
+        int expected_count = 0;
+        Token* expected = tokenize_buffer(code, length, &expected_count);
+        assert(count == expected_count);
+        assert(changed.first <= changed.new_end && changed.new_end <= count);
+        for (int i = 0; i < count; i++) {
+            assert(tokens[i].type == expected[i].type && tokens[i].keyword == expected[i].keyword &&
+                tokens[i].punctuator == expected[i].punctuator);
+            assert(tokens[i].start == expected[i].start && tokens[i].length == expected[i].length);
+            assert(tokens[i].offset == expected[i].offset);
+            assert(tokens[i].line == expected[i].line && tokens[i].column == expected[i].column);
+        }
+        free_tokens(expected, expected_count);
+    }
+
+    free_tokens(tokens, count);
+    free(code);
+
+    // Half-typed comments and strings become error tokens, as they would in a recovering lex
+    const char* openers[] = { "/*", "\"" };
+    for (int i = 0; i < 2; i++) {
+        const char* clean = "let x = 1;\nprint(x);\n";
+        length = (int)strlen(clean);
+        tokens = tokenize_buffer(clean, length, &count);
+        TextEdit edit = { 11, 0, openers[i], (int)strlen(openers[i]) };
+        code = apply_text_edit(clean, length, &edit, &length);
+
+        DiagnosticList diagnostics, expected_diagnostics;
+        diagnostics_init(&diagnostics);
+        diagnostics_init(&expected_diagnostics);
+        tokens = relex_tokens(tokens, &count, code, length, &edit, &diagnostics, NULL);
+        int expected_count = 0;
+        Token* expected = tokenize_recovering(code, length, &expected_diagnostics, &expected_count);
+        assert(diagnostics.error_count == 1 && expected_diagnostics.error_count == 1 && count == expected_count);
+        int errors = 0;
+        for (int t = 0; t < count; t++) {
+            assert(tokens[t].type == expected[t].type && tokens[t].offset == expected[t].offset &&
+                tokens[t].length == expected[t].length);
+            errors += tokens[t].type == TOKEN_ERROR;
+        }
+        assert(errors == 1);
+
+        diagnostics_free(&diagnostics);
+        diagnostics_free(&expected_diagnostics);
+        free_tokens(expected, expected_count);
+        free_tokens(tokens, count);
+        free(code);
+    }
+    printf("test_relex_matches_full_lex passed.\n");
+}
+
+// Interned spellings get one ID and one canonical copy, shared by tokens and AST nodes
+void test_interner() {
+    SymbolId loop = intern("index", 5);
+    assert(loop != SYMBOL_NONE);
+    assert(intern("index_other" , 5) == loop);  // Only the span is interned
+    assert(intern_cstr("index") == loop && symbol_text(intern_cstr("index")) == symbol_text(loop));
+    assert(intern_cstr("indexes") != loop && symbol_length(loop) == 5 && strcmp(symbol_text(loop), "index") == 0);
+
+    // IDs and canonical pointers stay stable while the table grows
+    const char* canonical = symbol_text(loop);
+    int before = symbol_count();
+    char name[32];
+    for (int i = 0; i < 20000; i++) {
+        snprintf(name, sizeof(name), "sym_%d", i);
+        SymbolId symbol = intern_cstr(name);
+        assert(strcmp(symbol_text(symbol), name) == 0);
+    }
+    assert(symbol_count() == before + 20000);
+    assert(intern_cstr("sym_123") == intern_cstr("sym_123") && intern_cstr("index") == loop && symbol_text(loop) == canonical);
+
+    // Repeated names in a program share one symbol and one copy of their text
+    const char* code = "let i = i + i * 2;";
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    assert(token_symbol(&tokens[1]) == token_symbol(&tokens[3]) && token_symbol(&tokens[3]) == token_symbol(&tokens[5]));
+    assert(token_symbol(&tokens[1]) != token_symbol(&tokens[7]));
+    ASTNode* program = parse_program(tokens, count);
+    ASTNode* declaration = program->children[0];
+    assert(declaration->token.symbol == token_symbol(&tokens[1]));
+    assert(token_text(&declaration->token) == symbol_text(declaration->token.symbol));
+    free_ast(program);
+    free_tokens(tokens, count);
+
+    // Literal and string text is kept with the nodes instead, so one-off values
+    // do not grow the interner, and the nodes outlive the tokens and the source
+    char source[] = "let once_text = \"one-off text\"; let once_number = 123456;";
+    int total = symbol_count();
+    tokens = tokenize_zero_copy(source, &count);
+    program = parse_program(tokens, count);
+    free_tokens(tokens, count);
+    memset(source, ' ', sizeof(source) - 1);
+    assert(symbol_count() == total + 2);  // once_text and once_number
+    const Token* text = &program->children[0]->children[0]->token;
+    const Token* number = &program->children[1]->children[0]->token;
+    assert(text->type == TOKEN_STRING && text->symbol == SYMBOL_NONE && token_equals(text, "one-off text"));
+    assert(number->type == TOKEN_LITERAL && number->symbol == SYMBOL_NONE && token_equals(number, "123456"));
+    free_ast(program);
+
+    printf("test_interner passed (%d symbols).\n", symbol_count());
+}
+
+// The compact token stream must expand to exactly the tokens the lexer produces
+void test_token_stream_matches_tokens() {
+    const char* code =
+        "func f(a, b) {\n    /* spans\n lines */ let x = a + 0x1F;\n"
+        "    print(\"multi\nline\", b); // tail\n\n\n    return x >= 2.5;\n}\nstruct P { x, y }\n";
+    int length = (int)strlen(code);
+
+    int expected_count = 0;
+    Token* expected = tokenize_buffer(code, length, &expected_count);
+    TokenStream stream;
+    assert(token_stream_build(&stream, code, length) == expected_count);
+
+    int count = 0;
+    Token* tokens = token_stream_to_tokens(&stream, &count);
+    assert(count == expected_count);
+    for (int i = 0; i < count; i++) {
+        Token single = token_stream_token(&stream, i);
+        assert(tokens[i].type == expected[i].type && tokens[i].keyword == expected[i].keyword &&
+            tokens[i].punctuator == expected[i].punctuator);
+        assert(tokens[i].start == expected[i].start && tokens[i].length == expected[i].length);
+        assert(tokens[i].offset == expected[i].offset);
+        assert(tokens[i].line == expected[i].line && tokens[i].column == expected[i].column);
+        assert(single.line == expected[i].line && single.column == expected[i].column && single.start == expected[i].start);
+    }
+    assert(token_stream_memory(&stream) * 3 < count * sizeof(Token));
+
+    // Parsing through a stream-backed token source builds the same AST
+    TokenSource source;
+    token_source_init_stream(&source, &stream);
+    ASTNode* from_stream = parse_token_source(&source);
+    ASTNode* from_array = parse_program(expected, expected_count);
+    assert(ast_equal(from_stream, from_array));
+
+    free_ast(from_array);
+    free_ast(from_stream);
+    free_tokens(tokens, count);
+    token_stream_free(&stream);
+    free_tokens(expected, expected_count);
+    printf("test_token_stream_matches_tokens passed.\n");
+}
+
+// Build "let <10k-char name> = "<2 MB string>"; print("... ${<long expression>} ...");"
+static char* build_huge_token_source(int* length) {
+    int name_length = 10000, string_length = 2 * 1024 * 1024, terms = 300;
+    char* code = malloc(name_length + string_length + terms * 8 + 256);
+    int n = 0;
+    n += sprintf(code + n, "let ");
+    for (int i = 0; i < name_length; i++) code[n++] = "abcdefghij_0123456789"[i % 21];
+    n += sprintf(code + n, " = \"");
+    for (int i = 0; i < string_length; i++) code[n++] = i % 97 == 96 ? '\n' : (i % 89 == 88 ? '\\' : 'a' + i % 26);
+    n += sprintf(code + n, "x\";\nprint(\"sum ${v");
+    for (int i = 0; i < terms; i++) n += sprintf(code + n, " + v%d", i);
+    n += sprintf(code + n, "} done\");\n");
+    *length = n;
+    return code;
+}
+
+// Identifiers, strings and interpolations of any length lex and parse without fixed buffers
+void test_huge_tokens() {
+    int length = 0;
+    char* code = build_huge_token_source(&length);
+    code[length] = '\0';
+
+    int reference_count = 0, count = 0, owned_count = 0, arena_count = 0;
+    Token* reference = tokenize_reference(code, &reference_count);
+    Token* tokens = tokenize_buffer(code, length, &count);
+    Token* owned = tokenize(code, &owned_count);
+    Arena arena;
+    arena_init(&arena, 0);
+    Token* copied = tokenize_arena(code, length, &arena, &arena_count);
+
+    assert(count == reference_count && count == owned_count && count == arena_count);
+    assert(tokens[1].type == TOKEN_IDENTIFIER && tokens[1].length == 10000);
+    assert(tokens[3].type == TOKEN_STRING && tokens[3].length == 2 * 1024 * 1024 + 1);
+    for (int i = 0; i < count; i++) {
+        assert(reference[i].type == tokens[i].type && reference[i].length == tokens[i].length);
+        assert(reference[i].line == tokens[i].line && reference[i].column == tokens[i].column);
+        assert(owned[i].length == tokens[i].length && memcmp(owned[i].value, tokens[i].start, tokens[i].length) == 0);
+        assert(copied[i].length == tokens[i].length && memcmp(copied[i].start, tokens[i].start, tokens[i].length) == 0);
+        assert(copied[i].start[copied[i].length] == '\0' && (copied[i].start < code || copied[i].start > code + length));
+    }
+    assert(arena_bytes(&arena) >= 10000 + 2 * 1024 * 1024);
+
+    // The interpolated expression is parsed in place, however long it is
+    ASTNode* program = parse_source(code, length);
+    assert(program->child_count == 2);
+    ASTNode* print = program->children[1];
+    assert(print->child_count == 1 && print->children[0]->type == NODE_STRING_INTERPOLATION);
+    assert(print->children[0]->child_count == 1 && print->children[0]->children[0]->type == NODE_EXPRESSION);
+
+    free_ast(program);
+    free_tokens(copied, arena_count);
+    arena_free(&arena);
+    free_tokens(owned, owned_count);
+    free_tokens(tokens, count);
+    free_tokens(reference, reference_count);
+    free(code);
+    printf("test_huge_tokens passed.\n");
+}
+
+// Compare number values member by member (memcmp would also compare padding)
+static int number_values_equal(NumberValue a, NumberValue b) {
+    if (a.kind != b.kind) return 0;
+    if (a.kind == NUMBER_FLOAT) return a.real == b.real;
+    return a.kind == NUMBER_NONE || a.integer == b.integer;
+}
+
+// Number literal values are computed by the lexer and carried into the AST
+void test_number_literals() {
+    struct { const char* text; NumberKind kind; long long integer; } integers[] = {
+        { "0x1F", NUMBER_INT, 31 }, { "0b101", NUMBER_INT, 5 }, { "42", NUMBER_INT, 42 }, { "007", NUMBER_INT, 7 },
+        { "9223372036854775807", NUMBER_INT, LLONG_MAX }, { "0x7FFFFFFFFFFFFFFF", NUMBER_INT, LLONG_MAX },
+        { "9223372036854775808", NUMBER_OVERFLOW, LLONG_MAX }, { "123456789012345678901234", NUMBER_OVERFLOW, LLONG_MAX },
+        { "0x8000000000000000", NUMBER_OVERFLOW, LLONG_MAX }, { "0b12", NUMBER_INVALID, 0 }, { "0x", NUMBER_INVALID, 0 }
+    };
+    for (int n = 0; n < (int)(sizeof(integers) / sizeof(integers[0])); n++) {
+        int count = 0;
+        Token* tokens = tokenize_zero_copy(integers[n].text, &count);
+        assert(count == 2 && tokens[0].type == TOKEN_LITERAL);
+        assert(tokens[0].number.kind == integers[n].kind && tokens[0].number.integer == integers[n].integer);
+        free_tokens(tokens, count);
+    }
+
+    // Floats must round exactly like strtod, on the fast path and the slow path alike
+    unsigned int random = 777;
+    char text[64];
+    for (int n = 0; n < 5000; n++) {
+        int length = 0, digits = 1 + n % 30, point = (int)((random >> 8) % digits);
+        for (int i = 0; i < digits; i++) {
+            random = random * 1103515245u + 12345u;
+            text[length++] = (char)('0' + (random >> 16) % 10);
+            if (i == point) text[length++] = '.';
+        }
+        text[length] = '\0';
+        NumberValue value = number_literal_value(text, length);
+        assert(value.kind == NUMBER_FLOAT && value.real == strtod(text, NULL));
+    }
+
+    // Every lexer path produces the same values
+    const char* code = "let a = 0x10 * 2 + 1.5; let b = 9223372036854775807 + 1; let c = 7 * 2 - 5;";
+    int count = 0, reference_count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    Token* reference = tokenize_reference(code, &reference_count);
+    TokenStream stream;
+    token_stream_build(&stream, code, (int)strlen(code));
+    assert(count == reference_count);
+    for (int i = 0; i < count; i++) {
+        Token expanded = token_stream_token(&stream, i);
+        assert(reference[i].number.kind == tokens[i].number.kind && expanded.number.kind == tokens[i].number.kind);
+        assert(number_values_equal(reference[i].number, tokens[i].number));
+        assert(number_values_equal(expanded.number, tokens[i].number));
+    }
+
+    // Constant folding and type inference read the values, not the text
+    ASTNode* program = parse_program(tokens, count);
+    assert(program->child_count == 3);
+    NumberValue value;
+    ASTNode* a = program->children[0]->children[0];
+    assert(evaluate_constant(a, &value) && value.kind == NUMBER_FLOAT && value.real == 33.5);
+    assert(a->inferred_type == TYPE_FLOAT);
+    assert(evaluate_constant(program->children[1]->children[0], &value) && value.kind == NUMBER_OVERFLOW);
+    ASTNode* c = program->children[2]->children[0];
+    assert(evaluate_constant(c, &value) && value.kind == NUMBER_INT && value.integer == 9);
+    assert(c->inferred_type == TYPE_INT);
+
+    free_ast(program);
+    token_stream_free(&stream);
+    free_tokens(reference, reference_count);
+    free_tokens(tokens, count);
+    printf("test_number_literals passed.\n");
+}
+
+// The recovering lexer reports every problem in one pass and never exits
+void test_recovering_lexer() {
+    const char* code =
+        "let b = 1 @ 2;\n"
+        "let c = \"fine\";\n"
+        "let d = \"${x;\n"
+        "let a = \"open;\n"
+        "print(a) /* never closed\nlet e = 3;";
+    DiagnosticList diagnostics;
+    diagnostics_init(&diagnostics);
+
+    // A host reuses one buffer across many sources
+    for (int run = 0; run < 1000; run++) {
+        diagnostics_clear(&diagnostics);
+        int count = 0;
+        Token* tokens = tokenize_recovering(code, (int)strlen(code), &diagnostics, &count);
+        assert(tokens && tokens[count - 1].type == TOKEN_EOF);
+        assert(diagnostics.count == 4 && diagnostics.error_count == 3 && diagnostics.dropped == 0);
+
+        assert(diagnostics.items[0].severity == DIAGNOSTIC_WARNING);
+        assert(diagnostics.items[0].line == 1 && diagnostics.items[0].column == 11);
+        assert(diagnostics.items[1].severity == DIAGNOSTIC_ERROR);
+        assert(diagnostics.items[1].line == 3 && diagnostics.items[1].column == 9);
+        assert(diagnostics.items[2].line == 4 && diagnostics.items[2].column == 9);
+        assert(diagnostics.items[3].line == 5 && diagnostics.items[3].column == 10);
+        assert(diagnostics.items[3].offset + diagnostics.items[3].length == (int)strlen(code));
+
+        // Error tokens stand in for the bad spans, and the lines after them still lex
+        assert(token_equals(&tokens[14], "\"${x;") && token_equals(&tokens[18], "\"open;"));
+        int errors = 0, strings = 0;
+        for (int i = 0; i < count; i++) {
+            if (tokens[i].type == TOKEN_ERROR) {
+                assert(tokens[i].offset == diagnostics.items[errors + 1].offset);
+                errors++;
+            }
+            if (tokens[i].type == TOKEN_STRING) {
+                assert(token_equals(&tokens[i], "fine") && tokens[i].line == 2);
+                strings++;
+            }
+        }
+        assert(errors == 3 && strings == 1);
+        assert(token_equals(&tokens[count - 2], "/* never closed\nlet e = 3;"));
+        assert(tokens[count - 3].type == TOKEN_SYMBOL && tokens[count - 3].line == 5);
+        assert(tokens[count - 1].line == 6);
+        free_tokens(tokens, count);
+    }
+
+    diagnostics_free(&diagnostics);
+    printf("test_recovering_lexer passed.\n");
+}
+
+// Full-matrix edit distance, the straightforward definition
+static int reference_edit_distance(const char* a, const char* b) {
+    int a_length = (int)strlen(a), b_length = (int)strlen(b);
+    int* matrix = malloc((a_length + 1) * (b_length + 1) * sizeof(int));
+    for (int i = 0; i <= a_length; i++) {
+        for (int j = 0; j <= b_length; j++) {
+            int* cell = &matrix[i * (b_length + 1) + j];
+            if (i == 0 || j == 0) {
+                *cell = i + j;
+                continue;
+            }
+            int cost = matrix[(i - 1) * (b_length + 1) + j - 1] + (a[i - 1] != b[j - 1]);
+            if (matrix[(i - 1) * (b_length + 1) + j] + 1 < cost) cost = matrix[(i - 1) * (b_length + 1) + j] + 1;
+            if (cell[-1] + 1 < cost) cost = cell[-1] + 1;
+            *cell = cost;
+        }
+    }
+    int distance = matrix[a_length * (b_length + 1) + b_length];
+    free(matrix);
+    return distance;
+}
+
+// The BK-tree index finds the same closest word as comparing against every word
+void test_suggestion_index() {
+    enum { WORDS = 2000, QUERIES = 500 };
+    static char words[WORDS][16];
+    unsigned int random = 4242;
+    for (int n = 0; n < WORDS; n++) {
+        random = random * 1103515245u + 12345u;
+        int length = 3 + (random >> 16) % 10;
+        for (int i = 0; i < length; i++) {
+            random = random * 1103515245u + 12345u;
+            words[n][i] = (char)('a' + (random >> 16) % 6);  // Small alphabet: many near neighbours and ties
+        }
+        words[n][length] = '\0';
+    }
+
+    SuggestionIndex index;
+    suggestion_index_init(&index);
+    for (int n = 0; n < WORDS; n++) {
+        suggestion_index_add(&index, words[n], (int)strlen(words[n]));
+    }
+
+    for (int q = 0; q < QUERIES; q++) {
+        char query[16];
+        strcpy_s(query, sizeof(query), words[(q * 7919) % WORDS]);
+        random = random * 1103515245u + 12345u;
+        query[(random >> 16) % strlen(query)] = (char)('a' + q % 8);  // One substitution, sometimes outside the alphabet
+        int query_length = (int)strlen(query);
+
+        const char* expected[4] = { NULL };
+        int expected_distance[4];
+        for (int max_distance = 0; max_distance <= 3; max_distance++) expected_distance[max_distance] = max_distance + 1;
+        for (int n = 0; n < WORDS; n++) {
+            int distance = reference_edit_distance(query, words[n]);
+            for (int max_distance = 0; max_distance <= 3; max_distance++) {
+                int bounded = levenshtein_bounded(query, query_length, words[n], (int)strlen(words[n]), max_distance);
+                assert(bounded == (distance <= max_distance ? distance : max_distance + 1));
+                if (distance < expected_distance[max_distance]) {  // The earliest of equally close words wins
+                    expected[max_distance] = words[n];
+                    expected_distance[max_distance] = distance;
+                }
+            }
+        }
+        for (int max_distance = 0; max_distance <= 3; max_distance++) {
+            int distance = -1;
+            const char* match = suggestion_index_closest(&index, query, query_length, max_distance, &distance);
+            assert((match == NULL) == (expected[max_distance] == NULL));
+            if (match) {
+                assert(strcmp(match, expected[max_distance]) == 0 && distance == expected_distance[max_distance]);
+            }
+        }
+    }
+    suggestion_index_free(&index);
+
+    // Undefined names are suggested from the program's own declarations
+    const char* code =
+        "let total = 1;\n"
+        "func scale(factor) { let scaled = factor * total; }\n"
+        "let result = totl + factr + zzzzzz;";
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    ASTNode* program = parse_program(tokens, count);
+    SuggestionIndex declared;
+    suggestion_index_init(&declared);
+    index_declared_names(program, &declared);
+    assert(strcmp(suggestion_index_closest(&declared, "totl", 4, 1, NULL), "total") == 0);
+    assert(strcmp(suggestion_index_closest(&declared, "factr", 5, 1, NULL), "factor") == 0);
+    assert(suggestion_index_closest(&declared, "zzzzzz", 6, 2, NULL) == NULL);
+    assert(report_undefined_names(program) == 3);
+    suggestion_index_free(&declared);
+    free_ast(program);
+    free_tokens(tokens, count);
+    printf("test_suggestion_index passed.\n");
+}
+
+typedef struct {
+    const char* code;
+    const ASTNode* expected;
+    int runs;
+    int mismatches;
+} ParseJob;
+
+static void parse_job(void* argument) {
+    ParseJob* job = argument;
+    for (int run = 0; run < job->runs; run++) {
+        int count = 0;
+        Token* tokens = tokenize_zero_copy(job->code, &count);
+        TokenSource source;
+        ParserState state;
+        token_source_init_array(&source, tokens, count);
+        parser_state_init(&state, &source);
+        ASTNode* program = parse_with_state(&state);
+        if (!ast_equal(program, job->expected)) job->mismatches++;
+        free_ast(program);
+        free_tokens(tokens, count);
+    }
+}
+
+// Parses on several threads at once must not disturb each other
+void test_concurrent_parsing() {
+    const char* sources[] = {
+        "let a = 1 + 2 * 3; let b = a * (4 + a);",
+        "func add(x, y) { let z = x + y; let w = z * 2; }",
+        "let name = \"n\"; let greeting = \"hi ${name + 1} and ${2 * 3}\";",
+        "{ let inner = 5; { let deeper = inner + 1; } } let after = 7;"
+    };
+    enum { JOBS = sizeof(sources) / sizeof(sources[0]) };
+    ParseJob jobs[JOBS];
+    Thread threads[JOBS];
+    ASTNode* expected[JOBS];
+
+    for (int i = 0; i < JOBS; i++) {
+        expected[i] = parse_source(sources[i], (int)strlen(sources[i]));
+        assert(expected[i] && expected[i]->child_count > 0);
+        jobs[i] = (ParseJob){ sources[i], expected[i], 200, 0 };
+    }
+    for (int i = 0; i < JOBS; i++) {
+        assert(thread_start(&threads[i], parse_job, &jobs[i]));
+    }
+    for (int i = 0; i < JOBS; i++) {
+        thread_join(&threads[i]);
+        assert(jobs[i].mismatches == 0);
+        free_ast(expected[i]);
+    }
+    printf("test_concurrent_parsing passed.\n");
+}
+
+static int count_nodes(const ASTNode* node) {
+    int count = 1;
+    for (int i = 0; i < node->child_count; i++) count += count_nodes(node->children[i]);
+    return count;
+}
+
+// An arena-allocated AST matches the heap AST and is released in one reset
+void test_ast_arena() {
+    char code[16384];
+    int length = 0;
+    for (int i = 0; i < 100; i++) {
+        length += snprintf(code + length, sizeof(code) - length,
+            "let v%d = %d * (v%d + 2); func f%d(a, b, c) { let s = \"${a + %d}\"; { let t = b; } }\n", i, i, i, i, i);
+    }
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    ASTNode* heap = parse_program(tokens, count);
+
+    Arena arena;
+    arena_init(&arena, 0);
+    ASTNode* program = parse_program_in(tokens, count, &arena);
+    assert(ast_equal(heap, program) && program->child_count == 200);
+    assert(program->arena == &arena && program->children[199]->arena == &arena);
+    assert(program->children[1]->child_count == 4);  // Three parameters and the body
+    // Nodes and child arrays are the arena's only allocations, packed into few blocks
+    size_t used = arena_bytes(&arena);
+    assert(used >= count_nodes(program) * sizeof(ASTNode) && used < 2 * count_nodes(program) * sizeof(ASTNode) + 65536);
+    free_ast(program);  // No-op for arena nodes
+
+    // A reset keeps a block for the next compilation
+    arena_reset(&arena);
+    assert(arena_bytes(&arena) == 0);
+    ASTNode* again = parse_program_in(tokens, count, &arena);
+    assert(ast_equal(heap, again) && arena_bytes(&arena) == used);
+
+    arena_free(&arena);
+    free_ast(heap);
+    free_tokens(tokens, count);
+    printf("test_ast_arena passed.\n");
+}
+
+// Small nodes keep their children inline; larger ones grow by doubling
+void test_child_storage() {
+    Token token = { .type = TOKEN_IDENTIFIER };
+    token.start = "x";
+    token.length = 1;
+    Arena arena;
+    arena_init(&arena, 0);
+
+    for (int in_arena = 0; in_arena <= 1; in_arena++) {
+        ASTNode* parent = create_node_in(in_arena ? &arena : NULL, NODE_BLOCK, token);
+        assert(parent->children == NULL && parent->child_capacity == 0);
+        int reallocations = 0;
+        for (int i = 0; i < 1000; i++) {
+            ASTNode** before = parent->children;
+            add_child(parent, create_node_in(parent->arena, NODE_FACTOR, token));
+            if (i < AST_INLINE_CHILDREN) assert(parent->children == parent->inline_children);
+            else if (parent->children != before) reallocations++;
+        }
+        assert(parent->child_count == 1000 && parent->child_capacity >= 1000);
+        assert(reallocations <= 10);  // 4, 6, 12, ... 1536: logarithmic in the child count
+        for (int i = 0; i < 1000; i++) {
+            assert(parent->children[i]->type == NODE_FACTOR && parent->children[i]->child_count == 0);
+        }
+        free_ast(parent);
+    }
+    arena_free(&arena);
+
+    // Binary expressions and declarations need no separate child array
+    int count = 0;
+    Token* tokens = tokenize_zero_copy("let a = (1 + 2) * 3; func f(x, y, z) { let b = x; }", &count);
+    ASTNode* program = parse_program(tokens, count);
+    ASTNode* product = program->children[0]->children[0];
+    assert(product->child_count == 2 && product->children == product->inline_children);
+    ASTNode* function = program->children[1];
+    assert(function->child_count == 4 && function->children != function->inline_children);
+    free_ast(program);
+    free_tokens(tokens, count);
+    printf("test_child_storage passed.\n");
+}
+
+// Walk the pointer tree and the flat tree side by side
+static void assert_flat_matches(const FlatAst* ast, uint32_t index, const ASTNode* node, uint32_t depth) {
+    const FlatNode* flat = &ast->nodes[index];
+    assert(flat->type == node->type && flat->child_count == (uint32_t)node->child_count && flat->depth == depth);
+    assert(token_length(&ast->tokens[index]) == token_length(&node->token) &&
+        memcmp(token_text(&ast->tokens[index]), token_text(&node->token), token_length(&node->token)) == 0);
+    assert(flat_ast_subtree_end(ast, index) == index + (uint32_t)count_nodes(node));
+
+    int i = 0;
+    FLAT_AST_FOR_EACH_CHILD(ast, index, child) {
+        assert(i < node->child_count && ast->nodes[child].parent == index);
+        assert(flat_ast_child(ast, index, i) == child);
+        assert_flat_matches(ast, child, node->children[i], depth + 1);
+        i++;
+    }
+    assert(i == node->child_count && flat_ast_child(ast, index, i) == FLAT_AST_NONE);
+}
+
+// The flat pre-order layout has the same shape as the pointer AST
+void test_flat_ast() {
+    const char* code =
+        "let a = (1 + 2) * 3;\n"
+        "func f(x, y, z) { let b = x * y; { let c = \"${b + z}\"; } }\n"
+        "{ { { let deep = 1; } } }\n"
+        "let last = a;";
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    ASTNode* program = parse_program(tokens, count);
+
+    FlatAst ast;
+    assert(flat_ast_build(&ast, program) == count_nodes(program));
+    assert(ast.nodes[0].parent == FLAT_AST_NONE && ast.nodes[0].subtree_size == ast.count);
+    assert(flat_ast_next_sibling(&ast, 0) == FLAT_AST_NONE);
+    assert_flat_matches(&ast, 0, program, 0);
+
+    // Skipping a subtree lands on the next top-level statement
+    uint32_t function = flat_ast_child(&ast, 0, 1);
+    assert(ast.nodes[function].type == NODE_FUNCTION && token_equals(&ast.tokens[function], "f"));
+    assert(flat_ast_next_sibling(&ast, function) == flat_ast_subtree_end(&ast, function));
+
+    flat_ast_free(&ast);
+    assert(flat_ast_build(&ast, NULL) == 0 && ast.nodes == NULL);
+    free_ast(program);
+    free_tokens(tokens, count);
+    printf("test_flat_ast passed.\n");
+}
+
+// Every operator and punctuator gets its own ID, and the parser dispatches on it
+void test_punctuator_ids() {
+    for (int id = PUNCT_NONE + 1; id < PUNCT_COUNT; id++) {
+        const char* name = punctuator_name(id);
+        assert(name && punctuator_lookup(name, (int)strlen(name)) == (PunctuatorId)id);
+    }
+    assert(punctuator_name(PUNCT_NONE) == NULL && punctuator_name(PUNCT_COUNT) == NULL);
+    assert(punctuator_lookup("=>", 2) == PUNCT_NONE && punctuator_lookup("@", 1) == PUNCT_NONE);
+    assert(punctuator_lookup("===", 2) == PUNCT_EQ);  // Spans need not be NUL-terminated
+
+    const char* code = "x <= y && !z || a -= (b); { c, d } e == f != g";
+    const PunctuatorId expected[] = {
+        PUNCT_NONE, PUNCT_LE, PUNCT_NONE, PUNCT_AND_AND, PUNCT_NOT, PUNCT_NONE, PUNCT_OR_OR, PUNCT_NONE,
+        PUNCT_MINUS_ASSIGN, PUNCT_LPAREN, PUNCT_NONE, PUNCT_RPAREN, PUNCT_SEMICOLON, PUNCT_LBRACE, PUNCT_NONE,
+        PUNCT_COMMA, PUNCT_NONE, PUNCT_RBRACE, PUNCT_NONE, PUNCT_EQ, PUNCT_NONE, PUNCT_NE, PUNCT_NONE, PUNCT_NONE
+    };
+    int count = 0;
+    Token* tokens = tokenize(code, &count);
+    assert(count == sizeof(expected) / sizeof(expected[0]));
+    for (int i = 0; i < count; i++) {
+        assert(tokens[i].punctuator == expected[i]);
+        assert(tokens[i].punctuator == PUNCT_NONE || token_equals(&tokens[i], punctuator_name(tokens[i].punctuator)));
+    }
+    free_tokens(tokens, count);
+
+    // Precedence comes from the table: * binds tighter than +, which binds tighter than <
+    tokens = tokenize_zero_copy("let v = 1 + 2 * 3 < 4;", &count);
+    ASTNode* program = parse_program(tokens, count);
+    assert(program->child_count == 1);
+    const ASTNode* less = program->children[0]->children[0];
+    assert(less->token.punctuator == PUNCT_LT && less->children[0]->token.punctuator == PUNCT_PLUS);
+    assert(less->children[0]->children[1]->token.punctuator == PUNCT_STAR);
+    free_ast(program);
+    free_tokens(tokens, count);
+    printf("test_punctuator_ids passed.\n");
+}
+
+// `depth` copies of `open`, then `middle`, then `depth` copies of `close`
+static char* nested_source(const char* open, const char* middle, const char* close, int depth) {
+    size_t open_length = strlen(open), middle_length = strlen(middle), close_length = strlen(close);
+    char* source = malloc((open_length + close_length) * depth + middle_length + 1);
+    char* p = source;
+    for (int i = 0; i < depth; i++, p += open_length) memcpy(p, open, open_length);
+    memcpy(p, middle, middle_length);
+    p += middle_length;
+    for (int i = 0; i < depth; i++, p += close_length) memcpy(p, close, close_length);
+    *p = '\0';
+    return source;
+}
+
+// Parse `code` with a nesting limit; returns the program and leaves the state for inspection
+static ASTNode* parse_with_limit(const char* code, int max_depth, ParserState* state, TokenSource* source) {
+    token_source_init(source, code, (int)strlen(code));
+    parser_state_init(state, source);
+    state->max_depth = max_depth;
+    return parse_with_state(state);
+}
+
+// Deep nesting is parsed without deep recursion, and limits fail cleanly
+void test_nesting_limits() {
+    enum { DEPTH = 1000000 };
+    char* code = nested_source("{", "let x = 1;", "}", DEPTH);
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    ASTNode* program = parse_program(tokens, count);
+    assert(program->child_count == 1);
+    const ASTNode* node = program->children[0];
+    for (int depth = 1; depth < DEPTH; depth++) {
+        assert(node->type == NODE_BLOCK && node->child_count == 1);
+        node = node->children[0];
+    }
+    assert(node->type == NODE_BLOCK && node->child_count == 1 && node->children[0]->type == NODE_VARIABLE_DECLARATION);
+    assert(report_undefined_names(program) == 0);  // The name passes walk any depth too
+    free_ast(program);
+    free_tokens(tokens, count);
+    free(code);
+
+    code = nested_source("(", "1", ")", DEPTH);
+    char* declaration = malloc(strlen(code) + 16);
+    sprintf(declaration, "let v = %s * 2;", code);
+    tokens = tokenize_zero_copy(declaration, &count);
+    program = parse_program(tokens, count);
+    assert(program->child_count == 1 && program->children[0]->child_count == 1);
+    node = program->children[0]->children[0];
+    assert(node->type == NODE_EXPRESSION && node->child_count == 2 && node->children[0]->type == NODE_FACTOR);
+    free_ast(program);
+    free_tokens(tokens, count);
+    free(declaration);
+    free(code);
+
+    // A left-associative chain nests as deep as it is long, and folds without recursing
+    code = malloc(DEPTH * 4 + 32);
+    int length = sprintf(code, "let sum = 1");
+    for (int i = 1; i < DEPTH; i++) length += sprintf(code + length, " + 1");
+    strcpy(code + length, "; let copy = sum;");
+    tokens = tokenize_zero_copy(code, &count);
+    program = parse_program(tokens, count);
+    NumberValue value;
+    assert(program->child_count == 2 && evaluate_constant(program->children[0]->children[0], &value));
+    assert(value.kind == NUMBER_INT && value.integer == DEPTH);
+    assert(report_undefined_names(program) == 0);
+    free_ast(program);
+    free_tokens(tokens, count);
+    free(code);
+
+    // max_depth levels parse; one more abandons the parse with a single diagnostic
+    TokenSource source;
+    ParserState state;
+    code = nested_source("{", "let y = (((1)));", "}", 97);
+    program = parse_with_limit(code, 100, &state, &source);
+    assert(program->child_count == 1 && !state.aborted && state.depth == 0 && state.recursion == 0);
+    free_ast(program);
+    program = parse_with_limit(code, 99, &state, &source);
+    assert(program->child_count == 0 && state.aborted && state.depth == 0 && state.recursion == 0);
+    free_ast(program);
+    free(code);
+
+    // Constructs parsed by recursion stop at PARSER_MAX_RECURSION
+    code = nested_source("if (x) { ", "let y = 1;", " }", PARSER_MAX_RECURSION);
+    program = parse_with_limit(code, PARSER_DEFAULT_MAX_DEPTH, &state, &source);
+    assert(program->child_count == 0 && state.aborted && state.recursion == 0);
+    free_ast(program);
+    free(code);
+    printf("test_nesting_limits passed.\n");
+}
+
+// One parse reports every syntax error and keeps everything around them
+void test_syntax_recovery() {
+    const char* code =
+        "let a = 1;\n"
+        "let b = ;\n"
+        "struct P { int x; 5 y; int z; }\n"
+        "enum C { Red, = 3, , Blue }\n"
+        "func f(x) { let c = ; print(x); }\n"
+        "switch (a) { case 1 { print(a); } default { print(a); } }\n"
+        "record R { ; q = 1; r = ; }\n"
+        "{ let e = 2;";
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    DiagnosticList diagnostics;
+    diagnostics_init(&diagnostics);
+    TokenSource source;
+    ParserState state;
+    token_source_init_array(&source, tokens, count);
+    parser_state_init(&state, &source);
+    state.diagnostics = &diagnostics;
+    ASTNode* program = parse_with_state(&state);
+
+    assert(!state.aborted && state.error_count == 10 && diagnostics.error_count == 10);
+    assert(program->child_count == 8);
+    const NodeType statements[] = { NODE_VARIABLE_DECLARATION, NODE_ERROR, NODE_STRUCT, NODE_ENUM,
+        NODE_FUNCTION, NODE_SWITCH, NODE_STRUCT, NODE_BLOCK };
+    for (int i = 0; i < 8; i++) {
+        assert(program->children[i]->type == statements[i]);
+    }
+
+    // The diagnostic spans the skipped statement
+    assert(diagnostics.items[0].line == 2 && diagnostics.items[0].column == 1);
+    assert(strncmp(code + diagnostics.items[0].offset, "let b = ;", diagnostics.items[0].length) == 0 &&
+        diagnostics.items[0].length == 9);
+
+    // Broken members become NODE_ERROR between their intact neighbours
+    const ASTNode* fields = program->children[2];
+    assert(fields->child_count == 3 && fields->children[1]->type == NODE_ERROR);
+    assert(token_equals(&fields->children[0]->token, "x") && token_equals(&fields->children[2]->token, "z"));
+    const ASTNode* enumerators = program->children[3];
+    assert(enumerators->child_count == 4 && enumerators->children[1]->type == NODE_ERROR &&
+        enumerators->children[2]->type == NODE_ERROR && token_equals(&enumerators->children[3]->token, "Blue"));
+    const ASTNode* body = program->children[4]->children[1];
+    assert(body->type == NODE_BLOCK && body->child_count == 2 && body->children[0]->type == NODE_ERROR &&
+        body->children[1]->type == NODE_PRINT_STATEMENT);
+    const ASTNode* cases = program->children[5];  // Both cases lack their ':'
+    assert(cases->child_count == 3 && cases->children[1]->type == NODE_ERROR && cases->children[2]->type == NODE_ERROR);
+    const ASTNode* record = program->children[6];
+    assert(record->child_count == 3 && record->children[0]->type == NODE_ERROR &&
+        token_equals(&record->children[1]->token, "q") && record->children[2]->type == NODE_ERROR);
+    // Input that ends inside a block closes it
+    assert(program->children[7]->child_count == 1 && program->children[7]->children[0]->type == NODE_VARIABLE_DECLARATION);
+    free_ast(program);
+    free_tokens(tokens, count);
+
+    // A malformed interpolation, such as one holding an unterminated string or
+    // comment, becomes a NODE_ERROR inside its string instead of ending the process
+    tokens = tokenize_zero_copy("print(\"${ \"${x\" }\"); print(\"${a /* open } ${}\"); print(\"${b}\");", &count);
+    diagnostics_clear(&diagnostics);
+    token_source_init_array(&source, tokens, count);
+    parser_state_init(&state, &source);
+    state.diagnostics = &diagnostics;
+    program = parse_with_state(&state);
+    assert(!state.aborted && state.error_count == 3 && diagnostics.error_count == 3 && program->child_count == 3);
+    const ASTNode* nested = program->children[0]->children[0];
+    assert(nested->type == NODE_STRING_INTERPOLATION && nested->child_count == 1 && nested->children[0]->type == NODE_ERROR);
+    assert(diagnostics.items[0].offset == nested->token.offset);
+    const ASTNode* open = program->children[1]->children[0];
+    assert(open->child_count == 3 && token_equals(&open->children[0]->token, "a") &&
+        open->children[1]->type == NODE_ERROR && open->children[2]->type == NODE_ERROR);
+    const ASTNode* intact = program->children[2]->children[0];
+    assert(intact->child_count == 1 && token_equals(&intact->children[0]->token, "b"));
+
+    free_ast(program);
+    diagnostics_free(&diagnostics);
+    free_tokens(tokens, count);
+
+    // Valid input records nothing
+    tokens = tokenize_zero_copy("let a = 1; { print(a); }", &count);
+    token_source_init_array(&source, tokens, count);
+    parser_state_init(&state, &source);
+    program = parse_with_state(&state);
+    assert(state.error_count == 0 && program->child_count == 2);
+    free_ast(program);
+    free_tokens(tokens, count);
+    printf("test_syntax_recovery passed.\n");
+}
+
+// Statement spans match, as positions in the whole token array
+static int token_spans_equal(const ASTNode* a, const ASTNode* b) {
+    if (a->token_first != b->token_first || a->token_count != b->token_count) return 0;
+    for (int i = 0; i < a->child_count; i++) {
+        if (!token_spans_equal(a->children[i], b->children[i])) return 0;
+    }
+    return 1;
+}
+
+// Parsing top-level declarations on several threads builds the serial tree
+void test_parallel_parser() {
+    enum { DECLARATIONS = 2000 };
+    char* code = malloc(DECLARATIONS * 128);
+    int length = 0;
+    for (int i = 0; i < DECLARATIONS; i++) {
+        length += sprintf(code + length, "func f%d(a, b) { let s = a + %d; { let t = b * s; } }\nlet v%d = (%d + 1) * 2;\n", i, i, i, i);
+        if (i % 500 == 250) {
+            length += sprintf(code + length, "struct S%d { int x; float y; }\nenum E%d { A, B = %d, C }\nrecord R%d { x = %d; }\nlet broken%d = ;\n",
+                i, i, i, i, i, i);
+        }
+    }
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+
+    TokenSource source;
+    ParserState state;
+    token_source_init_array(&source, tokens, count);
+    parser_state_init(&state, &source);
+    ASTNode* serial = parse_with_state(&state);
+    assert(serial->child_count == 2 * DECLARATIONS + 4 * 4 && state.error_count == 4);
+
+    // Every cut lands on a top-level declaration
+    int cuts[17];
+    int ranges = parser_prescan_cuts(tokens, count, 16, cuts);
+    assert(ranges > 1 && cuts[0] == 0 && cuts[ranges] == count);
+    for (int i = 1; i < ranges; i++) {
+        KeywordId keyword = tokens[cuts[i]].keyword;
+        assert(cuts[i] > cuts[i - 1] && (keyword == KEYWORD_FUNC || keyword == KEYWORD_STRUCT ||
+            keyword == KEYWORD_ENUM || keyword == KEYWORD_RECORD));
+        assert(tokens[cuts[i] - 1].punctuator == PUNCT_SEMICOLON || tokens[cuts[i] - 1].punctuator == PUNCT_RBRACE);
+    }
+
+    const int thread_counts[] = { 1, 2, 3, 8 };
+    for (int t = 0; t < 4; t++) {
+        ParallelAst ast;
+        ASTNode* program = parse_program_parallel(&ast, tokens, count, thread_counts[t]);
+        assert(program == ast.program && ast_equal(serial, program) && ast.error_count == 4);
+        assert(token_spans_equal(serial, program));
+        assert(ast.arena_count >= 1 && ast.arena_count <= thread_counts[t]);
+        parallel_ast_free(&ast);
+    }
+    free_ast(serial);
+    free_tokens(tokens, count);
+
+    // An unclosed brace leaves nothing at the top level to cut at
+    memcpy(code, "{ ", 2);
+    tokens = tokenize_zero_copy(code, &count);
+    assert(parser_prescan_cuts(tokens, count, 16, cuts) == 1);
+    free_tokens(tokens, count);
+    free(code);
+    printf("test_parallel_parser passed.\n");
+}
+
+// Source, tokens and tree of an editor buffer, kept in step by reparse_after_edit()
+typedef struct {
+    char* code;
+    int length;
+    Token* tokens;
+    int count;
+    ASTNode* program;
+} EditedProgram;
+
+// Statement and block spans must match too, or the next reparse looks in the wrong place
+static int spans_equal(const ASTNode* a, const ASTNode* b) {
+    if (a->token_count != b->token_count) return 0;
+    for (int i = 0; i < a->child_count; i++) {
+        if (!spans_equal(a->children[i], b->children[i])) return 0;
+    }
+    return 1;
+}
+
+// Apply `edit`, re-lex, reparse, and check the tree against parsing the edited tokens from scratch
+static void reparse_after_edit(EditedProgram* buffer, TextEdit edit) {
+    int new_length = 0;
+    char* edited = apply_text_edit(buffer->code, buffer->length, &edit, &new_length);
+    RelexRange changed;
+    buffer->tokens = relex_tokens(buffer->tokens, &buffer->count, edited, new_length, &edit, NULL, &changed);
+    free(buffer->code);  // Kept nodes must not point into the old source
+    buffer->code = edited;
+    buffer->length = new_length;
+    buffer->program = reparse_program(buffer->program, buffer->tokens, buffer->count, &changed);
+
+    ASTNode* expected = parse_program(buffer->tokens, buffer->count);
+    assert(ast_equal(buffer->program, expected) && spans_equal(buffer->program, expected));
+    free_ast(expected);
+}
+
+static void replace_text(EditedProgram* buffer, const char* text, const char* replacement) {
+    const char* found = strstr(buffer->code, text);
+    assert(found);
+    reparse_after_edit(buffer, (TextEdit){ (int)(found - buffer->code), (int)strlen(text), replacement, (int)strlen(replacement) });
+}
+
+static ASTNode* function_body(const ASTNode* function) {
+    return function->children[function->child_count - 1];
+}
+
+// Reparsing after an edit must build the tree a full parse builds, reusing every statement the edit did not touch
+void test_incremental_reparse() {
+    const char* seed =
+        "let base = 10;\n"
+        "func first(a) { let x = a + 1; if (x > base) { print(x); } else { print(a); } }\n"
+        "func second(b) { let y = b * 2; { let z = y - 1; print(z); } print(y); }\n"
+        "func third(c) { if (c) { print(c); } }\n";
+    EditedProgram buffer;
+    buffer.length = (int)strlen(seed);
+    buffer.code = apply_text_edit(seed, buffer.length, &(TextEdit){ 0, 0, "", 0 }, &buffer.length);
+    buffer.tokens = tokenize_buffer(buffer.code, buffer.length, &buffer.count);
+    buffer.program = parse_program(buffer.tokens, buffer.count);
+    ASTNode* program = buffer.program;
+    ASTNode* first = program->children[1];
+    ASTNode* second = program->children[2];
+    ASTNode* third = program->children[3];
+    ASTNode* if_statement = function_body(first)->children[1];
+
+    // Only the edited statement is new; its function, body and neighbours are kept
+    replace_text(&buffer, "a + 1", "a + 2 * a");
+    assert(buffer.program == program && program->children[1] == first && program->children[3] == third);
+    assert(function_body(first)->children[1] == if_statement);
+
+    // Growing the if block moves the else block; both stay in place
+    ASTNode* else_block = if_statement->children[2];
+    replace_text(&buffer, "print(x);", "print(x); print(x + 1);");
+    assert(function_body(first)->children[1] == if_statement && if_statement->children[1]->child_count == 2);
+    replace_text(&buffer, "print(a)", "print(a - 1)");
+    assert(function_body(first)->children[1] == if_statement && if_statement->children[2] == else_block);
+
+    // Inner blocks are statement lists of their own
+    ASTNode* inner = function_body(second)->children[1];
+    replace_text(&buffer, "let z = y - 1;", "let z = y - 1; let w = z;");
+    assert(program->children[2] == second && function_body(second)->children[1] == inner && inner->child_count == 3);
+
+    // A broken statement stays inside its function, and so does its repair
+    replace_text(&buffer, "let y = b * 2;", "let y = ;");
+    assert(program->children[2] == second && function_body(second)->children[0]->type == NODE_ERROR);
+    replace_text(&buffer, "let y = ;", "let y = b * 2;");
+    assert(program->children[2] == second && function_body(second)->child_count == 3);
+
+    // A new top-level statement between two functions; the one before it is
+    // parsed again too, since it may have peeked at the new tokens
+    int third_offset = (int)(strstr(buffer.code, "func third") - buffer.code);
+    reparse_after_edit(&buffer, (TextEdit){ third_offset, 0, "let middle = 1;\n", 16 });
+    assert(buffer.program == program && program->child_count == 5);
+    assert(program->children[1] == first && program->children[4] == third);
+
+    // An unbalanced brace cannot be reparsed in place; neither can an edit across functions
+    replace_text(&buffer, "func third(c) {", "func third(c) { {");
+    replace_text(&buffer, "func third(c) { {", "func third(c) {");
+    replace_text(&buffer, "print(a - 1); } }\nfunc second(b) { let y", "let y");
+
+    // Random edits, each checked against a full parse
+    const char* fragments[] = { "let q = 1; ", "{ ", "} ", "print(a); ", "if (a) { ", "( ", ") ", "; ", "x ", "else ", "func g() { " };
+    unsigned int random = 2024;
+    for (int step = 0; step < 300; step++) {
+        random = random * 1103515245u + 12345u;
+        Token* target = &buffer.tokens[(random >> 8) % buffer.count];
+        TextEdit edit = { target->offset, 0, "", 0 };
+        if ((random >> 4) % 3 == 0 || buffer.count > 300) {  // Delete a token and the trivia after it
+            if (target->type != TOKEN_EOF) edit.deleted_length = (target + 1)->offset - target->offset;
+        }
+        else {
+            edit.inserted = fragments[(random >> 16) % (sizeof(fragments) / sizeof(fragments[0]))];
+            edit.inserted_length = (int)strlen(edit.inserted);
+        }
+        reparse_after_edit(&buffer, edit);
+    }
+
+    free_ast(buffer.program);
+    free_tokens(buffer.tokens, buffer.count);
+    free(buffer.code);
+    printf("test_incremental_reparse passed.\n");
+}
+
+// Everything a cache keeps besides the shape and text ast_equal() compares
+static int cached_fields_equal(const ASTNode* a, const ASTNode* b) {
+    if (a->token.type != b->token.type || a->token.line != b->token.line || a->token.column != b->token.column ||
+        a->token.offset != b->token.offset || a->token.keyword != b->token.keyword ||
+        a->token.punctuator != b->token.punctuator || a->token.number.kind != b->token.number.kind ||
+        a->inferred_type != b->inferred_type || a->token_first != b->token_first || a->token_count != b->token_count) {
+        return 0;
+    }
+    for (int i = 0; i < a->child_count; i++) {
+        if (!cached_fields_equal(a->children[i], b->children[i])) return 0;
+    }
+    return 1;
+}
+
+static void write_test_file(const char* path, const char* data, int length) {
+    FILE* file = fopen(path, "wb");
+    assert(file);
+    fwrite(data, 1, length, file);
+    fclose(file);
+}
+
+// A program written to a .csast file loads back as the tree it was parsed into,
+// but only for the source it was written from
+void test_ast_cache() {
+    const char* source_path = "csark_cache_source.tmp";
+    const char* cache_path = "csark_cache_test.csast";
+    const char* damaged_path = "csark_cache_damaged.csast";
+    const char* code = "func add(a, b) {\n    let total = a + b * 2;\n    if (total) { print(\"sum\"); }\n"
+        "    print(total);\n}\nlet x = 1 + 2.5;\nlet y = x * x;\n";
+    int length = (int)strlen(code);
+
+    int count = 0;
+    Token* tokens = tokenize_zero_copy(code, &count);
+    ASTNode* program = parse_program(tokens, count);
+    program->children[1]->inferred_type = TYPE_INT;
+    assert(ast_cache_write(cache_path, program, code, length));
+
+    AstCache cache;
+    Arena arena;
+    arena_init(&arena, 0);
+    assert(ast_cache_open(&cache, cache_path, code, length));
+    FlatAst flat;
+    assert(flat_ast_build(&flat, program) == (int)cache.node_count);
+    flat_ast_free(&flat);
+    assert(cache.header->string_count < cache.node_count);  // "total", "x" and the punctuators are stored once
+    ASTNode* loaded = ast_cache_to_ast(&cache, &arena);
+    assert(ast_equal(program, loaded) && cached_fields_equal(program, loaded));
+    int text_length;
+    assert(strcmp(ast_cache_text(&cache, 0, &text_length), "program") == 0 && text_length == 7);
+    ast_cache_close(&cache);
+
+    // An edited source, a truncated file or a missing one is a miss
+    char edited[256];
+    memcpy(edited, code, length + 1);
+    edited[length - 3] = 'y';
+    assert(!ast_cache_open(&cache, cache_path, edited, length));
+
+    SourceFile file;
+    assert(source_file_open(&file, cache_path));
+    write_test_file(damaged_path, file.data, file.length - 16);
+    assert(!ast_cache_open(&cache, damaged_path, code, length));
+    write_test_file(damaged_path, file.data, (int)sizeof(AstCacheHeader) / 2);
+    assert(!ast_cache_open(&cache, damaged_path, code, length));
+    source_file_close(&file);
+    assert(!ast_cache_open(&cache, "csark_missing_cache.csast", code, length));
+
+    // The first run parses and writes the cache, the next one loads it
+    remove(cache_path);
+    write_test_file(source_path, code, length);
+    int from_cache = -1;
+    ASTNode* parsed = ast_cache_parse_file(source_path, cache_path, &arena, &from_cache);
+    assert(parsed && from_cache == 0 && ast_equal(program, parsed));
+    ASTNode* reloaded = ast_cache_parse_file(source_path, cache_path, &arena, &from_cache);
+    assert(reloaded && from_cache == 1 && ast_equal(parsed, reloaded) && cached_fields_equal(parsed, reloaded));
+
+    // A source with syntax errors is parsed, and its errors reported, on every run
+    const char* broken = "let x = ;\nlet y = 2;\n";
+    remove(cache_path);
+    write_test_file(source_path, broken, (int)strlen(broken));
+    for (int run = 0; run < 2; run++) {
+        ASTNode* recovered = ast_cache_parse_file(source_path, cache_path, &arena, &from_cache);
+        assert(recovered && from_cache == 0);
+    }
+    FILE* missing = fopen(cache_path, "rb");
+    assert(!missing);
+
+    remove(source_path);
+    remove(damaged_path);
+    arena_free(&arena);
+    free_ast(program);
+    free_tokens(tokens, count);
+    printf("test_ast_cache passed.\n");
+}
+
 // Run debug tests
 void run_debug_tests() {
     printf("Running debug tests...\n");
@@ -235,8 +1726,16 @@ void test_tokenize_identifier() {
 // Test parse_function_parameters
 void test_parse_function_parameters() {
     printf("Testing parse_function_parameters...\n");
+    int count = 0;
+    Token* tokens = tokenize_zero_copy("a, b)", &count);
+    TokenSource source;
     ParserState state;
-    ASTNode* params = parse_function_parameters(&state);
-    assert(params != NULL);
+    token_source_init_array(&source, tokens, count);
+    parser_state_init(&state, &source);
+    ASTNode* function = calloc(1, sizeof(ASTNode));
+    function->type = NODE_FUNCTION;
+    assert(parse_function_parameters(&state, function) && function->child_count == 2);
+    free_ast(function);
+    free_tokens(tokens, count);
     printf("--> parse_function_parameters passed\n");
 }
\ No newline at end of file
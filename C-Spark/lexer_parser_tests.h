@@ -30,5 +30,31 @@ void test_invalid_record_syntax();
 void test_handle_unknown_character();
 void test_tokenize_identifier();
 void test_parse_function_parameters();
+void test_zero_copy_tokens();
+void test_table_lexer_matches_reference();
+void test_keyword_ids();
+void test_scan_kernels();
+void test_tokenize_buffer_bounds();
+void test_tokenize_file();
+void test_token_source_window();
+void test_parse_source_matches_array();
+void test_parallel_lexer_matches_serial();
+void test_relex_matches_full_lex();
+void test_interner();
+void test_token_stream_matches_tokens();
+void test_huge_tokens();
+void test_number_literals();
+void test_recovering_lexer();
+void test_suggestion_index();
+void test_concurrent_parsing();
+void test_ast_arena();
+void test_child_storage();
+void test_flat_ast();
+void test_punctuator_ids();
+void test_nesting_limits();
+void test_syntax_recovery();
+void test_parallel_parser();
+void test_incremental_reparse();
+void test_ast_cache();
 void run_debug_tests();
 #endif // LEXER_PARSER_TESTS_H
@@ -0,0 +1,364 @@
+// lexer_simd.c
+#include "lexer_simd.h"
+#include "threads.h"
+#include <stddef.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LEXER_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// --- Bit Helpers ---
+static int count_bits(unsigned int mask) {
+#if defined(_MSC_VER)
+    mask = mask - ((mask >> 1) & 0x55555555u);
+    mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+    return (int)((((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+// Index of the lowest set bit (mask must be non-zero)
+static int lowest_bit(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Index of the highest set bit (mask must be non-zero)
+static int highest_bit(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return (int)index;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+// Bits [0, count) set
+static unsigned int mask_below(int count) {
+    return count >= 32 ? 0xFFFFFFFFu : (1u << count) - 1;
+}
+
+// Account for the newlines flagged in a block that starts at `base`
+static void count_newlines(unsigned int newline_mask, int base, int* line, int* line_start) {
+    if (newline_mask) {
+        *line += count_bits(newline_mask);
+        *line_start = base + highest_bit(newline_mask) + 1;
+    }
+}
+
+// --- Scalar Kernels ---
+static int scalar_skip_whitespace(const char* code, int position, int end, int* line, int* line_start) {
+    for (; position < end; position++) {
+        char c = code[position];
+        if (c == '\n') {
+            (*line)++;
+            *line_start = position + 1;
+        }
+        else if (c != ' ' && (c < '\t' || c > '\r')) {
+            break;
+        }
+    }
+    return position;
+}
+
+static int scalar_find_line_end(const char* code, int position, int end) {
+    while (position < end && code[position] != '\n') position++;
+    return position;
+}
+
+static int scalar_find_comment_end(const char* code, int position, int end, int* line, int* line_start) {
+    for (; position < end; position++) {
+        if (code[position] == '*' && position + 1 < end && code[position + 1] == '/') {
+            break;
+        }
+        if (code[position] == '\n') {
+            (*line)++;
+            *line_start = position + 1;
+        }
+    }
+    return position;
+}
+
+static int scalar_find_string_special(const char* code, int position, int end, int* line, int* line_start) {
+    for (; position < end; position++) {
+        char c = code[position];
+        if (c == '"' || c == '\\' || c == '$') {
+            break;
+        }
+        if (c == '\n') {
+            (*line)++;
+            *line_start = position + 1;
+        }
+    }
+    return position;
+}
+
+static const ScanKernels scalar_kernels = {
+    SIMD_SCALAR, "scalar",
+    scalar_skip_whitespace, scalar_find_line_end, scalar_find_comment_end, scalar_find_string_special
+};
+
+#ifdef LEXER_SIMD_X86
+// --- SSE2 Kernels (16 bytes per step) ---
+// Whitespace is ' ' or a byte in '\t'..'\r'; the range test is min(c - '\t', 4) == c - '\t'.
+SIMD_TARGET_SSE2
+static int sse2_skip_whitespace(const char* code, int position, int end, int* line, int* line_start) {
+    const __m128i space = _mm_set1_epi8(' '), newline = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t'), control_span = _mm_set1_epi8('\r' - '\t');
+
+    while (position + 16 <= end) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(code + position));
+        __m128i control = _mm_sub_epi8(block, tab);
+        __m128i is_space = _mm_or_si128(_mm_cmpeq_epi8(block, space),
+            _mm_cmpeq_epi8(_mm_min_epu8(control, control_span), control));
+        unsigned int spaces = (unsigned int)_mm_movemask_epi8(is_space);
+        unsigned int newlines = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+
+        if (spaces != 0xFFFFu) {
+            int stop = lowest_bit(~spaces);
+            count_newlines(newlines & mask_below(stop), position, line, line_start);
+            return position + stop;
+        }
+        count_newlines(newlines, position, line, line_start);
+        position += 16;
+    }
+    return scalar_skip_whitespace(code, position, end, line, line_start);
+}
+
+SIMD_TARGET_SSE2
+static int sse2_find_line_end(const char* code, int position, int end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (position + 16 <= end) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(code + position));
+        unsigned int hits = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (hits) {
+            return position + lowest_bit(hits);
+        }
+        position += 16;
+    }
+    return scalar_find_line_end(code, position, end);
+}
+
+// Compares each block with the block one byte further on to find '*' followed by '/'
+SIMD_TARGET_SSE2
+static int sse2_find_comment_end(const char* code, int position, int end, int* line, int* line_start) {
+    const __m128i star = _mm_set1_epi8('*'), slash = _mm_set1_epi8('/'), newline = _mm_set1_epi8('\n');
+
+    while (position + 17 <= end) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(code + position));
+        __m128i next = _mm_loadu_si128((const __m128i*)(code + position + 1));
+        unsigned int hits = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block, star), _mm_cmpeq_epi8(next, slash)));
+        unsigned int newlines = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+
+        if (hits) {
+            int stop = lowest_bit(hits);
+            count_newlines(newlines & mask_below(stop), position, line, line_start);
+            return position + stop;
+        }
+        count_newlines(newlines, position, line, line_start);
+        position += 16;
+    }
+    return scalar_find_comment_end(code, position, end, line, line_start);
+}
+
+SIMD_TARGET_SSE2
+static int sse2_find_string_special(const char* code, int position, int end, int* line, int* line_start) {
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+    const __m128i dollar = _mm_set1_epi8('$'), newline = _mm_set1_epi8('\n');
+
+    while (position + 16 <= end) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(code + position));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+            _mm_or_si128(_mm_cmpeq_epi8(block, backslash), _mm_cmpeq_epi8(block, dollar)));
+        unsigned int hits = (unsigned int)_mm_movemask_epi8(special);
+        unsigned int newlines = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+
+        if (hits) {
+            int stop = lowest_bit(hits);
+            count_newlines(newlines & mask_below(stop), position, line, line_start);
+            return position + stop;
+        }
+        count_newlines(newlines, position, line, line_start);
+        position += 16;
+    }
+    return scalar_find_string_special(code, position, end, line, line_start);
+}
+
+static const ScanKernels sse2_kernels = {
+    SIMD_SSE2, "sse2",
+    sse2_skip_whitespace, sse2_find_line_end, sse2_find_comment_end, sse2_find_string_special
+};
+
+// --- AVX2 Kernels (32 bytes per step) ---
+SIMD_TARGET_AVX2
+static int avx2_skip_whitespace(const char* code, int position, int end, int* line, int* line_start) {
+    const __m256i space = _mm256_set1_epi8(' '), newline = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t'), control_span = _mm256_set1_epi8('\r' - '\t');
+
+    while (position + 32 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(code + position));
+        __m256i control = _mm256_sub_epi8(block, tab);
+        __m256i is_space = _mm256_or_si256(_mm256_cmpeq_epi8(block, space),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(control, control_span), control));
+        unsigned int spaces = (unsigned int)_mm256_movemask_epi8(is_space);
+        unsigned int newlines = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+
+        if (spaces != 0xFFFFFFFFu) {
+            int stop = lowest_bit(~spaces);
+            count_newlines(newlines & mask_below(stop), position, line, line_start);
+            return position + stop;
+        }
+        count_newlines(newlines, position, line, line_start);
+        position += 32;
+    }
+    return sse2_skip_whitespace(code, position, end, line, line_start);
+}
+
+SIMD_TARGET_AVX2
+static int avx2_find_line_end(const char* code, int position, int end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    while (position + 32 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(code + position));
+        unsigned int hits = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        if (hits) {
+            return position + lowest_bit(hits);
+        }
+        position += 32;
+    }
+    return sse2_find_line_end(code, position, end);
+}
+
+SIMD_TARGET_AVX2
+static int avx2_find_comment_end(const char* code, int position, int end, int* line, int* line_start) {
+    const __m256i star = _mm256_set1_epi8('*'), slash = _mm256_set1_epi8('/'), newline = _mm256_set1_epi8('\n');
+
+    while (position + 33 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(code + position));
+        __m256i next = _mm256_loadu_si256((const __m256i*)(code + position + 1));
+        unsigned int hits = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block, star), _mm256_cmpeq_epi8(next, slash)));
+        unsigned int newlines = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+
+        if (hits) {
+            int stop = lowest_bit(hits);
+            count_newlines(newlines & mask_below(stop), position, line, line_start);
+            return position + stop;
+        }
+        count_newlines(newlines, position, line, line_start);
+        position += 32;
+    }
+    return sse2_find_comment_end(code, position, end, line, line_start);
+}
+
+SIMD_TARGET_AVX2
+static int avx2_find_string_special(const char* code, int position, int end, int* line, int* line_start) {
+    const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+    const __m256i dollar = _mm256_set1_epi8('$'), newline = _mm256_set1_epi8('\n');
+
+    while (position + 32 <= end) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(code + position));
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(block, quote),
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, backslash), _mm256_cmpeq_epi8(block, dollar)));
+        unsigned int hits = (unsigned int)_mm256_movemask_epi8(special);
+        unsigned int newlines = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+
+        if (hits) {
+            int stop = lowest_bit(hits);
+            count_newlines(newlines & mask_below(stop), position, line, line_start);
+            return position + stop;
+        }
+        count_newlines(newlines, position, line, line_start);
+        position += 32;
+    }
+    return sse2_find_string_special(code, position, end, line, line_start);
+}
+
+static const ScanKernels avx2_kernels = {
+    SIMD_AVX2, "avx2",
+    avx2_skip_whitespace, avx2_find_line_end, avx2_find_comment_end, avx2_find_string_special
+};
+
+// --- CPU Detection ---
+#if defined(_MSC_VER)
+static int cpu_has_sse2(void) {
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+}
+
+static int cpu_has_avx2(void) {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+    __cpuid(info, 1);
+    // The OS must save the YMM registers (OSXSAVE + AVX, XCR0 bits 1 and 2)
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+#else
+static int cpu_has_sse2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+static int cpu_has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif // LEXER_SIMD_X86
+
+// Kernels for one level, NULL if the CPU lacks it
+const ScanKernels* scan_kernels_for(SimdLevel level) {
+    switch (level) {
+    case SIMD_SCALAR:
+        return &scalar_kernels;
+#ifdef LEXER_SIMD_X86
+    case SIMD_SSE2:
+        return cpu_has_sse2() ? &sse2_kernels : NULL;
+    case SIMD_AVX2:
+        return cpu_has_avx2() && cpu_has_sse2() ? &avx2_kernels : NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+// Fastest kernels supported by this CPU, chosen on first use. Lexers on
+// several threads may ask at once, so the choice is made under a lock; it is
+// taken once per lexer, not per token.
+const ScanKernels* scan_kernels(void) {
+    static Mutex selected_lock = MUTEX_INIT;
+    static const ScanKernels* selected = NULL;
+    mutex_lock(&selected_lock);
+    if (!selected) {
+        const ScanKernels* best = scan_kernels_for(SIMD_AVX2);
+        if (!best) best = scan_kernels_for(SIMD_SSE2);
+        if (!best) best = &scalar_kernels;
+        selected = best;
+    }
+    const ScanKernels* kernels = selected;
+    mutex_unlock(&selected_lock);
+    return kernels;
+}
@@ -0,0 +1,31 @@
+#ifndef LEXER_SIMD_H
+#define LEXER_SIMD_H
+
+// Instruction sets the scanning kernels are built for
+typedef enum {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2
+} SimdLevel;
+
+// Scanning kernels for the runs of bytes the lexer skips in bulk. Every kernel
+// scans code[position, end) and returns the offset where it stopped; kernels
+// that cross newlines advance *line and set *line_start to the offset just past
+// the last newline they consumed.
+typedef struct ScanKernels {
+    SimdLevel level;
+    const char* name;
+    // Skip ' ', '\t', '\n', '\v', '\f' and '\r'
+    int (*skip_whitespace)(const char* code, int position, int end, int* line, int* line_start);
+    // Find the '\n' ending a '//' comment
+    int (*find_line_end)(const char* code, int position, int end);
+    // Find the '*' of the '*/' ending a block comment
+    int (*find_comment_end)(const char* code, int position, int end, int* line, int* line_start);
+    // Find the next '"', '\\' or '$' in a string body
+    int (*find_string_special)(const char* code, int position, int end, int* line, int* line_start);
+} ScanKernels;
+
+const ScanKernels* scan_kernels(void);                  // Fastest kernels supported by this CPU
+const ScanKernels* scan_kernels_for(SimdLevel level);   // Kernels for one level, NULL if the CPU lacks it
+
+#endif // LEXER_SIMD_H
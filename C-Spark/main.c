@@ -1,8 +1,10 @@
 #include <stdio.h>
+#include <string.h>
 #include "test_transpile_suite.h"
 #include "lexer_parser_tests.h"
 #include "test_error_handling.h"
 #include "test_achievements.h"
+#include "test_benchmarks.h"
 #include "tokenizer.h"
 #include "debugger.h"
 
@@ -12,7 +14,20 @@ void print_section_header(const char* title) {
     printf("========================================\n\n");
 }
 
-int main() {
+// Pass --benchmarks to also run the benchmarks, which lex and parse
+// multi-megabyte sources and take far longer than the tests
+int main(int argc, char** argv) {
+    int run_benchmarks = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--benchmarks") == 0) {
+            run_benchmarks = 1;
+        }
+        else {
+            fprintf(stderr, "Error: Unknown option '%s' (expected --benchmarks)\n", argv[i]);
+            return 1;
+        }
+    }
+
     enable_debugging();  // Enable Debugging Mode
     printf("****************************************\n");
     printf("     C-Spark Automated Test Suite       \n");
@@ -29,6 +44,32 @@ int main() {
     printf("Running additional Lexer & Parser tests...\n");
     test_deeply_nested_blocks();
     test_invalid_syntax();
+    test_zero_copy_tokens();
+    test_table_lexer_matches_reference();
+    test_keyword_ids();
+    test_scan_kernels();
+    test_tokenize_buffer_bounds();
+    test_tokenize_file();
+    test_token_source_window();
+    test_parse_source_matches_array();
+    test_parallel_lexer_matches_serial();
+    test_relex_matches_full_lex();
+    test_interner();
+    test_token_stream_matches_tokens();
+    test_huge_tokens();
+    test_number_literals();
+    test_recovering_lexer();
+    test_suggestion_index();
+    test_concurrent_parsing();
+    test_ast_arena();
+    test_child_storage();
+    test_flat_ast();
+    test_punctuator_ids();
+    test_nesting_limits();
+    test_syntax_recovery();
+    test_parallel_parser();
+    test_incremental_reparse();
+    test_ast_cache();
 
     /*********************************************************/
     /*                TRANSPILER TESTS                       */
@@ -40,6 +81,8 @@ int main() {
     run_test("Test IRNode creation", test_ir_node_creation);
     run_test("Test unsupported node handling", test_unsupported_node_handling);
     run_test("Test generate_code_from_ir", test_generate_code_from_ir);
+    run_test("Test IRBuilder", test_ir_builder);
+    run_test("Test transpiled children are emitted once", test_transpile_children_once);
 
     printf("Running additional Transpiler tests...\n");
     test_interdependent_functions();
@@ -62,6 +105,33 @@ int main() {
     run_test("Test unlock_achievement", test_unlock_achievement);
     run_test("Test save and load achievements", test_save_and_load_achievements);
 
+    /*********************************************************/
+    /*                      BENCHMARKS                       */
+    /*********************************************************/
+    print_section_header("Benchmarks");
+
+    if (run_benchmarks) {
+        benchmark_lexer_engines();
+        benchmark_scan_kernels();
+        benchmark_streaming_parser();
+        benchmark_parallel_lexer();
+        benchmark_incremental_lexer();
+        benchmark_token_stream();
+        benchmark_huge_tokens();
+        benchmark_suggestions();
+        benchmark_ast_arena();
+        benchmark_child_growth();
+        benchmark_flat_ast();
+        benchmark_operator_dispatch();
+        benchmark_parallel_parser();
+        benchmark_incremental_parser();
+        benchmark_ast_cache();
+        benchmark_ir_builder();
+    }
+    else {
+        printf("Skipped; run with --benchmarks to include them.\n");
+    }
+
     /*********************************************************/
     /*                FINAL DEBUGGING TESTS                  */
     /*********************************************************/
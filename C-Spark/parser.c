@@ -2,32 +2,29 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include "utils.h"
 #include "debugger.h"
 #include "inline_hints.h"  // Include the Inline Hints system
-
-// Global state
-static Token* tokens;
-static int token_count;
-static int current_token;
+#include "error_reporting.h"
 
 // Forward Declarations
-ASTNode* parse_statement();
-ASTNode* parse_block();
-ASTNode* parse_variable_declaration();
-ASTNode* parse_function_definition();
-ASTNode* parse_for_statement();
-ASTNode* parse_expression();
-ASTNode* parse_term();
-ASTNode* parse_factor();
-ASTNode* parse_if_statement();
-ASTNode* parse_print_statement();
-ASTNode* parse_record_definition();
-ASTNode* parse_switch_statement();
-ASTNode* parse_case_statement();
-ASTNode* parse_default_case();
-ASTNode* parse_struct(void);
-ASTNode* parse_enum(void);
+ASTNode* parse_statement(ParserState* state);
+ASTNode* parse_block(ParserState* state);
+ASTNode* parse_variable_declaration(ParserState* state);
+ASTNode* parse_function_definition(ParserState* state);
+ASTNode* parse_for_statement(ParserState* state);
+ASTNode* parse_expression(ParserState* state);
+ASTNode* parse_term(ParserState* state);
+ASTNode* parse_factor(ParserState* state);
+ASTNode* parse_if_statement(ParserState* state);
+ASTNode* parse_print_statement(ParserState* state);
+ASTNode* parse_record_definition(ParserState* state);
+ASTNode* parse_switch_statement(ParserState* state);
+ASTNode* parse_case_statement(ParserState* state);
+ASTNode* parse_default_case(ParserState* state);
+ASTNode* parse_struct(ParserState* state);
+ASTNode* parse_enum(ParserState* state);
 
 void print_ast(ASTNode* node, int depth);
 
@@ -38,6 +35,13 @@ DataType resolve_type(const char* type_name) {
     return TYPE_UNKNOWN; // Catch-all for unsupported types
 }
 
+static DataType resolve_type_token(const Token* token) {
+    if (token_equals(token, "int")) return TYPE_INT;
+    if (token_equals(token, "float")) return TYPE_FLOAT;
+    if (token_equals(token, "custom_type")) return TYPE_CUSTOM;
+    return TYPE_UNKNOWN; // Catch-all for unsupported types
+}
+
 int validate_types(DataType lhs, DataType rhs, const char* operator) {
     if ((lhs == TYPE_INT || lhs == TYPE_FLOAT) &&
         (rhs == TYPE_INT || rhs == TYPE_FLOAT)) {
@@ -63,223 +67,562 @@ void* check_memory_allocation(void* ptr, const char* context_message) {
 }
 
 // Helper Functions
-Token* advance() {
-    return (current_token < token_count) ? &tokens[current_token++] : NULL;
+Token* advance(ParserState* state) {
+    return token_source_next(state->source);
 }
 
-Token* peek() {
-    return (current_token >= 0 && current_token < token_count) ? &tokens[current_token] : NULL;
+Token* peek(ParserState* state) {
+    return token_source_peek(state->source, 0);
 }
 
-int match(TokenType type, const char* value) {
-    if (current_token < 0 || current_token >= token_count) {
-        fprintf(stderr, "Error: Invalid token access. current_token=%d, token_count=%d\n", current_token, token_count);
-        return 0;
-    }
+// The most recently consumed token
+static Token* previous_token(ParserState* state) {
+    return token_source_previous(state->source, 1);
+}
 
-    Token* current = &tokens[current_token];
+int match(ParserState* state, TokenType type, const char* value) {
+    Token* current = peek(state);
 
-    if (!current || !current->value) {
-        fprintf(stderr, "Error: NULL token or token value at index %d\n", current_token);
+    if (!current) {
+        fprintf(stderr, "Error: Invalid token access past the end of input (token %d)\n", token_source_position(state->source));
         return 0;
     }
 
-    if (current->type == type && (value == NULL || strcmp(current->value, value) == 0)) {
-        advance();
+    if (current->type == type && (value == NULL || token_equals(current, value))) {
+        advance(state);
         return 1;
     }
 
     return 0; // No match
 }
 
-// Synchronize Function
-void synchronize() {
-    while (peek() && peek()->type != TOKEN_EOF) {
-        // Synchronize by skipping tokens until a statement boundary is found
-        if (peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, ";") == 0) {
-            advance(); // Skip past the semicolon
-            break;
+// Match a keyword by ID
+int match_keyword(ParserState* state, KeywordId keyword) {
+    Token* current = peek(state);
+    if (current && current->type == TOKEN_KEYWORD && current->keyword == keyword) {
+        advance(state);
+        return 1;
+    }
+    return 0;
+}
+
+// Match an operator or punctuator by ID
+int match_punctuator(ParserState* state, PunctuatorId punctuator) {
+    Token* current = peek(state);
+    if (current && current->punctuator == punctuator) {
+        advance(state);
+        return 1;
+    }
+    return 0;
+}
+
+// No tokens left to parse (a lexer source ends with an EOF token, an array may not)
+static int at_end(ParserState* state) {
+    Token* token = peek(state);
+    return !token || token->type == TOKEN_EOF;
+}
+
+// Where error recovery may resume; each construct passes the set that can follow it
+typedef enum {
+    SYNC_SEMICOLON = 1 << 0,   // Consumed: it ends the broken construct
+    SYNC_RBRACE = 1 << 1,      // Left for the enclosing block, struct, enum or switch
+    SYNC_COMMA = 1 << 2,       // Left for the enclosing list
+    SYNC_STATEMENT = 1 << 3,   // A keyword that starts a statement
+    SYNC_CASE = 1 << 4         // 'case' or 'default'
+} SyncPoint;
+
+#define SYNC_STATEMENT_SET (SYNC_SEMICOLON | SYNC_RBRACE | SYNC_STATEMENT)
+#define SYNC_FIELD_SET (SYNC_SEMICOLON | SYNC_RBRACE)
+#define SYNC_ENUMERATOR_SET (SYNC_COMMA | SYNC_RBRACE)
+#define SYNC_CASE_SET (SYNC_CASE | SYNC_RBRACE)
+
+static unsigned sync_point(const Token* token) {
+    switch (token->punctuator) {
+    case PUNCT_SEMICOLON: return SYNC_SEMICOLON;
+    case PUNCT_RBRACE:    return SYNC_RBRACE;
+    case PUNCT_COMMA:     return SYNC_COMMA;
+    default: break;
+    }
+    switch (token->type == TOKEN_KEYWORD ? token->keyword : KEYWORD_NONE) {
+    case KEYWORD_LET: case KEYWORD_FUNC: case KEYWORD_IF: case KEYWORD_FOR: case KEYWORD_PRINT:
+    case KEYWORD_STRUCT: case KEYWORD_ENUM: case KEYWORD_RECORD: case KEYWORD_SWITCH:
+        return SYNC_STATEMENT;
+    case KEYWORD_CASE: case KEYWORD_DEFAULT:
+        return SYNC_CASE;
+    default:
+        return 0;
+    }
+}
+
+// Skip to the next token in `sync`. Bracketed groups are skipped whole, so a
+// ';' or '}' inside a broken block or call does not end recovery early.
+static void synchronize(ParserState* state, unsigned sync) {
+    int nesting = 0;
+    while (!at_end(state)) {
+        Token* token = peek(state);
+        if (nesting == 0 && (sync_point(token) & sync)) {
+            if (token->punctuator == PUNCT_SEMICOLON) advance(state);
+            return;
+        }
+        if (token->punctuator == PUNCT_LBRACE || token->punctuator == PUNCT_LPAREN) {
+            nesting++;
         }
-        advance();
+        else if ((token->punctuator == PUNCT_RBRACE || token->punctuator == PUNCT_RPAREN) && nesting > 0) {
+            nesting--;
+        }
+        advance(state);
     }
 }
 
+// Count a recovered syntax error and record it, covering `start` through the
+// last consumed token, when the parse collects diagnostics (and `start` is known)
+static void record_syntax_error(ParserState* state, const Token* start, const char* message) {
+    state->error_count++;
+    if (!state->diagnostics || !start) return;
+    Token* last = previous_token(state);
+    int end = last && last->offset >= start->offset ? last->offset + last->length : start->offset + start->length;
+    diagnostics_add(state->diagnostics, DIAGNOSTIC_ERROR, start->line, start->column, start->offset, end - start->offset, message);
+}
+
+// Resume after a construct that began at `start` (token position `position`)
+// and failed to parse; its error was already printed. Skips up to `sync` and
+// returns the NODE_ERROR that stands in for the construct. If the construct
+// consumed nothing, the offending token is skipped first so the caller always
+// moves on; a ';' or ',' separator is left for synchronize() or the list.
+static ASTNode* recover(ParserState* state, const Token* start, int position, unsigned sync, const char* message) {
+    if (token_source_position(state->source) == position && !at_end(state) &&
+        !(sync_point(peek(state)) & sync & (SYNC_SEMICOLON | SYNC_COMMA))) {
+        advance(state);
+    }
+    synchronize(state, sync);
+    record_syntax_error(state, start, message);
+    return create_node_in(state->arena, NODE_ERROR, *start);
+}
+
+// Report nesting past `limit` at the current token. Only the first report is
+// printed: the parse is abandoned, and every enclosing construct fails with it.
+static void report_nesting_limit(ParserState* state, int limit) {
+    if (!state->aborted) {
+        Token* token = peek(state);
+        fprintf(stderr, "Error: Nesting exceeds %d levels at line %d, column %d\n",
+            limit, token ? token->line : 0, token ? token->column : 0);
+        state->aborted = 1;
+    }
+}
+
+// Enter a recursive statement or expression parser; 0 (after reporting) if that
+// would nest too deep or the parse has been abandoned
+static int enter_recursion(ParserState* state) {
+    if (state->aborted) return 0;
+    if (state->recursion >= PARSER_MAX_RECURSION) {
+        report_nesting_limit(state, PARSER_MAX_RECURSION);
+        return 0;
+    }
+    state->recursion++;
+    return 1;
+}
+
+// Open a block or parenthesis; 0 (after reporting) past max_depth
+static int enter_nesting(ParserState* state) {
+    if (state->depth >= state->max_depth) {
+        report_nesting_limit(state, state->max_depth);
+        return 0;
+    }
+    state->depth++;
+    return 1;
+}
+
 ASTNode* create_node(NodeType type, Token token) {
+    return create_node_in(NULL, type, token);
+}
+
+// Create a node owned by `arena`, or by the heap when `arena` is NULL. The
+// node's child array comes from the same place.
+ASTNode* create_node_in(Arena* arena, NodeType type, Token token) {
     if (type < 0) {
         fprintf(stderr, "Error: Invalid node type\n");
         return NULL;
     }
 
-    ASTNode* node = check_memory_allocation(safe_malloc(sizeof(ASTNode)), "create_node");
+    // Names point at their canonical interned text, and keywords and punctuators
+    // at their static spelling, so repeated names share storage. Literals, strings
+    // and anything else are copied in right after the node, so they are released
+    // with it (or with its arena) instead of growing the interner forever. Either
+    // way the AST does not keep the source buffer alive (reparse_program() reuses
+    // nodes across edits).
+    int named = token.type == TOKEN_IDENTIFIER || token.type == TOKEN_LITERAL || token.type == TOKEN_STRING;
+    int length = token_length(&token);
+    const char* spelling = NULL;
+    if (token.type == TOKEN_IDENTIFIER) {
+        if (token_symbol(&token) != SYMBOL_NONE) spelling = symbol_text(token.symbol);
+    }
+    else if (token.type == TOKEN_KEYWORD) {
+        spelling = keyword_name(token.keyword);
+    }
+    else if (!named) {
+        spelling = punctuator_name(token.punctuator);
+    }
+    size_t copy = !spelling && (named || token.start) ? (size_t)length + 1 : 0;
+
+    size_t size = sizeof(ASTNode) + copy;
+    ASTNode* node = arena ? arena_alloc(arena, size)
+                          : check_memory_allocation(safe_malloc(size), "create_node");
 
     node->type = type;
     node->token = token;
+    if (copy) {
+        char* text = (char*)(node + 1);
+        memcpy(text, token_text(&token), length);
+        text[length] = '\0';
+        node->token.start = text;
+        node->token.length = length;
+    }
+    else if (spelling && (named || token.start)) {
+        node->token.start = spelling;
+        node->token.length = length;
+    }
+    node->token_first = 0;
+    node->token_count = 0;
     node->children = NULL;
     node->child_count = 0;
+    node->inferred_type = TYPE_UNKNOWN;
+    node->arena = arena;
+    node->child_capacity = 0;
     return node;
 }
 
+// Make room for at least `needed` children: the first few live inside the node,
+// after that the array doubles. Arena arrays cannot be resized in place, so they
+// are copied into a fresh arena allocation instead.
+static void grow_children(ASTNode* parent, int needed) {
+    if (!parent->children && needed <= AST_INLINE_CHILDREN) {
+        parent->children = parent->inline_children;
+        parent->child_capacity = AST_INLINE_CHILDREN;
+        return;
+    }
+
+    int count = parent->child_count;
+    int capacity = count * 2 > AST_INLINE_CHILDREN ? count * 2 : AST_INLINE_CHILDREN + 1;
+    if (capacity < needed) capacity = needed;
+    if (parent->arena) {
+        ASTNode** children = arena_alloc(parent->arena, capacity * sizeof(ASTNode*));
+        memcpy(children, parent->children, count * sizeof(ASTNode*));
+        parent->children = children;
+    }
+    else if (!parent->children || parent->children == parent->inline_children) {
+        ASTNode** children = check_memory_allocation(safe_malloc(capacity * sizeof(ASTNode*)), "add_child");
+        memcpy(children, parent->inline_children, count * sizeof(ASTNode*));
+        parent->children = children;
+    }
+    else {
+        parent->children = check_memory_allocation(safe_realloc(parent->children, capacity * sizeof(ASTNode*)), "add_child");
+    }
+    parent->child_capacity = capacity;
+}
+
 void add_child(ASTNode* parent, ASTNode* child) {
     if (!parent || !child) {
         fprintf(stderr, "Error: NULL parent or child in add_child\n");
         return;
     }
 
-    parent->children = check_memory_allocation(
-        safe_realloc(parent->children, (parent->child_count + 1) * sizeof(ASTNode*)),
-        "add_child"
-    );
+    if (parent->child_count >= parent->child_capacity) {
+        grow_children(parent, parent->child_count + 1);
+    }
     parent->children[parent->child_count++] = child;
 }
 
-void free_ast(ASTNode* node) {
-    if (!node) return;
-    for (int i = 0; i < node->child_count; i++) {
-        free_ast(node->children[i]);
+// Replace children[index, index + remove_count) with `insert`. The removed
+// subtrees are left to the caller; the inserted ones must share the parent's arena.
+void replace_children(ASTNode* parent, int index, int remove_count, ASTNode** insert, int insert_count) {
+    int tail = parent->child_count - index - remove_count;
+    int count = index + insert_count + tail;
+    if (count > parent->child_capacity) {
+        grow_children(parent, count);
+    }
+    if (tail > 0 && remove_count != insert_count) {
+        memmove(parent->children + index + insert_count, parent->children + index + remove_count, tail * sizeof(ASTNode*));
+    }
+    if (insert_count > 0) {
+        memcpy(parent->children + index, insert, insert_count * sizeof(ASTNode*));
+    }
+    parent->child_count = count;
+}
+
+// Double a work stack. Stacks start in a caller's local buffer and move to
+// the heap the first time they outgrow it.
+static void* grow_stack(void* stack, const void* local_buffer, int* capacity, size_t element_size) {
+    void* grown;
+    if (stack == local_buffer) {
+        grown = check_memory_allocation(safe_malloc(*capacity * 2 * element_size), "grow_stack");
+        memcpy(grown, stack, *capacity * element_size);
     }
-    if (node->children) {
-        free(node->children);
+    else {
+        grown = check_memory_allocation(safe_realloc(stack, *capacity * 2 * element_size), "grow_stack");
+    }
+    *capacity *= 2;
+    return grown;
+}
+
+#define AST_WALK_STACK 64  // Pending nodes a tree walk holds before it allocates
+
+// Free a heap-allocated AST. Arena-owned nodes are left alone; they are
+// released all at once by arena_reset() or arena_free() on their arena.
+// Walks with an explicit stack, so any depth of nesting can be freed.
+void free_ast(ASTNode* node) {
+    if (!node || node->arena) return;
+
+    ASTNode* local_stack[AST_WALK_STACK];
+    ASTNode** stack = local_stack;
+    int count = 0, capacity = AST_WALK_STACK;
+    stack[count++] = node;
+    while (count > 0) {
+        node = stack[--count];
+        for (int i = 0; i < node->child_count; i++) {
+            if (!node->children[i]) continue;
+            if (count == capacity) stack = grow_stack(stack, local_stack, &capacity, sizeof(ASTNode*));
+            stack[count++] = node->children[i];
+        }
+        if (node->children && node->children != node->inline_children) {
+            free(node->children);
+        }
+        free(node);
     }
-    free(node);
+    if (stack != local_stack) free(stack);
 }
 
+// Node waiting to be printed, with its indentation
+typedef struct {
+    const ASTNode* node;
+    int depth;
+} PrintVisit;
+
 void print_ast(ASTNode* node, int depth) {
     if (!node) return;
-    // Print indentation
-    for (int i = 0; i < depth; i++) {
-        printf("  ");
-    }
-    // Print node details
-    printf("NodeType: %d, Token: '%s', Line: %d, Column: %d, Children: %d\n",
-        node->type, node->token.value, node->token.line, node->token.column, node->child_count);
-    // Recursively print each child.
-    for (int i = 0; i < node->child_count; i++) {
-        print_ast(node->children[i], depth + 1);
+
+    PrintVisit local_stack[AST_WALK_STACK];
+    PrintVisit* stack = local_stack;
+    int count = 0, capacity = AST_WALK_STACK;
+    stack[count++] = (PrintVisit){ node, depth };
+    while (count > 0) {
+        PrintVisit visit = stack[--count];
+        // Print indentation
+        for (int i = 0; i < visit.depth; i++) {
+            printf("  ");
+        }
+        // Print node details
+        printf("NodeType: %d, Token: '" TOKEN_FMT "', Line: %d, Column: %d, Children: %d\n",
+            visit.node->type, TOKEN_ARG(&visit.node->token), visit.node->token.line, visit.node->token.column, visit.node->child_count);
+        // Children go on the stack last first, so they print in order
+        for (int i = visit.node->child_count - 1; i >= 0; i--) {
+            if (!visit.node->children[i]) continue;
+            if (count == capacity) stack = grow_stack(stack, local_stack, &capacity, sizeof(PrintVisit));
+            stack[count++] = (PrintVisit){ visit.node->children[i], visit.depth + 1 };
+        }
     }
+    if (stack != local_stack) free(stack);
 }
 
 
+// Parse a token array; kept for callers that predate ParserState
 ASTNode* parse_program(Token* input_tokens, int input_token_count) {
-    tokens = input_tokens;
-    token_count = input_token_count;
-    current_token = 0;
+    return parse_program_in(input_tokens, input_token_count, NULL);
+}
+
+// Parse a token array into nodes owned by `arena` (NULL for heap nodes)
+ASTNode* parse_program_in(Token* input_tokens, int input_token_count, Arena* arena) {
+    TokenSource array_source;
+    ParserState state;
+    token_source_init_array(&array_source, input_tokens, input_token_count);
+    parser_state_init(&state, &array_source);
+    state.arena = arena;
+    return parse_with_state(&state);
+}
+
+// Parse source text directly, lexing on demand; the AST's tokens point into `code`
+ASTNode* parse_source(const char* code, int length) {
+    TokenSource lexer_source;
+    token_source_init(&lexer_source, code, length);
+    return parse_token_source(&lexer_source);
+}
+
+ASTNode* parse_token_source(TokenSource* token_source) {
+    ParserState state;
+    parser_state_init(&state, token_source);
+    return parse_with_state(&state);
+}
+
+// Start a parse of everything `source` produces. The state is the parser's only
+// mutable data, so parses with separate states can run on separate threads.
+void parser_state_init(ParserState* state, TokenSource* source) {
+    state->source = source;
+    state->arena = NULL;
+    state->max_depth = PARSER_DEFAULT_MAX_DEPTH;
+    state->depth = 0;
+    state->recursion = 0;
+    state->aborted = 0;
+    state->error_count = 0;
+    state->diagnostics = NULL;
+}
 
-    ASTNode* root = create_node(NODE_PROGRAM, (Token) { TOKEN_EOF, "program", 0, 0 });
-    while (peek() && peek()->type != TOKEN_EOF) {
-        ASTNode* statement = parse_statement();
+ASTNode* parse_with_state(ParserState* state) {
+    ASTNode* root = create_node_in(state->arena, NODE_PROGRAM, (Token){ .type = TOKEN_EOF, .value = "program" });
+    root->token_first = token_source_position(state->source);
+    while (!state->aborted && peek(state) && peek(state)->type != TOKEN_EOF) {
+        ASTNode* statement = parse_statement(state);
         if (statement) {
             add_child(root, statement);
         }
     }
+    root->token_count = token_source_position(state->source) - root->token_first;
     return root;
 }
 
 // ------------------------------------------------------------
 // Updated parse_statement()
 // ------------------------------------------------------------
-ASTNode* parse_statement() {
-    if (!peek()) {
+static ASTNode* dispatch_statement(ParserState* state) {
+    if (!peek(state)) {
         fprintf(stderr, "Error: No more tokens to parse\n");
-        synchronize(); // Recover and continue parsing
         return NULL;
     }
 
-    if (match(TOKEN_KEYWORD, "let")) {
-        return parse_variable_declaration();
-    }
-    else if (match(TOKEN_KEYWORD, "struct")) {
-        return parse_struct();
-    }
-    else if (match(TOKEN_KEYWORD, "enum")) {
-        return parse_enum();
-    }
-    else if (match(TOKEN_KEYWORD, "func")) {
-        return parse_function_definition();
-    }
-    else if (match(TOKEN_KEYWORD, "for")) {
-        return parse_for_statement();
-    }
-    else if (match(TOKEN_KEYWORD, "if")) {
-        return parse_if_statement();
-    }
-    else if (match(TOKEN_KEYWORD, "print")) {
-        return parse_print_statement();
-    }
-    else if (match(TOKEN_KEYWORD, "record")) {
-        return parse_record_definition();
-    }
-    else if (match(TOKEN_KEYWORD, "switch")) {
-        return parse_switch_statement();
-    }
-    else if (match(TOKEN_SYMBOL, "{")) {
-        // Un-consume the token so that parse_block() can expect it.
-        current_token--;
-        return parse_block();
-    }
-    else if (peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, "(") == 0) {
-        return parse_expression();
-    }
-    else {
-        fprintf(stderr, "Error: Unexpected token '%s' at line %d, column %d.\n",
-            peek()->value, peek()->line, peek()->column);
-        synchronize(); // Skip to the next valid point
+    // Dispatch on the keyword or punctuator ID; keywords are consumed first, as
+    // each statement parser expects
+    Token* current = peek(state);
+    switch (current->type == TOKEN_KEYWORD ? current->keyword : KEYWORD_NONE) {
+    case KEYWORD_LET:    advance(state); return parse_variable_declaration(state);
+    case KEYWORD_STRUCT: advance(state); return parse_struct(state);
+    case KEYWORD_ENUM:   advance(state); return parse_enum(state);
+    case KEYWORD_FUNC:   advance(state); return parse_function_definition(state);
+    case KEYWORD_FOR:    advance(state); return parse_for_statement(state);
+    case KEYWORD_IF:     advance(state); return parse_if_statement(state);
+    case KEYWORD_PRINT:  advance(state); return parse_print_statement(state);
+    case KEYWORD_RECORD: advance(state); return parse_record_definition(state);
+    case KEYWORD_SWITCH: advance(state); return parse_switch_statement(state);
+    default: break;
+    }
+
+    switch (current->punctuator) {
+    case PUNCT_LBRACE:
+        return parse_block(state);
+    case PUNCT_LPAREN:
+        return parse_expression(state);
+    default:
+        fprintf(stderr, "Error: Unexpected token '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(current), current->line, current->column);
         return NULL;
     }
 }
 
+// Parse one statement. A statement that fails to parse is skipped up to the
+// next ';', '}' or statement keyword and comes back as a NODE_ERROR, so this
+// returns NULL only when the parse is abandoned. The statement records the
+// tokens it covers, including any skipped ones.
+ASTNode* parse_statement(ParserState* state) {
+    if (!enter_recursion(state)) return NULL;
+    Token start = peek(state) ? *peek(state) : (Token){ .type = TOKEN_EOF, .value = "" };
+    int position = token_source_position(state->source);
+    ASTNode* statement = dispatch_statement(state);
+    if (!statement && !state->aborted) {
+        statement = recover(state, &start, position, SYNC_STATEMENT_SET, "Invalid statement");
+    }
+    if (statement) {
+        statement->token_first = position;
+        statement->token_count = token_source_position(state->source) - position;
+    }
+    state->recursion--;
+    return statement;
+}
+
 // ------------------------------------------------------------
 // Block parsing
 // ------------------------------------------------------------
-static int process_block_statements(ASTNode* block) {
-    while (peek() && strcmp(peek()->value, "}") != 0) {
-        ASTNode* statement = parse_statement();
-        if (statement) {
-            add_child(block, statement);
-        }
-        else {
-            fprintf(stderr, "Error: Invalid statement in block\n");
-            return 0; // Indicate failure
-        }
-    }
-    return 1; // Indicate success
+#define PARSER_LOCAL_STACK 32  // Open blocks or operands a parse holds before it allocates
+
+static ASTNode* create_block(ParserState* state) {
+    return check_memory_allocation(create_node_in(state->arena, NODE_BLOCK, (Token){ .type = TOKEN_SYMBOL, .value = "{" }), "parse_block");
 }
 
-ASTNode* parse_block() {
-    if (!match(TOKEN_SYMBOL, "{")) {
+// Blocks directly inside blocks are opened on an explicit stack instead of by
+// recursion, so any depth of bare nesting costs heap rather than call stack.
+// Each inner block is attached to its parent when it opens. Broken statements
+// become NODE_ERROR children and input that ends early closes every open block;
+// only an abandoned parse frees the outermost block and returns NULL. Every
+// block records the tokens from its '{' through its '}'.
+ASTNode* parse_block(ParserState* state) {
+    int first = token_source_position(state->source);
+    if (!match_punctuator(state, PUNCT_LBRACE)) {
         fprintf(stderr, "Error: Expected '{'\n");
         return NULL;
     }
-
-    ASTNode* block = check_memory_allocation(create_node(NODE_BLOCK, (Token) { TOKEN_SYMBOL, "{", 0, 0 }), "parse_block");
-
-    if (!process_block_statements(block)) {
-        free_ast(block);
-        return NULL;
-    }
-
-    if (!match(TOKEN_SYMBOL, "}")) {
-        fprintf(stderr, "Error: Missing '}' at the end of block\n");
-        free_ast(block);
-        return NULL;
+    if (!enter_nesting(state)) return NULL;
+
+    ASTNode* local_stack[PARSER_LOCAL_STACK];
+    ASTNode** open = local_stack;
+    int count = 0, capacity = PARSER_LOCAL_STACK;
+    ASTNode* block = create_block(state);
+    block->token_first = first;
+    open[count++] = block;
+
+    while (count > 0) {
+        Token* token = peek(state);
+        if (at_end(state)) {
+            fprintf(stderr, "Error: Missing '}' at the end of block\n");
+            record_syntax_error(state, token, "Missing '}' at the end of block");
+            state->depth -= count;
+            while (count > 0) {
+                count--;
+                open[count]->token_count = token_source_position(state->source) - open[count]->token_first;
+            }
+            break;
+        }
+        if (token->punctuator == PUNCT_RBRACE) {
+            advance(state);
+            state->depth--;
+            count--;
+            open[count]->token_count = token_source_position(state->source) - open[count]->token_first;
+        }
+        else if (token->punctuator == PUNCT_LBRACE) {
+            advance(state);
+            if (!enter_nesting(state)) goto fail;
+            ASTNode* inner = create_block(state);
+            inner->token_first = token_source_position(state->source) - 1;
+            add_child(open[count - 1], inner);
+            if (count == capacity) open = grow_stack(open, local_stack, &capacity, sizeof(ASTNode*));
+            open[count++] = inner;
+        }
+        else {
+            ASTNode* statement = parse_statement(state);
+            if (!statement) goto fail;  // Abandoned
+            add_child(open[count - 1], statement);
+        }
     }
 
+    if (open != local_stack) free(open);
     return block;
+
+fail:
+    state->depth -= count;
+    if (open != local_stack) free(open);
+    free_ast(block);
+    return NULL;
 }
 
 // ------------------------------------------------------------
 // Variable Declaration Parsing
 // ------------------------------------------------------------
-static Token* parse_identifier() {
-    if (match(TOKEN_IDENTIFIER, NULL)) {
-        return &tokens[current_token - 1];
+static Token* parse_identifier(ParserState* state) {
+    if (match(state, TOKEN_IDENTIFIER, NULL)) {
+        return previous_token(state);
     }
     fprintf(stderr, "Error: Expected identifier after 'let'\n");
     return NULL;
 }
 
-static ASTNode* parse_initializer(ASTNode* var_decl) {
-    if (match(TOKEN_OPERATOR, "=")) {
-        ASTNode* expression = parse_expression();
+static ASTNode* parse_initializer(ParserState* state, ASTNode* var_decl) {
+    if (match_punctuator(state, PUNCT_ASSIGN)) {
+        ASTNode* expression = parse_expression(state);
         if (expression) {
             add_child(var_decl, expression);
             return var_decl;
@@ -294,39 +637,39 @@ static ASTNode* parse_initializer(ASTNode* var_decl) {
 }
 
 
-static int parse_terminator(ASTNode* var_decl) {
-    if (match(TOKEN_SYMBOL, ";")) {
-        if (current_token < token_count) {
-            Token* next = peek();
-            if (next && next->type == TOKEN_SYMBOL && strcmp(next->value, ";") == 0) {
-                fprintf(stderr, "Error: Unexpected extra semicolon after variable declaration at line %d, column %d\n",
-                    tokens[current_token - 1].line, tokens[current_token - 1].column);
-                return 0;
-            }
+static int parse_terminator(ParserState* state, ASTNode* var_decl) {
+    if (match_punctuator(state, PUNCT_SEMICOLON)) {
+        Token* next = peek(state);
+        if (next && next->punctuator == PUNCT_SEMICOLON) {
+            fprintf(stderr, "Error: Unexpected extra semicolon after variable declaration at line %d, column %d\n",
+                previous_token(state)->line, previous_token(state)->column);
+            return 0;
         }
         return 1;
     }
     fprintf(stderr, "Error: Expected ';' after variable declaration at line %d, column %d\n",
-        tokens[current_token - 1].line, tokens[current_token - 1].column);
+        previous_token(state)->line, previous_token(state)->column);
     return 0;
 }
 
-ASTNode* parse_variable_declaration() {
-    Token* identifier = parse_identifier();
+ASTNode* parse_variable_declaration(ParserState* state) {
+    Token* identifier = parse_identifier(state);
     if (!identifier) return NULL;
 
-    ASTNode* var_decl = create_node(NODE_VARIABLE_DECLARATION, *identifier);
+    ASTNode* var_decl = create_node_in(state->arena, NODE_VARIABLE_DECLARATION, *identifier);
 
     if (debugging_enabled) {
-        inspect_variable(identifier->value, 0); // Default value 0
+        char* name = token_strdup(identifier);
+        inspect_variable(name, 0); // Default value 0
+        free(name);
     }
 
-    if (!parse_initializer(var_decl)) {
+    if (!parse_initializer(state, var_decl)) {
         free_ast(var_decl);
         return NULL;
     }
 
-    if (!parse_terminator(var_decl)) {
+    if (!parse_terminator(state, var_decl)) {
         free_ast(var_decl);
         return NULL;
     }
@@ -338,30 +681,30 @@ ASTNode* parse_variable_declaration() {
 // ------------------------------------------------------------
 // Function Definition Parsing
 // ------------------------------------------------------------
-static Token* parse_function_name() {
-    if (match(TOKEN_IDENTIFIER, NULL)) {
-        return &tokens[current_token - 1];
+static Token* parse_function_name(ParserState* state) {
+    if (match(state, TOKEN_IDENTIFIER, NULL)) {
+        return previous_token(state);
     }
     fprintf(stderr, "Error: Expected function name\n");
     return NULL;
 }
 
-int parse_function_parameters(ASTNode* func_def) {
+int parse_function_parameters(ParserState* state, ASTNode* func_def) {
     // If the next token is ")" then there are no parameters.
-    if (peek() && strcmp(peek()->value, ")") == 0) {
+    if (peek(state) && peek(state)->punctuator == PUNCT_RPAREN) {
         return 1; // Empty parameter list.
     }
-    while (peek() && strcmp(peek()->value, ")") != 0) {
-        if (peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, ",") == 0) {
-            advance(); // Skip comma
+    while (peek(state) && peek(state)->punctuator != PUNCT_RPAREN) {
+        if (peek(state)->punctuator == PUNCT_COMMA) {
+            advance(state); // Skip comma
             continue;
         }
-        if (peek()->type == TOKEN_IDENTIFIER) {
-            ASTNode* param = create_node(NODE_PARAMETER_LIST, *advance());
+        if (peek(state)->type == TOKEN_IDENTIFIER) {
+            ASTNode* param = create_node_in(state->arena, NODE_PARAMETER_LIST, *advance(state));
             add_child(func_def, param);
         }
         else {
-            fprintf(stderr, "Error: Expected parameter name, got '%s'\n", peek()->value);
+            fprintf(stderr, "Error: Expected parameter name, got '" TOKEN_FMT "'\n", TOKEN_ARG(peek(state)));
             return 0; // Error parsing parameters
         }
     }
@@ -369,44 +712,44 @@ int parse_function_parameters(ASTNode* func_def) {
 }
 
 
-static int match_symbol(const char* symbol, const char* error_message) {
-    if (!match(TOKEN_SYMBOL, symbol)) {
+static int match_symbol(ParserState* state, PunctuatorId symbol, const char* error_message) {
+    if (!match_punctuator(state, symbol)) {
         fprintf(stderr, "%s\n", error_message);
         return 0;
     }
     return 1;
 }
 
-ASTNode* parse_function_definition() {
-    Token* identifier = parse_function_name();
+ASTNode* parse_function_definition(ParserState* state) {
+    Token* identifier = parse_function_name(state);
     if (!identifier) return NULL;
 
-    ASTNode* func_def = create_node(NODE_FUNCTION, *identifier);
+    ASTNode* func_def = create_node_in(state->arena, NODE_FUNCTION, *identifier);
 
     if (debugging_enabled) {
         char debug_message[128];
-        snprintf(debug_message, sizeof(debug_message), "Entering function %s", identifier->value);
+        snprintf(debug_message, sizeof(debug_message), "Entering function " TOKEN_FMT, TOKEN_ARG(identifier));
         step_debug(debug_message, identifier->line);
     }
 
-    if (!match(TOKEN_SYMBOL, "(")) {
+    if (!match_punctuator(state, PUNCT_LPAREN)) {
         fprintf(stderr, "Error: Expected '(' after function name\n");
         free_ast(func_def);
         return NULL;
     }
 
-    if (!parse_function_parameters(func_def)) {
+    if (!parse_function_parameters(state, func_def)) {
         free_ast(func_def);
         return NULL;
     }
 
-    if (!match(TOKEN_SYMBOL, ")")) {
+    if (!match_punctuator(state, PUNCT_RPAREN)) {
         fprintf(stderr, "Error: Expected ')' after parameters\n");
         free_ast(func_def);
         return NULL;
     }
 
-    ASTNode* body = parse_block();
+    ASTNode* body = parse_block(state);
     if (!body) {
         fprintf(stderr, "Error: Expected valid block for function body\n");
         free_ast(func_def);
@@ -421,48 +764,48 @@ ASTNode* parse_function_definition() {
 // ------------------------------------------------------------
 // For Statement Parsing
 // ------------------------------------------------------------
-ASTNode* parse_for_initialization() {
+ASTNode* parse_for_initialization(ParserState* state) {
     // Allow an empty initialization if the next token is ';'
-    if (peek() && peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, ";") == 0) {
+    if (peek(state) && peek(state)->punctuator == PUNCT_SEMICOLON) {
         // Optionally, return a node representing an empty expression,
         // or simply return NULL and adjust parse_for_statement() accordingly.
-        return create_node(NODE_EMPTY, *peek());
+        return create_node_in(state->arena, NODE_EMPTY, *peek(state));
     }
 
-    if (peek() && peek()->type == TOKEN_KEYWORD && strcmp(peek()->value, "let") == 0) {
-        return parse_variable_declaration();
+    if (peek(state) && peek(state)->keyword == KEYWORD_LET) {
+        return parse_variable_declaration(state);
     }
-    return parse_expression();
+    return parse_expression(state);
 }
 
 
-static int validate_symbol(const char* symbol, const char* error_message) {
-    if (!match(TOKEN_SYMBOL, symbol)) {
+static int validate_symbol(ParserState* state, PunctuatorId symbol, const char* error_message) {
+    if (!match_punctuator(state, symbol)) {
         fprintf(stderr, "%s\n", error_message);
         return 0;
     }
     return 1;
 }
 
-static ASTNode* parse_required_expression(const char* error_message) {
-    ASTNode* expr = parse_expression();
+static ASTNode* parse_required_expression(ParserState* state, const char* error_message) {
+    ASTNode* expr = parse_expression(state);
     if (!expr) {
         fprintf(stderr, "%s\n", error_message);
     }
     return expr;
 }
 
-ASTNode* parse_for_statement() {
-    Token for_token = tokens[current_token - 1];
-    ASTNode* for_node = create_node(NODE_FOR, for_token);
+ASTNode* parse_for_statement(ParserState* state) {
+    Token for_token = *previous_token(state);
+    ASTNode* for_node = create_node_in(state->arena, NODE_FOR, for_token);
 
-    if (!match(TOKEN_SYMBOL, "(")) {
+    if (!match_punctuator(state, PUNCT_LPAREN)) {
         fprintf(stderr, "Error: Expected '(' after 'for'\n");
         free_ast(for_node);
         return NULL;
     }
 
-    ASTNode* init = parse_for_initialization();
+    ASTNode* init = parse_for_initialization(state);
     if (!init) {
         fprintf(stderr, "Error: Expected initialization in 'for' loop\n");
         free_ast(for_node);
@@ -470,13 +813,13 @@ ASTNode* parse_for_statement() {
     }
     add_child(for_node, init);
 
-    if (!match(TOKEN_SYMBOL, ";")) {
+    if (!match_punctuator(state, PUNCT_SEMICOLON)) {
         fprintf(stderr, "Error: Expected ';' after initialization in 'for' loop\n");
         free_ast(for_node);
         return NULL;
     }
 
-    ASTNode* condition = parse_expression();
+    ASTNode* condition = parse_expression(state);
     if (!condition) {
         fprintf(stderr, "Error: Expected condition in 'for' loop\n");
         free_ast(for_node);
@@ -484,13 +827,13 @@ ASTNode* parse_for_statement() {
     }
     add_child(for_node, condition);
 
-    if (!match(TOKEN_SYMBOL, ";")) {
+    if (!match_punctuator(state, PUNCT_SEMICOLON)) {
         fprintf(stderr, "Error: Expected ';' after condition in 'for' loop\n");
         free_ast(for_node);
         return NULL;
     }
 
-    ASTNode* increment = parse_expression();
+    ASTNode* increment = parse_expression(state);
     if (!increment) {
         fprintf(stderr, "Error: Expected increment in 'for' loop\n");
         free_ast(for_node);
@@ -498,13 +841,13 @@ ASTNode* parse_for_statement() {
     }
     add_child(for_node, increment);
 
-    if (!match(TOKEN_SYMBOL, ")")) {
+    if (!match_punctuator(state, PUNCT_RPAREN)) {
         fprintf(stderr, "Error: Expected ')' after increment in 'for' loop\n");
         free_ast(for_node);
         return NULL;
     }
 
-    ASTNode* body = parse_block();
+    ASTNode* body = parse_block(state);
     if (!body) {
         fprintf(stderr, "Error: Expected block in 'for' loop\n");
         free_ast(for_node);
@@ -527,72 +870,186 @@ ASTNode* parse_for_statement() {
 // ------------------------------------------------------------
 // Expression Parsing (including precedence and factors)
 // ------------------------------------------------------------
+// Binding strength of each binary operator; 0 for punctuators that are not one
+static const unsigned char binary_precedence[PUNCT_COUNT] = {
+    [PUNCT_STAR] = 3, [PUNCT_SLASH] = 3,
+    [PUNCT_PLUS] = 2, [PUNCT_MINUS] = 2,
+    [PUNCT_EQ] = 1, [PUNCT_NE] = 1,
+    [PUNCT_LT] = 1, [PUNCT_LE] = 1, [PUNCT_GT] = 1, [PUNCT_GE] = 1,
+};
+
 int get_precedence(Token* token) {
-    if (!token) return -1;
-    if (token->type == TOKEN_OPERATOR) {
-        if (strcmp(token->value, "*") == 0 || strcmp(token->value, "/") == 0) return 3;
-        if (strcmp(token->value, "+") == 0 || strcmp(token->value, "-") == 0) return 2;
-        if (strcmp(token->value, "==") == 0 || strcmp(token->value, "!=") == 0) return 1;
-        if (strcmp(token->value, "<") == 0 || strcmp(token->value, "<=") == 0 ||
-            strcmp(token->value, ">") == 0 || strcmp(token->value, ">=") == 0) return 1;
+    if (!token || token->type != TOKEN_OPERATOR || !binary_precedence[token->punctuator]) return -1; // Lowest precedence
+    return binary_precedence[token->punctuator];
+}
+
+// Join two operands with a binary operator
+static ASTNode* create_binary(ParserState* state, Token op_token, ASTNode* lhs, ASTNode* rhs) {
+    ASTNode* binary_op = create_node_in(state->arena, NODE_EXPRESSION, op_token);
+    binary_op->inferred_type = TYPE_INT; // Default type
+
+    switch (op_token.punctuator) {
+    case PUNCT_PLUS: case PUNCT_MINUS: case PUNCT_STAR: case PUNCT_SLASH:
+        if (lhs->inferred_type == TYPE_FLOAT || rhs->inferred_type == TYPE_FLOAT) {
+            binary_op->inferred_type = TYPE_FLOAT;
+        }
+        break;
+    case PUNCT_AND_AND: case PUNCT_OR_OR:
+        binary_op->inferred_type = TYPE_BOOL;
+        break;
+    default:
+        break;
     }
-    return -1; // Lowest precedence
+
+    add_child(binary_op, lhs);
+    add_child(binary_op, rhs);
+    return binary_op;
 }
 
-ASTNode* parse_expression_with_precedence(int min_precedence) {
-    ASTNode* lhs = parse_factor();
-    if (!lhs) return NULL;
+// What a finished operand becomes
+typedef enum {
+    OPERAND_RESULT,       // The whole expression
+    OPERAND_GROUP,        // The inside of parentheses, the enclosing operand's factor
+    OPERAND_RIGHT         // The right-hand side of `op` on the enclosing operand
+} OperandRole;
+
+// Operand being parsed: one level of precedence climbing
+typedef struct {
+    ASTNode* lhs;         // Expression so far; NULL until its first factor is parsed
+    int min_precedence;   // Operators binding more loosely than this end the operand
+    OperandRole role;
+    Token op;             // OPERAND_RIGHT: copied, as the operand may run past the token window
+} PendingOperand;
+
+// Precedence climbing with the pending operands on an explicit stack instead
+// of the call stack, so parentheses can nest to any depth (up to max_depth).
+// A failure unwinds the stack with the same diagnostics the recursive form gave.
+ASTNode* parse_expression_with_precedence(ParserState* state, int min_precedence) {
+    if (!enter_recursion(state)) return NULL;
+
+    PendingOperand local_stack[PARSER_LOCAL_STACK];
+    PendingOperand* stack = local_stack;
+    int count = 0, capacity = PARSER_LOCAL_STACK;
+    stack[count++] = (PendingOperand){ .lhs = NULL, .min_precedence = min_precedence, .role = OPERAND_RESULT };
+    ASTNode* result = NULL;
+
+    for (;;) {
+        PendingOperand* top = &stack[count - 1];
+        Token* token = peek(state);
+        if (!top->lhs) {  // Expecting a factor
+            if (token && token->punctuator == PUNCT_LPAREN) {
+                advance(state);
+                if (!enter_nesting(state)) goto fail;
+                if (count == capacity) stack = grow_stack(stack, local_stack, &capacity, sizeof(PendingOperand));
+                stack[count++] = (PendingOperand){ .lhs = NULL, .min_precedence = 0, .role = OPERAND_GROUP };
+                continue;
+            }
+            top->lhs = parse_factor(state);
+            if (!top->lhs) goto fail;
+            continue;
+        }
 
-    while (peek() && get_precedence(peek()) >= min_precedence) {
-        Token* op_token = advance();
-        ASTNode* rhs = parse_expression_with_precedence(get_precedence(op_token) + 1);
-        if (!rhs) {
-            fprintf(stderr, "Error: Invalid right-hand side in expression\n");
-            free_ast(lhs);
-            return NULL;
+        int precedence = get_precedence(token);
+        if (token && precedence >= top->min_precedence) {
+            Token op_token = *advance(state);
+            if (count == capacity) stack = grow_stack(stack, local_stack, &capacity, sizeof(PendingOperand));
+            stack[count++] = (PendingOperand){ NULL, precedence + 1, OPERAND_RIGHT, op_token };
+            continue;
         }
-        ASTNode* binary_op = create_node(NODE_EXPRESSION, *op_token);
-        binary_op->inferred_type = TYPE_INT; // Default type
 
-        if (strcmp(op_token->value, "+") == 0 || strcmp(op_token->value, "-") == 0) {
-            if (lhs->inferred_type == TYPE_FLOAT || rhs->inferred_type == TYPE_FLOAT) {
-                binary_op->inferred_type = TYPE_FLOAT;
+        // The top operand is complete
+        PendingOperand done = stack[--count];
+        if (done.role == OPERAND_RESULT) {
+            result = done.lhs;
+            break;
+        }
+        PendingOperand* parent = &stack[count - 1];
+        if (done.role == OPERAND_GROUP) {
+            state->depth--;
+            if (!match_punctuator(state, PUNCT_RPAREN)) {
+                fprintf(stderr, "Error: Missing ')' in grouped expression\n");
+                free_ast(done.lhs);
+                goto fail;
             }
+            parent->lhs = done.lhs;
         }
-        else if (strcmp(op_token->value, "&&") == 0 || strcmp(op_token->value, "||") == 0) {
-            binary_op->inferred_type = TYPE_BOOL;
+        else {
+            parent->lhs = create_binary(state, done.op, parent->lhs, done.lhs);
         }
+    }
+
+    if (stack != local_stack) free(stack);
+    state->recursion--;
+    return result;
 
-        add_child(binary_op, lhs);
-        add_child(binary_op, rhs);
-        lhs = binary_op;
+fail:
+    while (count > 0) {
+        PendingOperand failed = stack[--count];
+        free_ast(failed.lhs);
+        if (failed.role == OPERAND_GROUP) {
+            state->depth--;
+            if (!state->aborted) fprintf(stderr, "Error: Invalid expression after '('\n");
+        }
+        else if (failed.role == OPERAND_RIGHT && !state->aborted) {
+            fprintf(stderr, "Error: Invalid right-hand side in expression\n");
+        }
     }
-    return lhs;
+    if (stack != local_stack) free(stack);
+    state->recursion--;
+    return NULL;
 }
 
-ASTNode* parse_expression() {
-    return parse_expression_with_precedence(0);
+ASTNode* parse_expression(ParserState* state) {
+    return parse_expression_with_precedence(state, 0);
 }
 
-ASTNode* parse_term() {
-    return parse_factor();
+ASTNode* parse_term(ParserState* state) {
+    return parse_factor(state);
 }
 
-static void parse_embedded_expressions(ASTNode* node) {
-    const char* str = node->token.value;
-    char buffer[128];
-    int i = 0, j = 0;
+// Parse each "${...}" span of a string straight from the string text; any
+// length works because the span is lexed in place rather than copied
+static void parse_embedded_expressions(ParserState* state, ASTNode* node) {
+    const char* str = token_text(&node->token);
+    int length = token_length(&node->token);
+    int i = 0;
 
-    while (str[i] != '\0') {
-        if (str[i] == '$' && str[i + 1] == '{') {
+    while (i < length) {
+        if (str[i] == '$' && i + 1 < length && str[i + 1] == '{') {
             i += 2; // Skip "${"
-            while (str[i] != '}' && str[i] != '\0') {
-                buffer[j++] = str[i++];
+            int start = i;
+            while (i < length && str[i] != '}') i++;
+
+            // The span is lexed in recovering mode: an unterminated string or
+            // comment in it becomes a TOKEN_ERROR instead of ending the process
+            DiagnosticList diagnostics;
+            TokenSource embedded;
+            ParserState embedded_state;
+            diagnostics_init(&diagnostics);
+            token_source_init(&embedded, str + start, i - start);
+            embedded.lexer.diagnostics = &diagnostics;
+            parser_state_init(&embedded_state, &embedded);
+            embedded_state.arena = node->arena;
+            embedded_state.max_depth = state->max_depth;
+            embedded_state.depth = state->depth;
+            embedded_state.recursion = state->recursion;
+            Token* first = token_source_peek(&embedded, 0);
+            ASTNode* expr = NULL;
+            if (first && first->type != TOKEN_ERROR && first->type != TOKEN_EOF) {
+                expr = parse_expression_with_precedence(&embedded_state, 0);
+            }
+            if (embedded_state.aborted) state->aborted = 1;
+            state->error_count += embedded_state.error_count;
+
+            if (expr) add_child(node, expr);
+            if (!state->aborted && (!expr || diagnostics.error_count > 0)) {
+                fprintf(stderr, "Error: Malformed expression in string interpolation at line %d, column %d\n",
+                    node->token.line, node->token.column);
+                add_child(node, create_node_in(node->arena, NODE_ERROR, node->token));
+                record_syntax_error(state, &node->token, "Malformed expression in string interpolation");
             }
-            buffer[j] = '\0'; // Null-terminate
-            if (str[i] == '}') i++;
-            ASTNode* expr = parse_expression_with_precedence(0);
-            add_child(node, expr);
+            diagnostics_free(&diagnostics);
+            if (i < length && str[i] == '}') i++;
         }
         else {
             i++;
@@ -600,14 +1057,14 @@ static void parse_embedded_expressions(ASTNode* node) {
     }
 }
 
-static ASTNode* parse_grouped_expression() {
-    advance(); // Consume '('
-    ASTNode* expr = parse_expression();
+static ASTNode* parse_grouped_expression(ParserState* state) {
+    advance(state); // Consume '('
+    ASTNode* expr = parse_expression(state);
     if (!expr) {
         fprintf(stderr, "Error: Invalid expression after '('\n");
         return NULL;
     }
-    if (!match(TOKEN_SYMBOL, ")")) {
+    if (!match_punctuator(state, PUNCT_RPAREN)) {
         fprintf(stderr, "Error: Missing ')' in grouped expression\n");
         free_ast(expr);
         return NULL;
@@ -615,65 +1072,284 @@ static ASTNode* parse_grouped_expression() {
     return expr;
 }
 
-static ASTNode* parse_string_literal(Token* token) {
-    if (strstr(token->value, "${")) { // String interpolation
-        ASTNode* node = create_node(NODE_STRING_INTERPOLATION, *token);
-        parse_embedded_expressions(node);
-        advance();
+// Check whether a string token contains an interpolation ("${")
+static int has_interpolation(const Token* token) {
+    const char* text = token_text(token);
+    int length = token_length(token);
+    for (int i = 0; i + 1 < length; i++) {
+        if (text[i] == '$' && text[i + 1] == '{') return 1;
+    }
+    return 0;
+}
+
+static ASTNode* parse_string_literal(ParserState* state, Token* token) {
+    if (has_interpolation(token)) { // String interpolation
+        ASTNode* node = create_node_in(state->arena, NODE_STRING_INTERPOLATION, *token);
+        parse_embedded_expressions(state, node);
+        advance(state);
         return node;
     }
-    advance();
-    return create_node(NODE_LITERAL, *token);
+    advance(state);
+    return create_node_in(state->arena, NODE_LITERAL, *token);
 }
 
-static ASTNode* parse_literal_or_identifier(Token* token) {
-    advance();
-    return create_node(NODE_FACTOR, *token);
+static ASTNode* parse_literal_or_identifier(ParserState* state, Token* token) {
+    advance(state);
+    ASTNode* node = create_node_in(state->arena, NODE_FACTOR, *token);
+    // Number literals are typed from the value the lexer computed, never from their text
+    if (token->number.kind == NUMBER_INT || token->number.kind == NUMBER_OVERFLOW) node->inferred_type = TYPE_INT;
+    else if (token->number.kind == NUMBER_FLOAT) node->inferred_type = TYPE_FLOAT;
+    return node;
 }
 
-ASTNode* parse_factor() {
-    Token* token = peek();
+// long long arithmetic that reports overflow instead of wrapping
+static int checked_arithmetic(char op, long long a, long long b, long long* result) {
+    switch (op) {
+    case '+':
+        if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b)) return 0;
+        *result = a + b;
+        return 1;
+    case '-':
+        if ((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b)) return 0;
+        *result = a - b;
+        return 1;
+    case '*':
+        if (a > 0 ? (b > 0 ? a > LLONG_MAX / b : b < LLONG_MIN / a)
+                  : (b > 0 ? a < LLONG_MIN / b : (a != 0 && b < LLONG_MAX / a))) return 0;
+        *result = a * b;
+        return 1;
+    default:  // '/'
+        if (a == LLONG_MIN && b == -1) return 0;
+        *result = a / b;
+        return 1;
+    }
+}
+
+// Combine two folded operands; 0 on division by zero
+static int fold_operator(char op, NumberValue lhs, NumberValue rhs, NumberValue* value) {
+    if (lhs.kind == NUMBER_OVERFLOW || rhs.kind == NUMBER_OVERFLOW) {  // Overflow is sticky
+        value->kind = NUMBER_OVERFLOW;
+        value->integer = LLONG_MAX;
+        return 1;
+    }
+    if (lhs.kind == NUMBER_INT && rhs.kind == NUMBER_INT) {
+        if (op == '/' && rhs.integer == 0) return 0;
+        value->kind = NUMBER_INT;
+        if (!checked_arithmetic(op, lhs.integer, rhs.integer, &value->integer)) {
+            value->kind = NUMBER_OVERFLOW;
+            value->integer = LLONG_MAX;
+        }
+        return 1;
+    }
+
+    double a = lhs.kind == NUMBER_INT ? (double)lhs.integer : lhs.real;
+    double b = rhs.kind == NUMBER_INT ? (double)rhs.integer : rhs.real;
+    if (op == '/' && b == 0.0) return 0;
+    value->kind = NUMBER_FLOAT;
+    value->real = op == '+' ? a + b : op == '-' ? a - b : op == '*' ? a * b : a / b;
+    return 1;
+}
+
+// Node waiting to be folded: first its operands are scheduled, then (once
+// `ready`) it combines the two values they left on the value stack
+typedef struct {
+    const ASTNode* node;
+    int ready;
+} FoldVisit;
+
+// Fold a numeric expression over literal values; returns 0 if the subtree is not
+// a constant (identifiers, calls, non-arithmetic operators, division by zero).
+// Walks with explicit stacks, so any depth of nesting can be folded.
+int evaluate_constant(const ASTNode* node, NumberValue* value) {
+    if (!node) return 0;
+
+    FoldVisit local_stack[AST_WALK_STACK];
+    NumberValue local_values[AST_WALK_STACK];
+    FoldVisit* stack = local_stack;
+    NumberValue* values = local_values;
+    int count = 0, capacity = AST_WALK_STACK;
+    int value_count = 0, value_capacity = AST_WALK_STACK;
+    int constant = 1;
+    stack[count++] = (FoldVisit){ .node = node, .ready = 0 };
+    while (count > 0 && constant) {
+        FoldVisit visit = stack[--count];
+        node = visit.node;
+        if (visit.ready) {
+            NumberValue rhs = values[--value_count];
+            NumberValue lhs = values[--value_count];
+            constant = fold_operator(token_text(&node->token)[0], lhs, rhs, &values[value_count++]);
+        }
+        else if (node && node->type == NODE_FACTOR && node->token.type == TOKEN_LITERAL) {
+            NumberValue number = node->token.number;
+            constant = number.kind == NUMBER_INT || number.kind == NUMBER_FLOAT || number.kind == NUMBER_OVERFLOW;
+            if (value_count == value_capacity) values = grow_stack(values, local_values, &value_capacity, sizeof(NumberValue));
+            values[value_count++] = number;
+        }
+        else if (node && node->type == NODE_EXPRESSION && node->child_count == 2 && node->token.type == TOKEN_OPERATOR &&
+                 token_length(&node->token) == 1 && strchr("+-*/", token_text(&node->token)[0])) {
+            // The left operand goes on top, so its value is pushed first
+            while (count + 3 > capacity) stack = grow_stack(stack, local_stack, &capacity, sizeof(FoldVisit));
+            stack[count++] = (FoldVisit){ .node = node, .ready = 1 };
+            stack[count++] = (FoldVisit){ .node = node->children[1], .ready = 0 };
+            stack[count++] = (FoldVisit){ .node = node->children[0], .ready = 0 };
+        }
+        else {
+            constant = 0;
+        }
+    }
+    if (constant) *value = values[0];
+
+    if (stack != local_stack) free(stack);
+    if (values != local_values) free(values);
+    return constant;
+}
+
+// Node types whose token names something the program declares
+static int declares_name(const ASTNode* node) {
+    switch (node->type) {
+    case NODE_VARIABLE_DECLARATION:
+    case NODE_PARAMETER_LIST:
+    case NODE_FUNCTION:
+    case NODE_STRUCT:
+    case NODE_ENUM:
+    case NODE_ENUMERATOR:
+        return node->token.type == TOKEN_IDENTIFIER;
+    default:
+        return 0;
+    }
+}
+
+// Call `visit` on every node of the subtree in source order. Walks with an
+// explicit stack, so the name passes handle any depth of nesting.
+static void visit_preorder(const ASTNode* root, void (*visit)(const ASTNode* node, void* context), void* context) {
+    if (!root) return;
+
+    const ASTNode* local_stack[AST_WALK_STACK];
+    const ASTNode** stack = local_stack;
+    int count = 0, capacity = AST_WALK_STACK;
+    stack[count++] = root;
+    while (count > 0) {
+        const ASTNode* node = stack[--count];
+        visit(node, context);
+        // Children go on the stack last first, so they are visited in order
+        for (int i = node->child_count - 1; i >= 0; i--) {
+            if (!node->children[i]) continue;
+            if (count == capacity) stack = grow_stack(stack, local_stack, &capacity, sizeof(ASTNode*));
+            stack[count++] = node->children[i];
+        }
+    }
+    if (stack != local_stack) free(stack);
+}
+
+static void index_declared_name(const ASTNode* node, void* index) {
+    if (declares_name(node)) {
+        suggestion_index_add(index, node->token.start, node->token.length);
+    }
+}
+
+// Add every name declared in the subtree to `index`. The names are the
+// canonical interned spellings, so they stay valid after the AST is freed
+// (except a name the interner had no room for, whose text lives in its node).
+void index_declared_names(const ASTNode* node, SuggestionIndex* index) {
+    visit_preorder(node, index_declared_name, index);
+}
+
+static void mark_declared_name(const ASTNode* node, void* declared) {
+    if (declares_name(node) && node->token.symbol != SYMBOL_NONE) {
+        ((unsigned char*)declared)[node->token.symbol] = 1;
+    }
+}
+
+// What warn_undefined_name() checks against, and how many warnings it gave
+typedef struct {
+    const unsigned char* declared;
+    const SuggestionIndex* index;
+    int undefined;
+} UndefinedNames;
+
+static void warn_undefined_name(const ASTNode* node, void* context) {
+    UndefinedNames* names = context;
+    if (node->type == NODE_FACTOR && node->token.type == TOKEN_IDENTIFIER &&
+        node->token.symbol != SYMBOL_NONE && !names->declared[node->token.symbol]) {
+        // Allow one edit per three characters, at least one and at most three
+        int max_distance = node->token.length / 3;
+        if (max_distance < 1) max_distance = 1;
+        if (max_distance > 3) max_distance = 3;
+        const char* match = suggestion_index_closest(names->index, node->token.start, node->token.length, max_distance, NULL);
+
+        char message[256];
+        if (match) {
+            snprintf(message, sizeof(message), "Undefined name '" TOKEN_FMT "'. Did you mean '%s'?", TOKEN_ARG(&node->token), match);
+        }
+        else {
+            snprintf(message, sizeof(message), "Undefined name '" TOKEN_FMT "'", TOKEN_ARG(&node->token));
+        }
+        report_warning(node->token.line, node->token.column, message);
+        names->undefined++;
+    }
+}
+
+// Warn about every identifier used but declared nowhere in the program, suggesting
+// the closest declared name. Declarations are program-wide (no scoping), so a name
+// may be used before or outside the block that declares it. Returns the number of warnings.
+int report_undefined_names(const ASTNode* program) {
+    unsigned char* declared = check_memory_allocation(calloc(symbol_count() + 1, 1), "report_undefined_names");
+    SuggestionIndex index;
+    suggestion_index_init(&index);
+    visit_preorder(program, mark_declared_name, declared);
+    index_declared_names(program, &index);
+
+    UndefinedNames names = { .declared = declared, .index = &index, .undefined = 0 };
+    visit_preorder(program, warn_undefined_name, &names);
+
+    suggestion_index_free(&index);
+    free(declared);
+    return names.undefined;
+}
+
+ASTNode* parse_factor(ParserState* state) {
+    Token* token = peek(state);
     if (!token) {
         fprintf(stderr, "Error: Unexpected end of input in factor\n");
         return NULL;
     }
 
     // Allow a record definition to be parsed as an expression.
-    if (token->type == TOKEN_KEYWORD && strcmp(token->value, "record") == 0) {
-        return parse_record_definition();
+    if (token->keyword == KEYWORD_RECORD) {
+        return parse_record_definition(state);
     }
 
-    if (token->type == TOKEN_SYMBOL && strcmp(token->value, "(") == 0) {
-        return parse_grouped_expression();
+    if (token->punctuator == PUNCT_LPAREN) {
+        return parse_grouped_expression(state);
     }
 
     if (token->type == TOKEN_STRING) {
-        return parse_string_literal(token);
+        return parse_string_literal(state, token);
     }
 
     if (token->type == TOKEN_LITERAL || token->type == TOKEN_IDENTIFIER) {
-        return parse_literal_or_identifier(token);
+        return parse_literal_or_identifier(state, token);
     }
 
-    fprintf(stderr, "Error: Unexpected token '%s' in factor\n", token->value);
-    advance();
+    fprintf(stderr, "Error: Unexpected token '" TOKEN_FMT "' in factor\n", TOKEN_ARG(token));
+    advance(state);
     return NULL;
 }
 
 // ------------------------------------------------------------
 // If Statement Parsing
 // ------------------------------------------------------------
-static ASTNode* parse_if_condition() {
-    if (!match(TOKEN_SYMBOL, "(")) {
+static ASTNode* parse_if_condition(ParserState* state) {
+    if (!match_punctuator(state, PUNCT_LPAREN)) {
         fprintf(stderr, "Error: Expected '(' after 'if'\n");
         return NULL;
     }
-    ASTNode* condition = parse_expression();
+    ASTNode* condition = parse_expression(state);
     if (!condition) {
         fprintf(stderr, "Error: Invalid condition in 'if' statement\n");
         return NULL;
     }
-    if (!match(TOKEN_SYMBOL, ")")) {
+    if (!match_punctuator(state, PUNCT_RPAREN)) {
         fprintf(stderr, "Error: Expected ')' after condition in 'if' statement\n");
         free_ast(condition);
         return NULL;
@@ -681,36 +1357,36 @@ static ASTNode* parse_if_condition() {
     return condition;
 }
 
-static ASTNode* parse_if_block(const char* block_name) {
-    ASTNode* block = parse_block();
+static ASTNode* parse_if_block(ParserState* state, const char* block_name) {
+    ASTNode* block = parse_block(state);
     if (!block) {
         fprintf(stderr, "Error: Invalid %s block in 'if' statement\n", block_name);
     }
     return block;
 }
 
-ASTNode* parse_if_statement() {
+ASTNode* parse_if_statement(ParserState* state) {
     ASTNode* if_node = check_memory_allocation(
-        create_node(NODE_IF, (Token) { TOKEN_KEYWORD, "if", 0, 0 }),
+        create_node_in(state->arena, NODE_IF, (Token){ .type = TOKEN_KEYWORD, .value = "if" }),
         "parse_if_statement"
     );
 
-    ASTNode* condition = parse_if_condition();
+    ASTNode* condition = parse_if_condition(state);
     if (!condition) {
         free_ast(if_node);
         return NULL;
     }
     add_child(if_node, condition);
 
-    ASTNode* if_block = parse_if_block("if");
+    ASTNode* if_block = parse_if_block(state, "if");
     if (!if_block) {
         free_ast(if_node);
         return NULL;
     }
     add_child(if_node, if_block);
 
-    if (match(TOKEN_KEYWORD, "else")) {
-        ASTNode* else_block = parse_if_block("else");
+    if (match_keyword(state, KEYWORD_ELSE)) {
+        ASTNode* else_block = parse_if_block(state, "else");
         if (!else_block) {
             free_ast(if_node);
             return NULL;
@@ -724,46 +1400,46 @@ ASTNode* parse_if_statement() {
 // ------------------------------------------------------------
 // Print Statement Parsing
 // ------------------------------------------------------------
-static int expect_symbol(const char* symbol, const char* error_message) {
-    if (!match(TOKEN_SYMBOL, symbol)) {
+static int expect_symbol(ParserState* state, PunctuatorId symbol, const char* error_message) {
+    if (!match_punctuator(state, symbol)) {
         fprintf(stderr, "%s\n", error_message);
         return 0;
     }
     return 1;
 }
 
-static ASTNode* parse_print_expression() {
-    ASTNode* expression = parse_expression();
+static ASTNode* parse_print_expression(ParserState* state) {
+    ASTNode* expression = parse_expression(state);
     if (!expression) {
         fprintf(stderr, "Error: Invalid expression in 'print' statement\n");
     }
     return expression;
 }
 
-ASTNode* parse_print_statement() {
+ASTNode* parse_print_statement(ParserState* state) {
     ASTNode* print_node = check_memory_allocation(
-        create_node(NODE_PRINT_STATEMENT, tokens[current_token - 1]),
+        create_node_in(state->arena, NODE_PRINT_STATEMENT, *previous_token(state)),
         "parse_print_statement"
     );
 
-    if (!expect_symbol("(", "Error: Expected '(' after 'print'")) {
+    if (!expect_symbol(state, PUNCT_LPAREN, "Error: Expected '(' after 'print'")) {
         free_ast(print_node);
         return NULL;
     }
 
-    ASTNode* expression = parse_print_expression();
+    ASTNode* expression = parse_print_expression(state);
     if (!expression) {
         free_ast(print_node);
         return NULL;
     }
     add_child(print_node, expression);
 
-    if (!expect_symbol(")", "Error: Expected ')' after 'print' expression")) {
+    if (!expect_symbol(state, PUNCT_RPAREN, "Error: Expected ')' after 'print' expression")) {
         free_ast(print_node);
         return NULL;
     }
 
-    if (!expect_symbol(";", "Error: Expected ';' after 'print' statement")) {
+    if (!expect_symbol(state, PUNCT_SEMICOLON, "Error: Expected ';' after 'print' statement")) {
         free_ast(print_node);
         return NULL;
     }
@@ -775,8 +1451,8 @@ ASTNode* parse_print_statement() {
 // Record Definition Parsing
 // (Assumes the 'record' keyword has already been matched.)
 // ------------------------------------------------------------
-static Token* parse_record_name(Token* record_token) {
-    Token* name_token = advance();
+static Token* parse_record_name(ParserState* state, Token* record_token) {
+    Token* name_token = advance(state);
     if (!name_token || name_token->type != TOKEN_IDENTIFIER) {
         fprintf(stderr, "Error: Expected record name after 'record' at line %d, column %d.\n",
             record_token->line, record_token->column);
@@ -785,87 +1461,104 @@ static Token* parse_record_name(Token* record_token) {
     return name_token;
 }
 
-static int validate_opening_brace(const Token* name_token) {
-    if (!match(TOKEN_SYMBOL, "{")) {
-        fprintf(stderr, "Error: Expected '{' after record name '%s' at line %d, column %d.\n",
-            name_token->value, name_token->line, name_token->column);
+static int validate_opening_brace(ParserState* state, const Token* name_token) {
+    if (!match_punctuator(state, PUNCT_LBRACE)) {
+        fprintf(stderr, "Error: Expected '{' after record name '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(name_token), name_token->line, name_token->column);
         return 0;
     }
     return 1;
 }
 
-static ASTNode* parse_record_field(const Token* name_token, const Token* record_token) {
+static ASTNode* parse_record_field(ParserState* state, const Token* name_token, const Token* record_token) {
     // Get the field name
-    Token* field_name = advance();
-    if (!field_name || field_name->type != TOKEN_IDENTIFIER) {
-        fprintf(stderr, "Error: Expected field name in record '%s' at line %d, column %d.\n",
-            name_token->value, record_token->line, record_token->column);
+    Token* next = peek(state);
+    if (!next || next->type != TOKEN_IDENTIFIER) {
+        fprintf(stderr, "Error: Expected field name in record '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(name_token), record_token->line, record_token->column);
         return NULL;
     }
+    Token field_token = *advance(state);  // Copied: the value expression may run past the token window
+    const Token* field_name = &field_token;
 
     // Expect an '=' after the field name
-    if (!match(TOKEN_OPERATOR, "=")) {
-        fprintf(stderr, "Error: Expected '=' after field name '%s' in record '%s' at line %d, column %d.\n",
-            field_name->value, name_token->value, field_name->line, field_name->column);
+    if (!match_punctuator(state, PUNCT_ASSIGN)) {
+        fprintf(stderr, "Error: Expected '=' after field name '" TOKEN_FMT "' in record '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(field_name), TOKEN_ARG(name_token), field_name->line, field_name->column);
         return NULL;
     }
 
     // Instead of simply advancing a token, parse an expression.
-    ASTNode* field_value = parse_expression();
+    ASTNode* field_value = parse_expression(state);
     if (!field_value) {
-        fprintf(stderr, "Error: Expected value for field '%s' in record '%s' at line %d, column %d.\n",
-            field_name->value, name_token->value, field_name->line, field_name->column);
+        fprintf(stderr, "Error: Expected value for field '" TOKEN_FMT "' in record '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(field_name), TOKEN_ARG(name_token), field_name->line, field_name->column);
         return NULL;
     }
 
     // Create a node (using the same type as variable declarations) and add the value as a child.
-    ASTNode* field_node = create_node(NODE_VARIABLE_DECLARATION, *field_name);
+    ASTNode* field_node = create_node_in(state->arena, NODE_VARIABLE_DECLARATION, *field_name);
     add_child(field_node, field_value);
     return field_node;
 }
 
-static int parse_record_fields(ASTNode* record_node, const Token* name_token, const Token* record_token) {
-    while (!match(TOKEN_SYMBOL, "}")) {
-        if (!peek()) {
-            fprintf(stderr, "Error: Unterminated record definition for '%s' starting at line %d, column %d.\n",
-                name_token->value, record_token->line, record_token->column);
-            return 0;
+// A broken field is skipped to its ';' (or the '}') and kept as a NODE_ERROR;
+// returns 0 only when the parse is abandoned
+static int parse_record_fields(ParserState* state, ASTNode* record_node, const Token* name_token, const Token* record_token) {
+    while (!match_punctuator(state, PUNCT_RBRACE)) {
+        if (state->aborted) return 0;
+        if (at_end(state)) {
+            fprintf(stderr, "Error: Unterminated record definition for '" TOKEN_FMT "' starting at line %d, column %d.\n",
+                TOKEN_ARG(name_token), record_token->line, record_token->column);
+            record_syntax_error(state, peek(state), "Unterminated record definition");
+            return 1;
         }
 
-        ASTNode* field_node = parse_record_field(name_token, record_token);
+        Token field_start = *peek(state);
+        int position = token_source_position(state->source);
+        ASTNode* field_node = parse_record_field(state, name_token, record_token);
         if (!field_node) {
-            return 0;
+            if (state->aborted) return 0;
+            add_child(record_node, recover(state, &field_start, position, SYNC_FIELD_SET, "Invalid record field"));
+            continue;
         }
         add_child(record_node, field_node);
 
         // Consume the semicolon after a field declaration.
-        if (!match(TOKEN_SYMBOL, ";")) {
-            fprintf(stderr, "Error: Expected ';' after field '%s' in record '%s' at line %d, column %d.\n",
-                field_node->token.value, name_token->value, field_node->token.line, field_node->token.column);
-            return 0;
+        if (!match_punctuator(state, PUNCT_SEMICOLON)) {
+            fprintf(stderr, "Error: Expected ';' after field '" TOKEN_FMT "' in record '" TOKEN_FMT "' at line %d, column %d.\n",
+                TOKEN_ARG(&field_node->token), TOKEN_ARG(name_token), field_node->token.line, field_node->token.column);
+            add_child(record_node, recover(state, &field_start, position, SYNC_FIELD_SET, "Expected ';' after record field"));
         }
     }
     return 1;
 }
 
 
-ASTNode* parse_record_definition() {
-    // 'record' keyword was already matched.
-    Token* record_token = &tokens[current_token - 1];
+ASTNode* parse_record_definition(ParserState* state) {
+    // 'record' keyword was already matched. Both tokens are copied because the
+    // fields may run past the token window.
+    Token record_keyword = *previous_token(state);
+    const Token* record_token = &record_keyword;
 
-    Token* name_token = parse_record_name(record_token);
-    if (!name_token) return NULL;
+    Token* name = parse_record_name(state, &record_keyword);
+    if (!name) return NULL;
+    Token record_name = *name;
+    const Token* name_token = &record_name;
 
-    if (!validate_opening_brace(name_token)) return NULL;
+    if (!validate_opening_brace(state, name_token)) return NULL;
 
-    ASTNode* record_node = check_memory_allocation(create_node(NODE_STRUCT, *name_token), "parse_record_definition");
+    ASTNode* record_node = check_memory_allocation(create_node_in(state->arena, NODE_STRUCT, *name_token), "parse_record_definition");
 
-    if (!parse_record_fields(record_node, name_token, record_token)) {
+    int errors = state->error_count;
+    if (!parse_record_fields(state, record_node, name_token, record_token)) {
         free_ast(record_node);
         return NULL;
     }
 
-    printf("Record '%s' successfully parsed with %d fields.\n", name_token->value, record_node->child_count);
+    if (state->error_count == errors) {
+        printf("Record '" TOKEN_FMT "' successfully parsed with %d fields.\n", TOKEN_ARG(name_token), record_node->child_count);
+    }
     return record_node;
 }
 
@@ -873,77 +1566,85 @@ ASTNode* parse_record_definition() {
 // Switch Statement Parsing
 // (Assumes the 'switch' keyword has already been matched.)
 // ------------------------------------------------------------
-ASTNode* parse_switch_statement() {
-    ASTNode* switch_node = create_node(NODE_SWITCH, (Token) { TOKEN_KEYWORD, "switch", 0, 0 });
-    if (!match(TOKEN_SYMBOL, "(")) {
+// The header must be complete; inside the body a broken case is skipped to the
+// next 'case', 'default' or '}' and kept as a NODE_ERROR.
+ASTNode* parse_switch_statement(ParserState* state) {
+    ASTNode* switch_node = create_node_in(state->arena, NODE_SWITCH, (Token){ .type = TOKEN_KEYWORD, .value = "switch" });
+    if (!match_punctuator(state, PUNCT_LPAREN)) {
         fprintf(stderr, "Error: Expected '(' after 'switch'.\n");
-        synchronize();
+        free_ast(switch_node);
         return NULL;
     }
 
-    ASTNode* condition = parse_expression();
+    ASTNode* condition = parse_expression(state);
     if (!condition) {
         fprintf(stderr, "Error: Invalid expression in 'switch'.\n");
-        synchronize();
+        free_ast(switch_node);
         return NULL;
     }
     add_child(switch_node, condition);
 
-    if (!match(TOKEN_SYMBOL, ")")) {
+    if (!match_punctuator(state, PUNCT_RPAREN)) {
         fprintf(stderr, "Error: Expected ')' after 'switch' condition.\n");
-        synchronize();
+        free_ast(switch_node);
         return NULL;
     }
 
-    if (!match(TOKEN_SYMBOL, "{")) {
+    if (!match_punctuator(state, PUNCT_LBRACE)) {
         fprintf(stderr, "Error: Expected '{' to begin 'switch' body.\n");
-        synchronize();
+        free_ast(switch_node);
         return NULL;
     }
 
     // Use peek() for lookahead instead of match() in the loop condition.
-    while (peek() && !(peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, "}") == 0)) {
-        ASTNode* case_node = parse_case_statement();
+    while (!state->aborted && !at_end(state) && !(peek(state)->punctuator == PUNCT_RBRACE)) {
+        Token start = *peek(state);
+        int position = token_source_position(state->source);
+        ASTNode* case_node = parse_case_statement(state);
+        if (!case_node && !state->aborted) {
+            fprintf(stderr, "Warning: Skipping invalid case in 'switch'.\n");
+            case_node = recover(state, &start, position, SYNC_CASE_SET, "Invalid case in 'switch'");
+        }
         if (case_node) {
             add_child(switch_node, case_node);
         }
-        else {
-            fprintf(stderr, "Warning: Skipping invalid case in 'switch'.\n");
-            advance();
-        }
+    }
+    if (state->aborted) {
+        free_ast(switch_node);
+        return NULL;
     }
 
-    if (!match(TOKEN_SYMBOL, "}")) {
+    if (!match_punctuator(state, PUNCT_RBRACE)) {
         fprintf(stderr, "Error: Expected '}' after switch cases.\n");
-        synchronize();
-        return NULL;
+        record_syntax_error(state, peek(state), "Expected '}' after switch cases");
     }
 
     return switch_node;
 }
 
-ASTNode* parse_case_statement() {
+ASTNode* parse_case_statement(ParserState* state) {
     // Check for 'case'
-    if (peek() && peek()->type == TOKEN_KEYWORD && strcmp(peek()->value, "case") == 0) {
-        advance(); // consume 'case'
-        ASTNode* case_node = create_node(NODE_CASE, (Token) { TOKEN_KEYWORD, "case", 0, 0 });
-        ASTNode* case_value = parse_expression();
+    if (peek(state) && peek(state)->keyword == KEYWORD_CASE) {
+        advance(state); // consume 'case'
+        ASTNode* case_node = create_node_in(state->arena, NODE_CASE, (Token){ .type = TOKEN_KEYWORD, .value = "case" });
+        ASTNode* case_value = parse_expression(state);
         if (!case_value) {
             fprintf(stderr, "Error: Missing or invalid case value.\n");
+            free_ast(case_node);
             return NULL;
         }
         add_child(case_node, case_value);
 
-        if (!match(TOKEN_COLON, ":")) {
+        if (!match(state, TOKEN_COLON, ":")) {
             fprintf(stderr, "Error: Expected ':' after 'case' value.\n");
+            free_ast(case_node);
             return NULL;
         }
 
         // Loop until the next 'case', 'default', or closing '}' is encountered.
-        while (peek() && !((peek()->type == TOKEN_KEYWORD &&
-            (strcmp(peek()->value, "case") == 0 || strcmp(peek()->value, "default") == 0)) ||
-            (peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, "}") == 0))) {
-            ASTNode* statement = parse_statement();
+        while (!at_end(state) && !((peek(state)->keyword == KEYWORD_CASE || peek(state)->keyword == KEYWORD_DEFAULT) ||
+            (peek(state)->punctuator == PUNCT_RBRACE))) {
+            ASTNode* statement = parse_statement(state);
             if (statement) {
                 add_child(case_node, statement);
             }
@@ -953,24 +1654,23 @@ ASTNode* parse_case_statement() {
         }
         return case_node;
     }
-    else if (peek() && peek()->type == TOKEN_KEYWORD && strcmp(peek()->value, "default") == 0) {
-        return parse_default_case();
+    else if (peek(state) && peek(state)->keyword == KEYWORD_DEFAULT) {
+        return parse_default_case(state);
     }
     return NULL;
 }
 
-ASTNode* parse_default_case() {
-    if (match(TOKEN_KEYWORD, "default")) {
-        if (!match(TOKEN_COLON, ":")) {
+ASTNode* parse_default_case(ParserState* state) {
+    if (match_keyword(state, KEYWORD_DEFAULT)) {
+        if (!match(state, TOKEN_COLON, ":")) {
             fprintf(stderr, "Error: Expected ':' after 'default'.\n");
             return NULL;
         }
-        ASTNode* default_node = create_node(NODE_DEFAULT, (Token) { TOKEN_KEYWORD, "default", 0, 0 });
+        ASTNode* default_node = create_node_in(state->arena, NODE_DEFAULT, (Token){ .type = TOKEN_KEYWORD, .value = "default" });
 
-        while (peek() && !((peek()->type == TOKEN_KEYWORD &&
-            (strcmp(peek()->value, "case") == 0 || strcmp(peek()->value, "default") == 0)) ||
-            (peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, "}") == 0))) {
-            ASTNode* statement = parse_statement();
+        while (!at_end(state) && !((peek(state)->keyword == KEYWORD_CASE || peek(state)->keyword == KEYWORD_DEFAULT) ||
+            (peek(state)->punctuator == PUNCT_RBRACE))) {
+            ASTNode* statement = parse_statement(state);
             if (statement) {
                 add_child(default_node, statement);
             }
@@ -987,68 +1687,81 @@ ASTNode* parse_default_case() {
 // (Handles 'struct' keyword definitions, e.g.,
 //    struct Person { int id; string name; }
 // ------------------------------------------------------------
-ASTNode* parse_struct() {
+ASTNode* parse_struct(ParserState* state) {
     // The "struct" keyword was already matched.
-    Token* struct_token = &tokens[current_token - 1];
+    Token struct_token = *previous_token(state);
 
-    // Expect a struct name (identifier)
-    Token* name_token = advance();
-    if (!name_token || name_token->type != TOKEN_IDENTIFIER) {
+    // Expect a struct name (identifier); copied because the fields may run past the token window
+    Token* name = advance(state);
+    if (!name || name->type != TOKEN_IDENTIFIER) {
         fprintf(stderr, "Error: Expected struct name after 'struct' at line %d, column %d.\n",
-            struct_token->line, struct_token->column);
+            struct_token.line, struct_token.column);
         return NULL;
     }
+    Token struct_name = *name;
+    const Token* name_token = &struct_name;
 
     // Expect an opening brace '{'
-    if (!match(TOKEN_SYMBOL, "{")) {
-        fprintf(stderr, "Error: Expected '{' after struct name '%s' at line %d, column %d.\n",
-            name_token->value, name_token->line, name_token->column);
+    if (!match_punctuator(state, PUNCT_LBRACE)) {
+        fprintf(stderr, "Error: Expected '{' after struct name '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(name_token), name_token->line, name_token->column);
         return NULL;
     }
 
     // Create the struct node (using NODE_STRUCT)
-    ASTNode* struct_node = create_node(NODE_STRUCT, *name_token);
+    ASTNode* struct_node = create_node_in(state->arena, NODE_STRUCT, *name_token);
+    int errors = state->error_count;
 
     // Parse fields until a closing brace is encountered.
     // Here we assume each field is defined as: <type> <identifier> ';'
-    while (peek() && !(peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, "}") == 0)) {
+    // A broken field is skipped to its ';' (or the '}') and kept as a NODE_ERROR.
+    while (!at_end(state) && !(peek(state)->punctuator == PUNCT_RBRACE)) {
+        Token field_start = *peek(state);
+        int position = token_source_position(state->source);
         // Parse the field type.
-        Token* field_type = advance();
-        if (!field_type || field_type->type != TOKEN_IDENTIFIER) {
-            fprintf(stderr, "Error: Expected field type in struct '%s' at line %d, column %d.\n",
-                name_token->value, field_type ? field_type->line : 0, field_type ? field_type->column : 0);
-            return NULL;
+        Token* field_type = peek(state);
+        if (field_type->type != TOKEN_IDENTIFIER) {
+            fprintf(stderr, "Error: Expected field type in struct '" TOKEN_FMT "' at line %d, column %d.\n",
+                TOKEN_ARG(name_token), field_type->line, field_type->column);
+            add_child(struct_node, recover(state, &field_start, position, SYNC_FIELD_SET, "Invalid struct field"));
+            continue;
         }
+        advance(state);
         // Parse the field name.
-        Token* field_name = advance();
+        Token* field_name = peek(state);
         if (!field_name || field_name->type != TOKEN_IDENTIFIER) {
-            fprintf(stderr, "Error: Expected field name in struct '%s' at line %d, column %d.\n",
-                name_token->value, field_name ? field_name->line : 0, field_name ? field_name->column : 0);
-            return NULL;
+            fprintf(stderr, "Error: Expected field name in struct '" TOKEN_FMT "' at line %d, column %d.\n",
+                TOKEN_ARG(name_token), field_name ? field_name->line : 0, field_name ? field_name->column : 0);
+            add_child(struct_node, recover(state, &field_start, position, SYNC_FIELD_SET, "Invalid struct field"));
+            continue;
         }
+        advance(state);
         // Create a field node. (We reuse NODE_VARIABLE_DECLARATION here.)
-        ASTNode* field_node = create_node(NODE_VARIABLE_DECLARATION, *field_name);
+        ASTNode* field_node = create_node_in(state->arena, NODE_VARIABLE_DECLARATION, *field_name);
         // Store the fields type (using your resolve_type function)
-        field_node->inferred_type = resolve_type(field_type->value);
+        field_node->inferred_type = resolve_type_token(field_type);
         add_child(struct_node, field_node);
         // Expect a semicolon to terminate the field declaration.
-        if (!match(TOKEN_SYMBOL, ";")) {
-            fprintf(stderr, "Error: Expected ';' after field definition '%s' in struct '%s' at line %d, column %d.\n",
-                field_name->value, name_token->value, field_name->line, field_name->column);
-            return NULL;
+        if (!match_punctuator(state, PUNCT_SEMICOLON)) {
+            fprintf(stderr, "Error: Expected ';' after field definition '" TOKEN_FMT "' in struct '" TOKEN_FMT "' at line %d, column %d.\n",
+                TOKEN_ARG(&field_node->token), TOKEN_ARG(name_token), field_node->token.line, field_node->token.column);
+            add_child(struct_node, recover(state, &field_start, position, SYNC_FIELD_SET, "Expected ';' after struct field"));
         }
     }
 
-    // Expect the closing brace '}'
-    if (!match(TOKEN_SYMBOL, "}")) {
-        fprintf(stderr, "Error: Expected '}' at the end of struct '%s'.\n", name_token->value);
-        return NULL;
+    // Expect the closing brace '}'; without one the fields parsed so far are kept
+    if (!match_punctuator(state, PUNCT_RBRACE)) {
+        fprintf(stderr, "Error: Expected '}' at the end of struct '" TOKEN_FMT "'.\n", TOKEN_ARG(name_token));
+        record_syntax_error(state, peek(state), "Expected '}' at the end of struct");
+        return struct_node;
     }
     // Optionally, consume a trailing semicolon.
-    if (peek() && peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, ";") == 0) {
-        advance();
+    if (peek(state) && peek(state)->punctuator == PUNCT_SEMICOLON) {
+        advance(state);
+    }
+    if (state->error_count == errors) {
+        printf("Struct '" TOKEN_FMT "' successfully parsed with %d fields.\n", TOKEN_ARG(name_token), struct_node->child_count);
     }
-    printf("Struct '%s' successfully parsed with %d fields.\n", name_token->value, struct_node->child_count);
     return struct_node;
 }
 
@@ -1057,65 +1770,90 @@ ASTNode* parse_struct() {
 // (Handles 'enum' keyword definitions, e.g.,
 //    enum Color { Red, Green, Blue }
 // ------------------------------------------------------------
-ASTNode* parse_enum() {
+// One enumerator with its optional initializer; NULL (after reporting) if it is broken
+static ASTNode* parse_enumerator(ParserState* state, const Token* name_token) {
+    // Expect an enumerator identifier.
+    Token* next = peek(state);
+    if (next->type != TOKEN_IDENTIFIER) {
+        fprintf(stderr, "Error: Expected enumerator in enum '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(name_token), next->line, next->column);
+        return NULL;
+    }
+    Token enumerator_token = *advance(state);  // Copied: the initializer may run past the token window
+    const Token* enumerator = &enumerator_token;
+    // Create an enumerator node (we use NODE_ENUMERATOR).
+    ASTNode* enumerator_node = create_node_in(state->arena, NODE_ENUMERATOR, *enumerator);
+    // Optionally, support an initializer (e.g., "= <expression>")
+    if (match_punctuator(state, PUNCT_ASSIGN)) {
+        ASTNode* value_expr = parse_expression(state);
+        if (!value_expr) {
+            fprintf(stderr, "Error: Expected value expression for enumerator '" TOKEN_FMT "' in enum '" TOKEN_FMT "'\n",
+                TOKEN_ARG(enumerator), TOKEN_ARG(name_token));
+            free_ast(enumerator_node);
+            return NULL;
+        }
+        add_child(enumerator_node, value_expr);
+    }
+    return enumerator_node;
+}
+
+ASTNode* parse_enum(ParserState* state) {
     // The "enum" keyword was already matched.
-    Token* enum_token = &tokens[current_token - 1];
+    Token enum_token = *previous_token(state);
 
-    // Expect an enum name (identifier)
-    Token* name_token = advance();
-    if (!name_token || name_token->type != TOKEN_IDENTIFIER) {
+    // Expect an enum name (identifier); copied because the enumerators may run past the token window
+    Token* name = advance(state);
+    if (!name || name->type != TOKEN_IDENTIFIER) {
         fprintf(stderr, "Error: Expected enum name after 'enum' at line %d, column %d.\n",
-            enum_token->line, enum_token->column);
+            enum_token.line, enum_token.column);
         return NULL;
     }
+    Token enum_name = *name;
+    const Token* name_token = &enum_name;
 
     // Expect an opening brace '{'
-    if (!match(TOKEN_SYMBOL, "{")) {
-        fprintf(stderr, "Error: Expected '{' after enum name '%s' at line %d, column %d.\n",
-            name_token->value, name_token->line, name_token->column);
+    if (!match_punctuator(state, PUNCT_LBRACE)) {
+        fprintf(stderr, "Error: Expected '{' after enum name '" TOKEN_FMT "' at line %d, column %d.\n",
+            TOKEN_ARG(name_token), name_token->line, name_token->column);
         return NULL;
     }
 
     // Create the enum node (using NODE_ENUM)
-    ASTNode* enum_node = create_node(NODE_ENUM, *name_token);
+    ASTNode* enum_node = create_node_in(state->arena, NODE_ENUM, *name_token);
+    int errors = state->error_count;
 
     // Parse enumerators until a closing brace '}' is encountered.
-    while (peek() && !(peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, "}") == 0)) {
-        // Expect an enumerator identifier.
-        Token* enumerator = advance();
-        if (!enumerator || enumerator->type != TOKEN_IDENTIFIER) {
-            fprintf(stderr, "Error: Expected enumerator in enum '%s' at line %d, column %d.\n",
-                name_token->value, enumerator ? enumerator->line : 0, enumerator ? enumerator->column : 0);
-            return NULL;
-        }
-        // Create an enumerator node (we use NODE_ENUMERATOR).
-        ASTNode* enumerator_node = create_node(NODE_ENUMERATOR, *enumerator);
-        // Optionally, support an initializer (e.g., "= <expression>")
-        if (match(TOKEN_OPERATOR, "=")) {
-            ASTNode* value_expr = parse_expression();
-            if (!value_expr) {
-                fprintf(stderr, "Error: Expected value expression for enumerator '%s' in enum '%s'\n",
-                    enumerator->value, name_token->value);
+    // A broken enumerator is skipped to the next ',' (or the '}') and kept as a NODE_ERROR.
+    while (!at_end(state) && !(peek(state)->punctuator == PUNCT_RBRACE)) {
+        Token enumerator_start = *peek(state);
+        int position = token_source_position(state->source);
+        ASTNode* enumerator_node = parse_enumerator(state, name_token);
+        if (!enumerator_node) {
+            if (state->aborted) {
+                free_ast(enum_node);
                 return NULL;
             }
-            add_child(enumerator_node, value_expr);
+            enumerator_node = recover(state, &enumerator_start, position, SYNC_ENUMERATOR_SET, "Invalid enumerator");
         }
         add_child(enum_node, enumerator_node);
         // If a comma separates enumerators, consume it.
-        if (peek() && peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, ",") == 0) {
-            advance();
+        if (peek(state) && peek(state)->punctuator == PUNCT_COMMA) {
+            advance(state);
         }
     }
 
-    // Expect the closing brace '}'
-    if (!match(TOKEN_SYMBOL, "}")) {
-        fprintf(stderr, "Error: Expected '}' at the end of enum '%s'\n", name_token->value);
-        return NULL;
+    // Expect the closing brace '}'; without one the enumerators parsed so far are kept
+    if (!match_punctuator(state, PUNCT_RBRACE)) {
+        fprintf(stderr, "Error: Expected '}' at the end of enum '" TOKEN_FMT "'\n", TOKEN_ARG(name_token));
+        record_syntax_error(state, peek(state), "Expected '}' at the end of enum");
+        return enum_node;
     }
     // Optionally, consume a trailing semicolon.
-    if (peek() && peek()->type == TOKEN_SYMBOL && strcmp(peek()->value, ";") == 0) {
-        advance();
+    if (peek(state) && peek(state)->punctuator == PUNCT_SEMICOLON) {
+        advance(state);
+    }
+    if (state->error_count == errors) {
+        printf("Enum '" TOKEN_FMT "' successfully parsed with %d enumerators.\n", TOKEN_ARG(name_token), enum_node->child_count);
     }
-    printf("Enum '%s' successfully parsed with %d enumerators.\n", name_token->value, enum_node->child_count);
     return enum_node;
 }
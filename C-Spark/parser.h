@@ -2,12 +2,27 @@
 #define PARSER_H
 
 #include "lexer.h"
+#include "token_source.h"
+#include "suggestions.h"
 
-// Define the ParserState structure
+#define PARSER_DEFAULT_MAX_DEPTH 4000000 // Nesting accepted by default (ParserState.max_depth)
+#define PARSER_MAX_RECURSION 256          // Nested statements and expressions parsed by recursion
+
+// Parser context; every parse function takes one, so independent parses never share state.
+// Blocks and parentheses nest on heap stacks, so only max_depth limits them; other
+// nested constructs recurse and stop at PARSER_MAX_RECURSION.
+// Syntax errors do not stop a parse: the broken statement, field, enumerator or
+// case becomes a NODE_ERROR and parsing resumes after it. Only a nesting limit
+// abandons the parse.
 typedef struct {
-    Token* tokens;    // Array of tokens
-    int current;      // Current token index
-    int token_count;  // Total number of tokens
+    TokenSource* source;  // Tokens being parsed
+    Arena* arena;         // Owner of every node the parse creates; NULL allocates nodes on the heap
+    int max_depth;        // Deepest nesting of blocks and parentheses accepted
+    int depth;            // Blocks and parentheses currently open
+    int recursion;        // Statement and expression parsers currently active
+    int aborted;          // Set when a nesting limit is hit; the parse stops there
+    int error_count;      // Syntax errors recovered from so far
+    DiagnosticList* diagnostics; // When set, each recovered error is also recorded here
 } ParserState;
 
 typedef enum {
@@ -65,38 +80,59 @@ typedef enum {
     NODE_ENUMERATOR,              // Enumerators
     NODE_STRING_INTERPOLATION,    // String interpolation constructs
     NODE_RETURN,                  // Return statement
-    NODE_EMPTY                    // Empty node type
+    NODE_EMPTY,                   // Empty node type
+    NODE_ERROR                    // Stands in for a construct that failed to parse; already reported
 } NodeType;
 
+#define AST_INLINE_CHILDREN 3     // Children stored inside the node itself before an array is allocated
+
 // AST Node Structure
 typedef struct ASTNode {
     NodeType type;                // Type of the AST node
     Token token;                  // Associated token for the node
-    struct ASTNode** children;    // Dynamically allocated array of child nodes
+    struct ASTNode** children;    // Child nodes: inline_children for small nodes, else a separate array (NULL when childless)
     int child_count;              // Number of child nodes
     DataType inferred_type; // Add inferred type
+    Arena* arena;           // Arena owning this node and its child array; NULL for heap nodes
+    int child_capacity;     // Slots available in `children`
+    int token_first;        // Position of the node's first token in the parse that built it
+    int token_count;        // Tokens a statement, block or program was parsed from; 0 for other nodes
+    struct ASTNode* inline_children[AST_INLINE_CHILDREN];
 
 } ASTNode;
 
 // Parser function declarations
 ASTNode* parse_program(Token* tokens, int token_count);
-ASTNode* parse_statement();
-ASTNode* parse_block();
-ASTNode* parse_variable_declaration();
-ASTNode* parse_function_definition();
-ASTNode* parse_for_statement();
-ASTNode* parse_expression();
-ASTNode* parse_term();
-ASTNode* parse_factor();
-ASTNode* parse_if_statement();       // Parse if statements
-ASTNode* parse_print_statement();    // Parse print statements
+ASTNode* parse_program_in(Token* tokens, int token_count, Arena* arena); // Allocate every node in `arena`; free with arena_reset/arena_free, not free_ast
+ASTNode* parse_source(const char* code, int length);    // Lex on demand through a bounded token window
+ASTNode* parse_token_source(TokenSource* source);       // Parse everything a token source produces
+void parser_state_init(ParserState* state, TokenSource* source); // Start a parse of `source` with the default limits
+ASTNode* parse_with_state(ParserState* state);          // Parse a whole program through an initialized state
+ASTNode* parse_statement(ParserState* state);
+ASTNode* parse_block(ParserState* state);
+ASTNode* parse_variable_declaration(ParserState* state);
+ASTNode* parse_function_definition(ParserState* state);
+ASTNode* parse_for_statement(ParserState* state);
+ASTNode* parse_expression(ParserState* state);
+int get_precedence(Token* token);                      // Binary operator precedence, -1 for any other token
+ASTNode* parse_term(ParserState* state);
+ASTNode* parse_factor(ParserState* state);
+ASTNode* parse_if_statement(ParserState* state);       // Parse if statements
+ASTNode* parse_print_statement(ParserState* state);    // Parse print statements
 
 // Memory management and debugging functions
-void free_ast(ASTNode* node);        // Free the memory allocated for an AST
+int evaluate_constant(const ASTNode* node, NumberValue* value); // Fold a constant numeric expression; 0 if not constant
+void index_declared_names(const ASTNode* node, SuggestionIndex* index); // Add the names a subtree declares to a suggestion index
+int report_undefined_names(const ASTNode* program); // Warn about undeclared names with "did you mean" hints; returns the count
+ASTNode* create_node(NodeType type, Token token);  // Heap node
+ASTNode* create_node_in(Arena* arena, NodeType type, Token token); // Node owned by `arena` (heap when NULL)
+void add_child(ASTNode* parent, ASTNode* child);   // Append a child; the child must share the parent's arena
+void replace_children(ASTNode* parent, int index, int remove_count, ASTNode** insert, int insert_count); // Splice children; the removed subtrees are not freed
+void free_ast(ASTNode* node);        // Free the memory allocated for an AST (no-op for arena nodes)
 void print_ast(ASTNode* node, int depth); // Print the AST (for debugging)
-ASTNode* parse_record_definition(); // Parse record definitions
-ASTNode* parse_switch_statement();
-ASTNode* parse_case_statement();
-ASTNode* parse_default_case();
-int parse_function_parameters(ASTNode* func_def);
+ASTNode* parse_record_definition(ParserState* state); // Parse record definitions
+ASTNode* parse_switch_statement(ParserState* state);
+ASTNode* parse_case_statement(ParserState* state);
+ASTNode* parse_default_case(ParserState* state);
+int parse_function_parameters(ParserState* state, ASTNode* func_def);
 #endif // PARSER_H
@@ -0,0 +1,217 @@
+// parser_incremental.c
+#include "parser_incremental.h"
+#include "utils.h"
+#include <stdlib.h>
+
+#define REPARSE_INITIAL_LEVELS 32  // Nested statement lists the path has room for before it grows
+
+// Where the re-lexed tokens are. Positions before `first` are the same before
+// and after the edit; those from `old_end` on moved by `delta`.
+typedef struct {
+    Token* tokens;
+    int token_count;
+    int first;          // First re-lexed token
+    int old_end;        // End of the re-lexed tokens before the edit
+    int new_end;        // End of the re-lexed tokens after it
+    int delta;          // new_end - old_end
+} ReparseEdit;
+
+// A statement list on the path from the program down to the edit. Positions
+// are those before the edit; all of them precede the re-lexed tokens, except `end`.
+typedef struct {
+    ASTNode* list;      // NODE_PROGRAM or NODE_BLOCK
+    ASTNode* owner;     // Statement of the enclosing list the block belongs to (NULL for the program)
+    int start;          // Position of the list's first statement
+    int end;            // Position past its last statement: the block's '}', or the end of the program
+    int depth;          // Blocks open around the statements, as in ParserState
+    int recursion;      // Statement parsers active around them, as in ParserState
+} ReparseLevel;
+
+// The statement before the re-lexed tokens may have peeked at the first of them
+static int lookahead_start(const ReparseEdit* edit) {
+    return edit->first > 0 ? edit->first - 1 : 0;
+}
+
+// The block of `statement` (which starts at `position`) whose statements hold
+// every re-lexed token, or NULL. Its braces must not have been re-lexed, since
+// they decide where the block's statements start and end.
+static ASTNode* enclosing_block(ASTNode* statement, int position, const ReparseEdit* edit, int* block_position) {
+    int candidates = statement->type == NODE_BLOCK ? 1 : statement->child_count;
+    for (int i = 0; i < candidates; i++) {
+        ASTNode* block = statement->type == NODE_BLOCK ? statement : statement->children[i];
+        if (block->type != NODE_BLOCK || block->token_count == 0) continue;
+        int start = position + block->token_first - statement->token_first;
+        if (start < edit->first && edit->old_end < start + block->token_count) {
+            *block_position = start;
+            return block;
+        }
+    }
+    return NULL;
+}
+
+// Follow the statements that hold the re-lexed tokens down through their
+// blocks. Returns the number of levels on the path, innermost last; a block
+// that ran to the end of the input without its '}' ends the path above it.
+static int find_enclosing_levels(ReparseLevel** levels, int* capacity, const ReparseEdit* edit) {
+    int count = 1, lookahead = lookahead_start(edit);
+    for (;;) {
+        ReparseLevel* level = &(*levels)[count - 1];
+        int is_program = level->list->type == NODE_PROGRAM;
+        ASTNode* holder = NULL;
+        int position = level->start, holder_position = 0;
+        for (int i = 0; i < level->list->child_count; i++) {
+            ASTNode* child = level->list->children[i];
+            if (position <= lookahead && edit->old_end <= position + child->token_count) {
+                holder = child;
+                holder_position = position;
+            }
+            position += child->token_count;
+            if (is_program && position > lookahead) break;  // Only a block has to be checked for its '}'
+        }
+        if (!is_program && position != level->end) return count - 1;  // Unclosed: its statements ran to the end
+        if (!holder) return count;
+
+        int block_position = 0;
+        ASTNode* block = enclosing_block(holder, holder_position, edit, &block_position);
+        if (!block) return count;
+
+        if (count == *capacity) {
+            *capacity *= 2;
+            *levels = safe_realloc(*levels, *capacity * sizeof(ReparseLevel));
+            level = &(*levels)[count - 1];
+        }
+        // An inner block of a block opens without a statement parser; any other block is inside one
+        int recursion = holder == block && level->list->type == NODE_BLOCK ? 0 : 1;
+        (*levels)[count++] = (ReparseLevel){ block, holder, block_position + 1, block_position + block->token_count - 1,
+            level->depth + 1, level->recursion + recursion };
+    }
+}
+
+// Parse the statements of `level` again, from the first one that ends past the
+// lookahead token until the parse lands where an old statement after the edit
+// starts, or on the end of the list. The new statements then replace the old
+// ones in between. Returns 0, leaving the list untouched, if the parse runs
+// past the list, closes it early or is abandoned.
+static int reparse_level(const ReparseLevel* level, const ReparseEdit* edit, Arena* arena) {
+    ASTNode* list = level->list;
+    int is_program = list->type == NODE_PROGRAM;
+    int first_child = 0, run_start = level->start, lookahead = lookahead_start(edit);
+    while (first_child < list->child_count && run_start + list->children[first_child]->token_count <= lookahead) {
+        run_start += list->children[first_child++]->token_count;
+    }
+
+    TokenSource source;
+    ParserState state;
+    token_source_init_array(&source, edit->tokens + run_start, edit->token_count - run_start);
+    parser_state_init(&state, &source);
+    state.arena = arena;
+    state.depth = level->depth;
+    state.recursion = level->recursion;
+
+    ASTNode** parsed = NULL;
+    int parsed_count = 0, parsed_capacity = 0;
+    int kept = -1, next_child = first_child, next_start = run_start, list_end = level->end + edit->delta;
+    for (;;) {
+        int position = run_start + token_source_position(&source);
+        if (position >= edit->new_end) {
+            while (next_child < list->child_count && (next_start < edit->old_end || next_start + edit->delta < position)) {
+                next_start += list->children[next_child++]->token_count;
+            }
+            if (next_child < list->child_count && next_start + edit->delta == position) {
+                kept = next_child;
+                break;
+            }
+            if (!is_program && position == list_end) {
+                kept = list->child_count;
+                break;
+            }
+        }
+
+        // The same choices parse_with_state() and parse_block() make for the next statement
+        Token* token = token_source_peek(&source, 0);
+        if (!token || token->type == TOKEN_EOF) {
+            if (is_program) kept = list->child_count;
+            break;
+        }
+        ASTNode* statement;
+        if (is_program) {
+            statement = parse_statement(&state);
+        }
+        else if (position >= list_end || token->punctuator == PUNCT_RBRACE) {
+            break;
+        }
+        else {
+            statement = token->punctuator == PUNCT_LBRACE ? parse_block(&state) : parse_statement(&state);
+        }
+        if (!statement) break;
+
+        if (parsed_count == parsed_capacity) {
+            parsed_capacity = parsed_capacity ? parsed_capacity * 2 : 8;
+            parsed = safe_realloc(parsed, parsed_capacity * sizeof(ASTNode*));
+        }
+        parsed[parsed_count++] = statement;
+    }
+
+    if (kept < 0) {
+        for (int i = 0; i < parsed_count; i++) {
+            free_ast(parsed[i]);
+        }
+        free(parsed);
+        return 0;
+    }
+    for (int i = first_child; i < kept; i++) {
+        free_ast(list->children[i]);
+    }
+    replace_children(list, first_child, kept - first_child, parsed, parsed_count);
+    free(parsed);
+    return 1;
+}
+
+// Every list and statement around the reparsed one grew by `delta` tokens, and
+// blocks that follow the edited one inside the same statement moved by as much
+static void resize_enclosing(ReparseLevel* levels, int count, int delta) {
+    for (int i = 0; i < count; i++) {
+        ASTNode* list = levels[i].list;
+        ASTNode* owner = levels[i].owner;
+        list->token_count += delta;
+        if (!owner || owner == list) continue;
+        owner->token_count += delta;
+        for (int c = 0; c < owner->child_count; c++) {
+            ASTNode* sibling = owner->children[c];
+            if (sibling->type == NODE_BLOCK && sibling->token_first > list->token_first) {
+                sibling->token_first += delta;
+            }
+        }
+    }
+}
+
+// Statement lists are tried innermost first; each failure widens the reparse
+// to the list around it
+ASTNode* reparse_program(ASTNode* program, Token* tokens, int token_count, const RelexRange* changed) {
+    ReparseEdit edit = { tokens, token_count, changed->first, changed->old_end, changed->new_end,
+        changed->new_end - changed->old_end };
+
+    // A parse abandoned at a nesting limit stops short of the end of the input
+    int program_end = program->token_first + program->token_count;
+    int complete = program_end >= edit.first && (program_end < edit.old_end ||
+        program_end + edit.delta == token_count || tokens[program_end + edit.delta].type == TOKEN_EOF);
+
+    if (complete) {
+        int capacity = REPARSE_INITIAL_LEVELS;
+        ReparseLevel* levels = safe_malloc(capacity * sizeof(ReparseLevel));
+        levels[0] = (ReparseLevel){ program, NULL, program->token_first, program_end, 0, 0 };
+
+        for (int count = find_enclosing_levels(&levels, &capacity, &edit); count > 0; count--) {
+            if (reparse_level(&levels[count - 1], &edit, program->arena)) {
+                resize_enclosing(levels, count, edit.delta);
+                free(levels);
+                return program;
+            }
+        }
+        free(levels);
+    }
+
+    Arena* arena = program->arena;
+    free_ast(program);
+    return parse_program_in(tokens, token_count, arena);
+}
@@ -0,0 +1,24 @@
+#ifndef PARSER_INCREMENTAL_H
+#define PARSER_INCREMENTAL_H
+
+#include "parser.h"
+#include "lexer_incremental.h"
+
+// Bring `program` up to date after an edit. `program` was built by
+// parse_program() or parse_program_in() from the token array as it was before
+// relex_tokens() applied the edit; `tokens` is the array after it, and `changed`
+// the range relex_tokens() reported.
+//
+// Only the innermost statement list (block or program) enclosing the re-lexed
+// tokens is parsed again, from the statement that could have looked at them up
+// to the first old statement boundary the new parse lands on. Every other
+// subtree is kept by reference. When the new statements do not fit back into
+// that list (a brace was added or removed, say), the enclosing list is tried,
+// and in the end the whole program is parsed again.
+//
+// Kept nodes are not revisited, so those after the edit keep the line, column
+// and offset they were parsed with. Returns the updated program, which replaces
+// `program`: it is the same node unless the program had to be parsed from scratch.
+ASTNode* reparse_program(ASTNode* program, Token* tokens, int token_count, const RelexRange* changed);
+
+#endif // PARSER_INCREMENTAL_H
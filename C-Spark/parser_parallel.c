@@ -0,0 +1,225 @@
+// parser_parallel.c
+#include "parser_parallel.h"
+#include "threads.h"
+#include "interner.h"
+#include "utils.h"
+#include <stdlib.h>
+
+// Ranges waiting to be parsed by one thread. The owner takes ranges from the
+// front; a thread that has run out steals from the back, so an owner and a
+// thief only meet on the last range.
+typedef struct {
+    Mutex lock;
+    int next;              // Next range the owner parses
+    int end;               // One past the last range left
+} RangeQueue;
+
+// Outcome of parsing one range
+typedef struct {
+    ASTNode* program;      // NODE_PROGRAM holding the range's statements
+    int error_count;
+    int aborted;
+} RangeResult;
+
+typedef struct ParallelParse ParallelParse;
+
+typedef struct {
+    ParallelParse* parse;
+    int id;
+    Arena* arena;
+    InternCache symbols;   // Resolves names without contending on the interner's lock
+} ParseWorker;
+
+struct ParallelParse {
+    Token* tokens;
+    const int* cuts;
+    RangeResult* results;
+    RangeQueue* queues;
+    int queue_count;
+};
+
+// A declaration keyword that begins a statement outside any brackets
+static int starts_declaration(const Token* tokens, int i) {
+    const Token* token = &tokens[i];
+    if (token->type != TOKEN_KEYWORD) return 0;
+    if (token->keyword != KEYWORD_FUNC && token->keyword != KEYWORD_STRUCT &&
+        token->keyword != KEYWORD_ENUM && token->keyword != KEYWORD_RECORD) {
+        return 0;
+    }
+    PunctuatorId before = tokens[i - 1].punctuator;
+    return before == PUNCT_SEMICOLON || before == PUNCT_RBRACE;
+}
+
+// One pass of bracket matching: a cut goes at the first declaration past each
+// even share of the tokens
+int parser_prescan_cuts(const Token* tokens, int token_count, int range_count, int* cuts) {
+    int ranges = 1, depth = 0;
+    cuts[0] = 0;
+
+    for (int i = 0; i < token_count && ranges < range_count; i++) {
+        switch (tokens[i].punctuator) {
+        case PUNCT_LBRACE: case PUNCT_LPAREN:
+            depth++;
+            break;
+        case PUNCT_RBRACE: case PUNCT_RPAREN:
+            if (depth > 0) depth--;  // A stray closer is skipped by the parser as well
+            break;
+        default:
+            if (depth == 0 && i > 0 && i >= (int)((long long)token_count * ranges / range_count) &&
+                starts_declaration(tokens, i)) {
+                cuts[ranges++] = i;
+            }
+            break;
+        }
+    }
+
+    cuts[ranges] = token_count;
+    return ranges;
+}
+
+static int take_range(RangeQueue* queue, int steal) {
+    int range = -1;
+    mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        range = steal ? --queue->end : queue->next++;
+    }
+    mutex_unlock(&queue->lock);
+    return range;
+}
+
+// Next range for a worker: its own queue first, then the other queues in turn
+static int next_range(ParseWorker* worker) {
+    ParallelParse* parse = worker->parse;
+    int range = take_range(&parse->queues[worker->id], 0);
+    for (int i = 1; range < 0 && i < parse->queue_count; i++) {
+        range = take_range(&parse->queues[(worker->id + i) % parse->queue_count], 1);
+    }
+    return range;
+}
+
+// Spans are counted from the start of the range's tokens; move them to
+// positions in the whole token array. Nodes without a span are left at zero.
+static void shift_spans(ASTNode* root, int offset) {
+    int count = 0, capacity = 64;
+    ASTNode** stack = safe_malloc(capacity * sizeof(ASTNode*));
+    stack[count++] = root;
+    while (count > 0) {
+        ASTNode* node = stack[--count];
+        if (node->token_count > 0) node->token_first += offset;
+        for (int i = 0; i < node->child_count; i++) {
+            if (!node->children[i]) continue;
+            if (count == capacity) {
+                capacity *= 2;
+                stack = safe_realloc(stack, capacity * sizeof(ASTNode*));
+            }
+            stack[count++] = node->children[i];
+        }
+    }
+    free(stack);
+}
+
+static void parse_range(ParseWorker* worker, int range) {
+    ParallelParse* parse = worker->parse;
+    Token* tokens = parse->tokens + parse->cuts[range];
+    int count = parse->cuts[range + 1] - parse->cuts[range];
+
+    // Names are resolved up front so create_node() finds their symbols already set
+    for (int i = 0; i < count; i++) {
+        Token* token = &tokens[i];
+        if (token->symbol == SYMBOL_NONE && token->type == TOKEN_IDENTIFIER) {
+            token->symbol = intern_cached(&worker->symbols, token_text(token), token_length(token));
+        }
+    }
+
+    TokenSource source;
+    ParserState state;
+    token_source_init_array(&source, tokens, count);
+    parser_state_init(&state, &source);
+    state.arena = worker->arena;
+    ASTNode* program = parse_with_state(&state);
+    if (parse->cuts[range] > 0) shift_spans(program, parse->cuts[range]);
+    parse->results[range] = (RangeResult){ .program = program, .error_count = state.error_count, .aborted = state.aborted };
+}
+
+static void run_parse_worker(void* argument) {
+    ParseWorker* worker = argument;
+    for (int range = next_range(worker); range >= 0; range = next_range(worker)) {
+        parse_range(worker, range);
+    }
+}
+
+// Cut the tokens at top-level declarations, parse the ranges on a work-stealing
+// pool with an arena per thread, then attach each range's statements in order
+ASTNode* parse_program_parallel(ParallelAst* ast, Token* tokens, int token_count, int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = thread_hardware_concurrency();
+    }
+    int range_count = thread_count * PARALLEL_PARSE_RANGES_PER_THREAD;
+    if (range_count > token_count / PARALLEL_PARSE_MIN_RANGE) {
+        range_count = token_count / PARALLEL_PARSE_MIN_RANGE;
+    }
+    if (range_count < 1) range_count = 1;
+
+    int* cuts = safe_malloc((range_count + 1) * sizeof(int));
+    int ranges = parser_prescan_cuts(tokens, token_count, range_count, cuts);
+    if (thread_count > ranges) thread_count = ranges;
+
+    ast->arena_count = thread_count;
+    ast->arenas = safe_malloc(thread_count * sizeof(Arena));
+    ast->error_count = 0;
+    for (int i = 0; i < thread_count; i++) {
+        arena_init(&ast->arenas[i], 0);
+    }
+
+    ParallelParse parse = { .tokens = tokens, .cuts = cuts, .results = safe_malloc(ranges * sizeof(RangeResult)),
+        .queues = safe_malloc(thread_count * sizeof(RangeQueue)), .queue_count = thread_count };
+    ParseWorker* workers = safe_malloc(thread_count * sizeof(ParseWorker));
+    Thread* threads = safe_malloc(thread_count * sizeof(Thread));
+    int* started = safe_malloc(thread_count * sizeof(int));
+    for (int i = 0; i < thread_count; i++) {
+        // Contiguous shares, so each thread mostly parses neighbouring ranges
+        parse.queues[i] = (RangeQueue){ .lock = MUTEX_INIT, .next = (int)((long long)ranges * i / thread_count),
+            .end = (int)((long long)ranges * (i + 1) / thread_count) };
+        workers[i] = (ParseWorker){ .parse = &parse, .id = i, .arena = &ast->arenas[i] };  // .symbols starts zeroed, as an InternCache must
+    }
+
+    // Worker 0 runs on this thread; it steals the share of any thread that failed to start
+    for (int i = 1; i < thread_count; i++) {
+        started[i] = thread_start(&threads[i], run_parse_worker, &workers[i]);
+    }
+    run_parse_worker(&workers[0]);
+    for (int i = 1; i < thread_count; i++) {
+        if (started[i]) thread_join(&threads[i]);
+    }
+
+    // A range that hit a nesting limit ends the program there, as it would a serial
+    // parse, and so does the program's span
+    ast->program = create_node_in(&ast->arenas[0], NODE_PROGRAM, (Token){ .type = TOKEN_EOF, .value = "program" });
+    for (int range = 0; range < ranges; range++) {
+        RangeResult* result = &parse.results[range];
+        for (int i = 0; i < result->program->child_count; i++) {
+            add_child(ast->program, result->program->children[i]);
+        }
+        ast->program->token_count = result->program->token_first + result->program->token_count;
+        ast->error_count += result->error_count;
+        if (result->aborted) break;
+    }
+
+    free(parse.results);
+    free(parse.queues);
+    free(workers);
+    free(threads);
+    free(started);
+    free(cuts);
+    return ast->program;
+}
+
+void parallel_ast_free(ParallelAst* ast) {
+    for (int i = 0; i < ast->arena_count; i++) {
+        arena_free(&ast->arenas[i]);
+    }
+    free(ast->arenas);
+    ast->arenas = NULL;
+    ast->arena_count = 0;
+    ast->program = NULL;
+}
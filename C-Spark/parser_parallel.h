@@ -0,0 +1,34 @@
+#ifndef PARSER_PARALLEL_H
+#define PARSER_PARALLEL_H
+
+#include "parser.h"
+#include "arena.h"
+
+// Ranges shorter than this many tokens are not worth scheduling on their own
+#define PARALLEL_PARSE_MIN_RANGE 4096
+// Ranges queued per thread, so a thread that finishes early has work to steal
+#define PARALLEL_PARSE_RANGES_PER_THREAD 8
+
+// A tree parsed on several threads. Every node lives in one of the per-thread
+// arenas, so the tree is released with parallel_ast_free(), not free_ast().
+typedef struct {
+    ASTNode* program;      // NODE_PROGRAM root; its children are in source order
+    Arena* arenas;         // One per thread
+    int arena_count;
+    int error_count;       // Syntax errors recovered from, as in ParserState.error_count
+} ParallelAst;
+
+// Split tokens[0, token_count) into at most `range_count` ranges that each start
+// at a top-level func, struct, enum or record: outside any braces or parentheses
+// and right after a ';' or '}'. cuts[i] receives each range's first token (the
+// array needs range_count + 1 entries; cuts[n] = token_count). Returns n.
+int parser_prescan_cuts(const Token* tokens, int token_count, int range_count, int* cuts);
+
+// Parse a token array on up to `thread_count` threads (0 = one per processor).
+// Builds the tree parse_program_in() would for input whose top-level
+// declarations parse cleanly, and fills in the tokens' cached symbols on the way.
+// Returns ast->program.
+ASTNode* parse_program_parallel(ParallelAst* ast, Token* tokens, int token_count, int thread_count);
+void parallel_ast_free(ParallelAst* ast);
+
+#endif // PARSER_PARALLEL_H
@@ -0,0 +1,104 @@
+// source_file.c
+#include "source_file.h"
+#include <stdio.h>
+#include <limits.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Map a source file read-only
+int source_file_open(SourceFile* source, const char* path) {
+    source->data = "";
+    source->length = 0;
+
+#ifdef _WIN32
+    source->file_handle = NULL;
+    source->mapping_handle = NULL;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Error: Could not open source file %s\n", path);
+        return 0;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart > INT_MAX) {
+        fprintf(stderr, "Error: Source file %s is unreadable or too large\n", path);
+        CloseHandle(file);
+        return 0;
+    }
+    if (size.QuadPart == 0) {  // Empty files cannot be mapped
+        CloseHandle(file);
+        return 1;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const char* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!data) {
+        fprintf(stderr, "Error: Could not map source file %s\n", path);
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return 0;
+    }
+
+    source->file_handle = file;
+    source->mapping_handle = mapping;
+    source->data = data;
+    source->length = (int)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open source file %s\n", path);
+        perror("File Error");
+        return 0;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size > INT_MAX) {
+        fprintf(stderr, "Error: Source file %s is unreadable or too large\n", path);
+        close(fd);
+        return 0;
+    }
+    if (info.st_size == 0) {  // Empty files cannot be mapped
+        close(fd);
+        return 1;
+    }
+
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping stays valid after the descriptor is closed
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map source file %s\n", path);
+        perror("File Error");
+        return 0;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+#endif
+
+    source->data = data;
+    source->length = (int)info.st_size;
+#endif
+    return 1;
+}
+
+// Unmap a source file
+void source_file_close(SourceFile* source) {
+    if (source->length > 0) {
+#ifdef _WIN32
+        UnmapViewOfFile(source->data);
+        CloseHandle(source->mapping_handle);
+        CloseHandle(source->file_handle);
+#else
+        munmap((void*)source->data, (size_t)source->length);
+#endif
+    }
+    source->data = "";
+    source->length = 0;
+}
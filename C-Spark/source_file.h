@@ -0,0 +1,20 @@
+#ifndef SOURCE_FILE_H
+#define SOURCE_FILE_H
+
+#include <stddef.h>
+
+// A source file mapped read-only into memory. The contents are NOT
+// NUL-terminated; lex them by length (tokenize_buffer / lexer_init_length).
+typedef struct {
+    const char* data;  // Mapped contents ("" for an empty file)
+    int length;        // Size of the file in bytes
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+} SourceFile;
+
+int source_file_open(SourceFile* source, const char* path);  // Map `path`; returns 1 on success, 0 on failure
+void source_file_close(SourceFile* source);                   // Unmap the file; tokens pointing into it become invalid
+
+#endif // SOURCE_FILE_H
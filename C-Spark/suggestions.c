@@ -0,0 +1,132 @@
+// suggestions.c
+#include "suggestions.h"
+#include "utils.h"
+#include <stdlib.h>
+
+#define SUGGESTION_STACK_ROW 64     // Words up to this long need no heap row
+#define SUGGESTION_STACK_DEPTH 64   // Pending nodes held on the stack before a query allocates
+
+// Levenshtein distance over a single rolling row, keeping only the shorter word's
+// row. Stops as soon as every entry of a row exceeds `limit`, since the distance
+// can only grow from there.
+int levenshtein_bounded(const char* a, int a_length, const char* b, int b_length, int limit) {
+    if (a_length < b_length) {  // Roll over the shorter word
+        const char* word = a; a = b; b = word;
+        int length = a_length; a_length = b_length; b_length = length;
+    }
+    if (a_length - b_length > limit) return limit + 1;
+
+    int stack_row[SUGGESTION_STACK_ROW + 1];
+    int* row = b_length <= SUGGESTION_STACK_ROW ? stack_row : safe_malloc((b_length + 1) * sizeof(int));
+    for (int j = 0; j <= b_length; j++) row[j] = j;
+
+    int result;
+    for (int i = 1; i <= a_length; i++) {
+        int diagonal = row[0], row_min = i;
+        row[0] = i;
+        for (int j = 1; j <= b_length; j++) {
+            int above = row[j];
+            int cost = diagonal + (a[i - 1] != b[j - 1]);
+            if (above + 1 < cost) cost = above + 1;
+            if (row[j - 1] + 1 < cost) cost = row[j - 1] + 1;
+            row[j] = cost;
+            diagonal = above;
+            if (cost < row_min) row_min = cost;
+        }
+        if (row_min > limit) {
+            result = limit + 1;
+            goto done;
+        }
+    }
+    result = row[b_length] > limit ? limit + 1 : row[b_length];
+
+done:
+    if (row != stack_row) free(row);
+    return result;
+}
+
+void suggestion_index_init(SuggestionIndex* index) {
+    index->nodes = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+// Walk down from the root along the edge labelled with the word's distance to each node
+void suggestion_index_add(SuggestionIndex* index, const char* word, int length) {
+    int parent = -1, distance = 0;
+    if (index->count > 0) {
+        int node = 0;
+        for (;;) {
+            SuggestionNode* current = &index->nodes[node];
+            int limit = length > current->length ? length : current->length;
+            distance = levenshtein_bounded(word, length, current->word, current->length, limit);
+            if (distance == 0) return;  // Already indexed
+
+            int child = current->first_child;
+            while (child >= 0 && index->nodes[child].distance != distance) {
+                child = index->nodes[child].next_sibling;
+            }
+            if (child < 0) {
+                parent = node;
+                break;
+            }
+            node = child;
+        }
+    }
+
+    if (index->count == index->capacity) {
+        index->capacity = index->capacity ? index->capacity * 2 : 64;
+        index->nodes = safe_realloc(index->nodes, index->capacity * sizeof(SuggestionNode));
+    }
+    int node = index->count++;
+    index->nodes[node] = (SuggestionNode){ word, length, distance, 0, -1, -1 };
+    if (parent >= 0) {
+        SuggestionNode* owner = &index->nodes[parent];
+        index->nodes[node].next_sibling = owner->first_child;
+        owner->first_child = node;
+        if (distance > owner->max_child_distance) owner->max_child_distance = distance;
+    }
+}
+
+// Depth-first search that only descends into children whose edge distance is
+// within the current tolerance of the node's distance (triangle inequality).
+// The tolerance shrinks to the best distance found so far.
+const char* suggestion_index_closest(const SuggestionIndex* index, const char* word, int length, int max_distance, int* distance) {
+    if (index->count == 0) return NULL;
+
+    int stack_buffer[SUGGESTION_STACK_DEPTH];
+    int* stack = index->count <= SUGGESTION_STACK_DEPTH ? stack_buffer : safe_malloc(index->count * sizeof(int));
+    int depth = 0, best = -1, best_distance = max_distance + 1;
+
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const SuggestionNode* node = &index->nodes[stack[--depth]];
+        int tolerance = best_distance < max_distance ? best_distance : max_distance;
+        // No child can be within `tolerance` once the node is further away than
+        // its furthest child plus the tolerance, so the distance need not be exact past that
+        int d = levenshtein_bounded(word, length, node->word, node->length, node->max_child_distance + tolerance);
+
+        int position = (int)(node - index->nodes);
+        if (d < best_distance || (d == best_distance && d <= max_distance && position < best)) {
+            best = position;
+            best_distance = d;
+            tolerance = d < max_distance ? d : max_distance;
+        }
+        for (int child = node->first_child; child >= 0; child = index->nodes[child].next_sibling) {
+            int edge = index->nodes[child].distance;
+            if (edge >= d - tolerance && edge <= d + tolerance) {
+                stack[depth++] = child;
+            }
+        }
+    }
+
+    if (stack != stack_buffer) free(stack);
+    if (best < 0) return NULL;
+    if (distance) *distance = best_distance;
+    return index->nodes[best].word;
+}
+
+void suggestion_index_free(SuggestionIndex* index) {
+    free(index->nodes);
+    suggestion_index_init(index);
+}
@@ -0,0 +1,33 @@
+#ifndef SUGGESTIONS_H
+#define SUGGESTIONS_H
+
+// "Did you mean" index: a BK-tree over words (keywords, declared names) that
+// finds the closest word to a misspelling without comparing against all of them.
+
+// BK-tree node; children are linked through first_child/next_sibling indices
+typedef struct {
+    const char* word;      // Not owned; must outlive the index
+    int length;
+    int distance;          // Edit distance to the parent
+    int max_child_distance; // Largest distance of any child, bounds the work per visited node
+    int first_child;       // -1 if none
+    int next_sibling;      // -1 if none
+} SuggestionNode;
+
+typedef struct {
+    SuggestionNode* nodes; // nodes[0] is the root; nodes are in insertion order
+    int count;
+    int capacity;
+} SuggestionIndex;
+
+// Edit distance between two spans, or limit + 1 as soon as it is known to exceed `limit`
+int levenshtein_bounded(const char* a, int a_length, const char* b, int b_length, int limit);
+
+void suggestion_index_init(SuggestionIndex* index);
+void suggestion_index_add(SuggestionIndex* index, const char* word, int length); // Duplicates are ignored
+// Closest word within max_distance (ties go to the earliest added word); NULL if none.
+// Stores the distance in `distance` when it is not NULL.
+const char* suggestion_index_closest(const SuggestionIndex* index, const char* word, int length, int max_distance, int* distance);
+void suggestion_index_free(SuggestionIndex* index);
+
+#endif // SUGGESTIONS_H
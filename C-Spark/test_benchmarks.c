@@ -0,0 +1,923 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "lexer.h"
+#include "lexer_simd.h"
+#include "parser.h"
+#include "lexer_parallel.h"
+#include "lexer_incremental.h"
+#include "token_stream.h"
+#include "threads.h"
+#include "suggestions.h"
+#include "flat_ast.h"
+#include "parser_parallel.h"
+#include "parser_incremental.h"
+#include "ast_cache.h"
+#include "transpile.h"
+#include "utils.h"
+
+#define BENCHMARK_SOURCE_BYTES (4 * 1024 * 1024)
+#define BENCHMARK_RUNS 3
+
+// Representative C-Spark source, repeated to build large benchmark inputs
+static const char* benchmark_snippet =
+    "func compute_total(count, limit) {\n"
+    "    let total = 0x1F + 42 * count; // running total\n"
+    "    /* accumulate\n"
+    "       over several lines */\n"
+    "    if (total >= limit && count != 0) { print(\"over ${limit} by\", total - limit); }\n"
+    "    for (let i = 0; i <= count; i += 1) { total = total + 3.25; }\n"
+    "    return total;\n"
+    "}\n";
+
+// Machine-formatted source: deep indentation, banner comments and long strings
+static const char* formatted_snippet =
+    "/*\n"
+    " * ------------------------------------------------------------------------\n"
+    " * compute_report: generated by the formatter, do not edit by hand.\n"
+    " * ------------------------------------------------------------------------\n"
+    " */\n"
+    "func compute_report(count, limit) {\n"
+    "                                                                                \n"
+    "        // ----------------------------------------------------------------\n"
+    "        // Accumulate totals over the input range\n"
+    "        // ----------------------------------------------------------------\n"
+    "        let total = 0;\n"
+    "                for (let i = 0; i <= count; i += 1) {\n"
+    "                                total = total + i;\n"
+    "                }\n"
+    "        print(\"the report for this run covers every item in the input range ${count}\");\n"
+    "        return total;\n"
+    "}\n\n\n";
+
+// Statements the parser accepts without debugger output, for parser benchmarks
+static const char* parser_snippet =
+    "{ (count + limit * 3) (total - 4 / step) }\n"
+    "{ { (a * b + c * d) } (x <= y) }\n";
+
+// Declarations and nested blocks that parse cleanly, for AST-heavy benchmarks
+static const char* declaration_snippet =
+    "let total = 3 * (count + 2) - limit;\n"
+    "func update(a, b, c) { let s = a + b * c; { let t = (s - 1) * 2; print(t); } }\n";
+
+// Build a NUL-terminated source of roughly `size` bytes from `snippet`
+static char* build_source_from(const char* snippet, size_t size) {
+    size_t snippet_length = strlen(snippet);
+    size_t copies = size / snippet_length + 1;
+    char* source = malloc(copies * snippet_length + 1);
+    if (!source) {
+        fprintf(stderr, "Error: Benchmark source allocation failed\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < copies; i++) {
+        memcpy(source + i * snippet_length, snippet, snippet_length);
+    }
+    source[copies * snippet_length] = '\0';
+    return source;
+}
+
+// Build a NUL-terminated source of roughly `size` bytes
+static char* build_benchmark_source(size_t size) {
+    return build_source_from(benchmark_snippet, size);
+}
+
+// Best of BENCHMARK_RUNS streaming `source` through `next_token` into one
+// reused token, so neither array growth nor token storage is timed
+static double time_engine(int (*next_token)(Lexer*, Token*), const char* source, int* token_count) {
+    double best = -1.0;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        Lexer lexer;
+        Token token;
+        int count = 1;
+        lexer_init(&lexer, source);
+        clock_t start = clock();
+        while (next_token(&lexer, &token)) count++;
+        double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+        *token_count = count;
+        if (best < 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// Compare the table-driven lexer's character-class dispatch with the reference
+// strchr/isalpha chain on a large source
+void benchmark_lexer_engines() {
+    printf("Benchmarking lexer engines...\n");
+    char* source = build_benchmark_source(BENCHMARK_SOURCE_BYTES);
+    double megabytes = strlen(source) / (1024.0 * 1024.0);
+
+    int reference_count = 0, table_count = 0;
+    double reference_time = time_engine(lexer_next_token_reference, source, &reference_count);
+    double table_time = time_engine(lexer_next_token, source, &table_count);
+    assert(reference_count == table_count);
+
+    printf("  Source: %.1f MB, %d tokens, streamed one token at a time\n", megabytes, table_count);
+    printf("  Reference lexer:    %8.3f s (%7.1f MB/s)\n", reference_time, megabytes / (reference_time > 0 ? reference_time : 1e-9));
+    printf("  Table-driven lexer: %8.3f s (%7.1f MB/s)\n", table_time, megabytes / (table_time > 0 ? table_time : 1e-9));
+    if (table_time > 0) {
+        printf("  Speedup: %.2fx\n", reference_time / table_time);
+    }
+
+    free(source);
+}
+
+// Lex `source` to EOF with the given scanning kernels; returns the token count
+static int lex_with_kernels(const char* source, const ScanKernels* kernels) {
+    Lexer lexer;
+    Token token;
+    int count = 1;
+    lexer_init(&lexer, source);
+    lexer.kernels = kernels;
+    while (lexer_next_token(&lexer, &token)) count++;
+    return count;
+}
+
+// Compare the scalar and SIMD scanning kernels on whitespace- and comment-heavy source
+void benchmark_scan_kernels() {
+    printf("Benchmarking lexer scanning kernels...\n");
+    char* source = build_source_from(formatted_snippet, BENCHMARK_SOURCE_BYTES);
+    double megabytes = strlen(source) / (1024.0 * 1024.0);
+    double scalar_time = 0;
+    int expected_count = -1;
+
+    for (int level = SIMD_SCALAR; level <= SIMD_AVX2; level++) {
+        const ScanKernels* kernels = scan_kernels_for(level);
+        if (!kernels) continue;
+
+        double best = -1.0;
+        for (int run = 0; run < BENCHMARK_RUNS; run++) {
+            clock_t start = clock();
+            int count = lex_with_kernels(source, kernels);
+            double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+            if (expected_count < 0) expected_count = count;
+            assert(count == expected_count);
+            if (best < 0 || elapsed < best) best = elapsed;
+        }
+        if (level == SIMD_SCALAR) scalar_time = best;
+
+        printf("  %-6s kernels: %8.3f s (%7.1f MB/s)", kernels->name, best, megabytes / (best > 0 ? best : 1e-9));
+        if (level != SIMD_SCALAR && best > 0) {
+            printf(", %.2fx over scalar", scalar_time / best);
+        }
+        printf("\n");
+    }
+
+    free(source);
+}
+
+// Compare parsing a fully materialized token array with parsing through the bounded token window
+void benchmark_streaming_parser() {
+    printf("Benchmarking streaming parser...\n");
+    char* source = build_source_from(parser_snippet, BENCHMARK_SOURCE_BYTES);
+    int length = (int)strlen(source);
+    double megabytes = length / (1024.0 * 1024.0);
+
+    clock_t start = clock();
+    int token_count = 0;
+    Token* tokens = tokenize_zero_copy(source, &token_count);
+    ASTNode* from_array = parse_program(tokens, token_count);
+    double array_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    free_ast(from_array);
+    free_tokens(tokens, token_count);
+
+    start = clock();
+    ASTNode* from_source = parse_source(source, length);
+    double stream_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    free_ast(from_source);
+
+    printf("  Source: %.1f MB, %d tokens\n", megabytes, token_count);
+    printf("  Token array + parse: %8.3f s, token memory %10zu bytes\n", array_time, (size_t)token_count * sizeof(Token));
+    printf("  Streaming parse:     %8.3f s, token memory %10zu bytes\n", stream_time, sizeof(TokenSource));
+
+    free(source);
+}
+
+// Wall-clock seconds; clock() sums CPU time over all threads on some platforms
+static double wall_seconds(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Scale the parallel lexer from one thread up to one per processor
+void benchmark_parallel_lexer() {
+    printf("Benchmarking parallel lexer...\n");
+    char* source = build_benchmark_source(4 * BENCHMARK_SOURCE_BYTES);
+    int length = (int)strlen(source);
+    double megabytes = length / (1024.0 * 1024.0);
+    int max_threads = thread_hardware_concurrency();
+    if (max_threads < 4) max_threads = 4;  // Still exercise the split on small machines
+
+    int serial_count = 0;
+    Token* serial = tokenize_buffer(source, length, &serial_count);
+    printf("  Source: %.1f MB, %d tokens, %d processors\n", megabytes, serial_count, thread_hardware_concurrency());
+
+    double single_time = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double best = -1.0;
+        for (int run = 0; run < BENCHMARK_RUNS; run++) {
+            int count = 0;
+            double start = wall_seconds();
+            Token* tokens = tokenize_parallel(source, length, threads, &count);
+            double elapsed = wall_seconds() - start;
+
+            assert(count == serial_count);
+            assert(tokens[count / 2].offset == serial[count / 2].offset && tokens[count / 2].line == serial[count / 2].line);
+            free_tokens(tokens, count);
+            if (best < 0 || elapsed < best) best = elapsed;
+        }
+        if (threads == 1) single_time = best;
+        printf("  %2d thread(s): %8.3f s (%7.1f MB/s, %.2fx)\n", threads, best,
+            megabytes / (best > 0 ? best : 1e-9), best > 0 ? single_time / best : 0.0);
+    }
+
+    free_tokens(serial, serial_count);
+    free(source);
+}
+
+// Re-lex after single-character keystrokes in a 10k-line file, against lexing it from scratch
+void benchmark_incremental_lexer() {
+    printf("Benchmarking incremental lexer...\n");
+    char* source = build_benchmark_source(10000 * strlen(benchmark_snippet) / 8);  // ~10k lines
+    int length = (int)strlen(source);
+    char* code = malloc(length + 2);
+    memcpy(code, source, length + 1);
+
+    int count = 0;
+    double start = wall_seconds();
+    Token* tokens = tokenize_buffer(code, length, &count);
+    double full_time = wall_seconds() - start;
+
+    // Type a character into the middle of an identifier, then delete it again
+    const char* word = strstr(code + length / 2, "count");
+    int offset = (int)(word - code) + 2;
+    double relex_time = 0;
+    int keystrokes = 2000;
+    for (int i = 0; i < keystrokes; i++) {
+        TextEdit edit = { offset, 0, "x", 1 };
+        if (i % 2) {
+            edit.deleted_length = 1;
+            edit.inserted_length = 0;
+        }
+        memmove(code + offset + edit.inserted_length, code + offset + edit.deleted_length, length - offset - edit.deleted_length + 1);
+        memcpy(code + offset, edit.inserted, edit.inserted_length);
+        length += edit.inserted_length - edit.deleted_length;
+
+        start = wall_seconds();
+        tokens = relex_tokens(tokens, &count, code, length, &edit, NULL, NULL);
+        relex_time += wall_seconds() - start;
+    }
+
+    int expected_count = 0;
+    Token* expected = tokenize_buffer(code, length, &expected_count);
+    assert(count == expected_count && tokens[count / 2].offset == expected[count / 2].offset);
+
+    printf("  Source: %d lines, %d tokens\n", tokens[count - 1].line, count);
+    printf("  Full lex:          %10.1f us\n", full_time * 1e6);
+    printf("  Relex / keystroke: %10.1f us\n", relex_time * 1e6 / keystrokes);
+
+    free_tokens(expected, expected_count);
+    free_tokens(tokens, count);
+    free(code);
+    free(source);
+}
+
+// Compare token memory and a lookahead-style scan over a Token array and a compact token stream
+void benchmark_token_stream() {
+    printf("Benchmarking compact token stream...\n");
+    char* source = build_benchmark_source(BENCHMARK_SOURCE_BYTES);
+    int length = (int)strlen(source);
+
+    double start = wall_seconds();
+    int count = 0;
+    Token* tokens = tokenize_buffer(source, length, &count);
+    double array_build = wall_seconds() - start;
+
+    start = wall_seconds();
+    TokenStream stream;
+    token_stream_build(&stream, source, length);
+    double stream_build = wall_seconds() - start;
+
+    // Scan for statement ends the way a parser skips ahead: kinds first, text only on a hit
+    int array_hits = 0, stream_hits = 0;
+    start = wall_seconds();
+    for (int run = 0; run < 10; run++) {
+        for (int i = 0; i < count; i++) {
+            if (tokens[i].type == TOKEN_SYMBOL && *tokens[i].start == ';') array_hits++;
+        }
+    }
+    double array_scan = wall_seconds() - start;
+    start = wall_seconds();
+    for (int run = 0; run < 10; run++) {
+        for (int i = 0; i < stream.count; i++) {
+            if (stream.kinds[i] == TOKEN_SYMBOL && source[stream.offsets[i]] == ';') stream_hits++;
+        }
+    }
+    double stream_scan = wall_seconds() - start;
+    assert(array_hits == stream_hits && stream.count == count);
+
+    size_t array_bytes = (size_t)count * sizeof(Token);
+    size_t stream_bytes = token_stream_memory(&stream);
+    printf("  Source: %.1f MB, %d tokens\n", length / (1024.0 * 1024.0), count);
+    printf("  Token array:  %10zu bytes, build %8.3f s, scan %8.3f s\n", array_bytes, array_build, array_scan);
+    printf("  Token stream: %10zu bytes, build %8.3f s, scan %8.3f s\n", stream_bytes, stream_build, stream_scan);
+    printf("  Memory reduction: %.1fx\n", (double)array_bytes / stream_bytes);
+
+    token_stream_free(&stream);
+    free_tokens(tokens, count);
+    free(source);
+}
+
+// Best-of-N wall time of lexing `source` with each token-text strategy
+static double time_huge_lex(int strategy, const char* source, int length) {
+    double best = -1.0;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        Arena arena;
+        arena_init(&arena, 0);
+        int count = 0;
+        double start = wall_seconds();
+        Token* tokens = strategy == 0 ? tokenize_reference(source, &count)
+            : strategy == 1 ? tokenize(source, &count)
+            : strategy == 2 ? tokenize_arena(source, length, &arena, &count)
+            : tokenize_buffer(source, length, &count);
+        double elapsed = wall_seconds() - start;
+        free_tokens(tokens, count);
+        arena_free(&arena);
+        if (best < 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// Lex multi-megabyte string literals and 10k-character identifiers
+void benchmark_huge_tokens() {
+    printf("Benchmarking huge tokens...\n");
+    const int identifiers = 200, identifier_length = 10000, string_length = 4 * 1024 * 1024;
+    char* source = malloc(identifiers * (identifier_length + 16) + 2 * (string_length + 16) + 1);
+    int length = 0;
+    for (int n = 0; n < identifiers; n++) {
+        length += sprintf(source + length, "let ");
+        for (int i = 0; i < identifier_length; i++) source[length++] = 'a' + (i + n) % 26;
+        length += sprintf(source + length, " = %d;\n", n);
+    }
+    for (int n = 0; n < 2; n++) {
+        source[length++] = '"';
+        for (int i = 0; i < string_length; i++) source[length++] = i % 80 == 79 ? '\n' : 'a' + i % 26;
+        length += sprintf(source + length, "\";\n");
+    }
+    source[length] = '\0';
+
+    const char* names[] = { "Reference lexer", "Owned (per-token copy)", "Arena (one copy)", "Zero-copy" };
+    printf("  Source: %.1f MB, %d identifiers of %d chars, 2 strings of %.1f MB\n",
+        length / (1024.0 * 1024.0), identifiers, identifier_length, string_length / (1024.0 * 1024.0));
+    for (int strategy = 0; strategy < 4; strategy++) {
+        double elapsed = time_huge_lex(strategy, source, length);
+        printf("  %-24s %8.4f s (%7.1f MB/s)\n", names[strategy], elapsed, length / (1024.0 * 1024.0) / (elapsed > 0 ? elapsed : 1e-9));
+    }
+
+    free(source);
+}
+
+// The original suggestion distance: a row-by-row malloc'd full matrix per comparison
+static int matrix_levenshtein(const char* s1, const char* s2) {
+    int len1 = (int)strlen(s1), len2 = (int)strlen(s2);
+    int** dp = malloc((len1 + 1) * sizeof(int*));
+    for (int i = 0; i <= len1; i++) {
+        dp[i] = malloc((len2 + 1) * sizeof(int));
+    }
+    for (int i = 0; i <= len1; i++) dp[i][0] = i;
+    for (int j = 0; j <= len2; j++) dp[0][j] = j;
+    for (int i = 1; i <= len1; i++) {
+        for (int j = 1; j <= len2; j++) {
+            int min = dp[i - 1][j - 1] + (s1[i - 1] != s2[j - 1]);
+            if (dp[i - 1][j] + 1 < min) min = dp[i - 1][j] + 1;
+            if (dp[i][j - 1] + 1 < min) min = dp[i][j - 1] + 1;
+            dp[i][j] = min;
+        }
+    }
+    int result = dp[len1][len2];
+    for (int i = 0; i <= len1; i++) free(dp[i]);
+    free(dp);
+    return result;
+}
+
+// "Did you mean" lookups of misspelled names among thousands of declared names
+void benchmark_suggestions() {
+    printf("Benchmarking suggestions...\n");
+    enum { NAMES = 5000, QUERIES = 1000, MAX_DISTANCE = 2 };
+    static char names[NAMES][24];
+    unsigned int random = 99;
+    for (int n = 0; n < NAMES; n++) {
+        int length = sprintf(names[n], "%s_", n % 3 == 0 ? "total" : n % 3 == 1 ? "count" : "index");
+        for (int i = 0; i < 6; i++) {
+            random = random * 1103515245u + 12345u;
+            names[n][length++] = (char)('a' + (random >> 16) % 26);
+        }
+        names[n][length] = '\0';
+    }
+    char queries[QUERIES][24];
+    for (int q = 0; q < QUERIES; q++) {
+        strcpy_s(queries[q], sizeof(queries[q]), names[(q * 4999) % NAMES]);
+        random = random * 1103515245u + 12345u;
+        queries[q][6 + (random >> 16) % 6] = 'z';  // One typo in the random part
+    }
+
+    double start = wall_seconds();
+    int linear_found = 0;
+    for (int q = 0; q < QUERIES; q++) {
+        int best = MAX_DISTANCE + 1;
+        for (int n = 0; n < NAMES; n++) {
+            int distance = matrix_levenshtein(queries[q], names[n]);
+            if (distance < best) best = distance;
+        }
+        linear_found += best <= MAX_DISTANCE;
+    }
+    double linear = wall_seconds() - start;
+
+    start = wall_seconds();
+    SuggestionIndex index;
+    suggestion_index_init(&index);
+    for (int n = 0; n < NAMES; n++) {
+        suggestion_index_add(&index, names[n], (int)strlen(names[n]));
+    }
+    double build = wall_seconds() - start;
+
+    start = wall_seconds();
+    int indexed_found = 0;
+    for (int q = 0; q < QUERIES; q++) {
+        indexed_found += suggestion_index_closest(&index, queries[q], (int)strlen(queries[q]), MAX_DISTANCE, NULL) != NULL;
+    }
+    double indexed = wall_seconds() - start;
+    assert(indexed_found == linear_found);
+    suggestion_index_free(&index);
+
+    printf("  %d names, %d misspelled lookups (max distance %d)\n", NAMES, QUERIES, MAX_DISTANCE);
+    printf("  Linear scan (full matrix): %8.4f s\n", linear);
+    printf("  BK-tree build:             %8.4f s\n", build);
+    printf("  BK-tree lookups:           %8.4f s (%.1fx faster)\n", indexed, linear / (indexed > 0 ? indexed : 1e-9));
+}
+
+// Parse and tear down the same tokens with heap nodes and with an arena
+void benchmark_ast_arena() {
+    printf("Benchmarking AST arena...\n");
+    char* source = build_source_from(declaration_snippet, BENCHMARK_SOURCE_BYTES);
+    int token_count = 0;
+    Token* tokens = tokenize_zero_copy(source, &token_count);
+
+    double heap_parse = 1e9, heap_free = 1e9, arena_parse = 1e9, arena_free_time = 1e9;
+    Arena arena;
+    arena_init(&arena, 0);
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        double start = wall_seconds();
+        ASTNode* program = parse_program(tokens, token_count);
+        double parsed = wall_seconds();
+        free_ast(program);
+        double freed = wall_seconds();
+        if (parsed - start < heap_parse) heap_parse = parsed - start;
+        if (freed - parsed < heap_free) heap_free = freed - parsed;
+
+        start = wall_seconds();
+        program = parse_program_in(tokens, token_count, &arena);
+        parsed = wall_seconds();
+        arena_reset(&arena);
+        freed = wall_seconds();
+        if (parsed - start < arena_parse) arena_parse = parsed - start;
+        if (freed - parsed < arena_free_time) arena_free_time = freed - parsed;
+    }
+    arena_free(&arena);
+
+    printf("  Source: %.1f MB, %d tokens\n", strlen(source) / (1024.0 * 1024.0), token_count);
+    printf("  Heap nodes:  parse %8.4f s, free  %8.4f s\n", heap_parse, heap_free);
+    printf("  Arena nodes: parse %8.4f s, reset %8.4f s (%.1fx faster overall)\n", arena_parse, arena_free_time,
+        (heap_parse + heap_free) / (arena_parse + arena_free_time > 0 ? arena_parse + arena_free_time : 1e-9));
+
+    free_tokens(tokens, token_count);
+    free(source);
+}
+
+// Copy a tree the way the parser built it before child arrays doubled:
+// one realloc per appended child, every node with a separate array
+static ASTNode* clone_tree_realloc(const ASTNode* node) {
+    ASTNode* copy = malloc(sizeof(ASTNode));
+    *copy = *node;
+    copy->children = NULL;
+    copy->child_count = 0;
+    copy->child_capacity = 0;
+    copy->arena = NULL;
+    for (int i = 0; i < node->child_count; i++) {
+        ASTNode* child = clone_tree_realloc(node->children[i]);
+        copy->children = realloc(copy->children, (copy->child_count + 1) * sizeof(ASTNode*));
+        copy->children[copy->child_count++] = child;
+    }
+    return copy;
+}
+
+// Copy a tree with create_node/add_child (inline children, doubling arrays)
+static ASTNode* clone_tree(const ASTNode* node) {
+    ASTNode* copy = create_node(node->type, node->token);
+    for (int i = 0; i < node->child_count; i++) {
+        add_child(copy, clone_tree(node->children[i]));
+    }
+    return copy;
+}
+
+static size_t count_child_arrays(const ASTNode* node) {
+    size_t arrays = node->children && node->children != node->inline_children;
+    for (int i = 0; i < node->child_count; i++) arrays += count_child_arrays(node->children[i]);
+    return arrays;
+}
+
+// Build and free the AST of a 100k-statement program with per-insert realloc and with amortized growth
+void benchmark_child_growth() {
+    printf("Benchmarking child array growth...\n");
+    enum { STATEMENTS = 100000 };
+    char* source = malloc(STATEMENTS * 64);
+    int length = 0;
+    for (int i = 0; i < STATEMENTS; i++) {
+        length += sprintf(source + length, i % 2 ? "let v%d = (v%d + 2) * 3;\n" : "{ let w%d = v%d; }\n", i, i / 2);
+    }
+
+    int token_count = 0;
+    Token* tokens = tokenize_zero_copy(source, &token_count);
+    double start = wall_seconds();
+    ASTNode* program = parse_program(tokens, token_count);
+    double parse_time = wall_seconds() - start;
+    assert(program->child_count == STATEMENTS);
+
+    double before = 1e9, after = 1e9;
+    size_t before_arrays = 0, after_arrays = 0;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        start = wall_seconds();
+        ASTNode* copy = clone_tree_realloc(program);
+        before_arrays = count_child_arrays(copy);
+        free_ast(copy);
+        double elapsed = wall_seconds() - start;
+        if (elapsed < before) before = elapsed;
+
+        start = wall_seconds();
+        copy = clone_tree(program);
+        after_arrays = count_child_arrays(copy);
+        free_ast(copy);
+        elapsed = wall_seconds() - start;
+        if (elapsed < after) after = elapsed;
+    }
+
+    printf("  %d statements, %d tokens; parse %.4f s\n", STATEMENTS, token_count, parse_time);
+    printf("  Realloc per child:   build + free %8.4f s, %zu child arrays\n", before, before_arrays);
+    printf("  Inline + doubling:   build + free %8.4f s, %zu child arrays (%.1fx faster)\n", after, after_arrays,
+        before / (after > 0 ? after : 1e-9));
+
+    free_ast(program);
+    free_tokens(tokens, token_count);
+    free(source);
+}
+
+// Sample analysis pass: leaf count plus total leaf depth
+static void measure_leaves(const ASTNode* node, int depth, size_t* leaves, size_t* depth_total) {
+    if (node->child_count == 0) {
+        (*leaves)++;
+        *depth_total += depth;
+    }
+    for (int i = 0; i < node->child_count; i++) measure_leaves(node->children[i], depth + 1, leaves, depth_total);
+}
+
+// Run the same pass over the pointer AST and over its flat pre-order copy
+void benchmark_flat_ast() {
+    printf("Benchmarking flat AST traversal...\n");
+    char* source = build_source_from(declaration_snippet, BENCHMARK_SOURCE_BYTES);
+    int token_count = 0;
+    Token* tokens = tokenize_zero_copy(source, &token_count);
+    ASTNode* program = parse_program(tokens, token_count);
+
+    FlatAst ast;
+    double build_time = 1e9, pointer_time = 1e9, flat_time = 1e9;
+    size_t pointer_leaves = 0, pointer_depths = 0, flat_leaves = 0, flat_depths = 0;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        double start = wall_seconds();
+        flat_ast_build(&ast, program);
+        double elapsed = wall_seconds() - start;
+        if (elapsed < build_time) build_time = elapsed;
+        if (run < BENCHMARK_RUNS - 1) flat_ast_free(&ast);
+    }
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        pointer_leaves = pointer_depths = flat_leaves = flat_depths = 0;
+        double start = wall_seconds();
+        measure_leaves(program, 0, &pointer_leaves, &pointer_depths);
+        double elapsed = wall_seconds() - start;
+        if (elapsed < pointer_time) pointer_time = elapsed;
+
+        start = wall_seconds();
+        for (uint32_t i = 0; i < ast.count; i++) {
+            if (ast.nodes[i].subtree_size == 1) {
+                flat_leaves++;
+                flat_depths += ast.nodes[i].depth;
+            }
+        }
+        elapsed = wall_seconds() - start;
+        if (elapsed < flat_time) flat_time = elapsed;
+    }
+    assert(pointer_leaves == flat_leaves && pointer_depths == flat_depths);
+
+    printf("  %u nodes (%zu leaves); flatten %.4f s\n", ast.count, flat_leaves, build_time);
+    printf("  Pointer tree walk: %8.4f s\n", pointer_time);
+    printf("  Flat linear scan:  %8.4f s (%.1fx faster)\n", flat_time, pointer_time / (flat_time > 0 ? flat_time : 1e-9));
+
+    flat_ast_free(&ast);
+    free_ast(program);
+    free_tokens(tokens, token_count);
+    free(source);
+}
+
+// Operator precedence the way the parser used to find it, by comparing token text
+static int precedence_by_text(const Token* token) {
+    if (token->type == TOKEN_OPERATOR) {
+        if (token_equals(token, "*") || token_equals(token, "/")) return 3;
+        if (token_equals(token, "+") || token_equals(token, "-")) return 2;
+        if (token_equals(token, "==") || token_equals(token, "!=")) return 1;
+        if (token_equals(token, "<") || token_equals(token, "<=") ||
+            token_equals(token, ">") || token_equals(token, ">=")) return 1;
+    }
+    return -1;
+}
+
+// Classify every token of a large source by comparing text and by punctuator ID
+void benchmark_operator_dispatch() {
+    printf("Benchmarking operator dispatch...\n");
+    char* source = build_source_from(benchmark_snippet, BENCHMARK_SOURCE_BYTES);
+    int token_count = 0;
+    Token* tokens = tokenize_zero_copy(source, &token_count);
+
+    double by_text = 1e9, by_id = 1e9;
+    long long text_total = 0, id_total = 0;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        text_total = id_total = 0;
+        double start = wall_seconds();
+        for (int i = 0; i < token_count; i++) {
+            text_total += precedence_by_text(&tokens[i]) + (tokens[i].type == TOKEN_SYMBOL && token_equals(&tokens[i], "{"));
+        }
+        double elapsed = wall_seconds() - start;
+        if (elapsed < by_text) by_text = elapsed;
+
+        start = wall_seconds();
+        for (int i = 0; i < token_count; i++) {
+            id_total += get_precedence(&tokens[i]) + (tokens[i].punctuator == PUNCT_LBRACE);
+        }
+        elapsed = wall_seconds() - start;
+        if (elapsed < by_id) by_id = elapsed;
+    }
+    assert(text_total == id_total);
+
+    printf("  %d tokens\n", token_count);
+    printf("  Text comparisons: %8.4f s\n", by_text);
+    printf("  Punctuator IDs:   %8.4f s (%.1fx faster)\n", by_id, by_text / (by_id > 0 ? by_id : 1e-9));
+
+    free_tokens(tokens, token_count);
+    free(source);
+}
+
+// Serial arena parse against parsing the top-level declarations on a thread pool
+void benchmark_parallel_parser() {
+    printf("Benchmarking parallel parser...\n");
+    char* source = build_source_from(declaration_snippet, 4 * BENCHMARK_SOURCE_BYTES);
+    int token_count = 0;
+    Token* tokens = tokenize_zero_copy(source, &token_count);
+    int max_threads = thread_hardware_concurrency();
+    if (max_threads < 4) max_threads = 4;  // Still exercise the pool on small machines
+    printf("  Source: %.1f MB, %d tokens, %d processors\n", strlen(source) / (1024.0 * 1024.0), token_count,
+        thread_hardware_concurrency());
+
+    // A fresh arena per run, as the parallel parse gets, so both pay for the same page faults
+    double serial = 1e9;
+    int statements = 0;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        Arena arena;
+        arena_init(&arena, 0);
+        double start = wall_seconds();
+        ASTNode* program = parse_program_in(tokens, token_count, &arena);
+        double elapsed = wall_seconds() - start;
+        statements = program->child_count;
+        arena_free(&arena);
+        if (elapsed < serial) serial = elapsed;
+    }
+    printf("  Serial:       %8.3f s\n", serial);
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double best = 1e9;
+        for (int run = 0; run < BENCHMARK_RUNS; run++) {
+            ParallelAst ast;
+            double start = wall_seconds();
+            parse_program_parallel(&ast, tokens, token_count, threads);
+            double elapsed = wall_seconds() - start;
+            assert(ast.program->child_count == statements);
+            parallel_ast_free(&ast);
+            if (elapsed < best) best = elapsed;
+        }
+        printf("  %2d thread(s): %8.3f s (%.2fx)\n", threads, best, serial / (best > 0 ? best : 1e-9));
+    }
+
+    free_tokens(tokens, token_count);
+    free(source);
+}
+
+// Reparse after single-character keystrokes inside a function body, against parsing the whole file again
+void benchmark_incremental_parser() {
+    printf("Benchmarking incremental parser...\n");
+    char* source = build_source_from(declaration_snippet, BENCHMARK_SOURCE_BYTES);
+    int length = (int)strlen(source);
+    char* code = malloc(length + 2);
+    memcpy(code, source, length + 1);
+
+    int count = 0;
+    Token* tokens = tokenize_buffer(code, length, &count);
+    double start = wall_seconds();
+    ASTNode* program = parse_program(tokens, count);
+    double full_time = wall_seconds() - start;
+
+    // Type a character into a name in a nested block, then delete it again
+    const char* word = strstr(code + length / 2, "print(t)");
+    int offset = (int)(word - code) + 7;
+    double relex_time = 0, reparse_time = 0;
+    int keystrokes = 2000;
+    for (int i = 0; i < keystrokes; i++) {
+        TextEdit edit = { offset, 0, "x", 1 };
+        if (i % 2) {
+            edit.deleted_length = 1;
+            edit.inserted_length = 0;
+        }
+        memmove(code + offset + edit.inserted_length, code + offset + edit.deleted_length, length - offset - edit.deleted_length + 1);
+        memcpy(code + offset, edit.inserted, edit.inserted_length);
+        length += edit.inserted_length - edit.deleted_length;
+
+        RelexRange changed;
+        start = wall_seconds();
+        tokens = relex_tokens(tokens, &count, code, length, &edit, NULL, &changed);
+        double relexed = wall_seconds();
+        program = reparse_program(program, tokens, count, &changed);
+        reparse_time += wall_seconds() - relexed;
+        relex_time += relexed - start;
+    }
+
+    ASTNode* expected = parse_program(tokens, count);
+    assert(program->child_count == expected->child_count);
+
+    printf("  Source: %d tokens, %d top-level statements\n", count, program->child_count);
+    printf("  Full parse:          %10.1f us\n", full_time * 1e6);
+    printf("  Relex / keystroke:   %10.1f us\n", relex_time * 1e6 / keystrokes);
+    printf("  Reparse / keystroke: %10.1f us\n", reparse_time * 1e6 / keystrokes);
+
+    free_ast(expected);
+    free_ast(program);
+    free_tokens(tokens, count);
+    free(code);
+    free(source);
+}
+
+// Lex and parse a large source, against mapping its .csast cache and against
+// rebuilding the pointer tree from the cache
+void benchmark_ast_cache() {
+    printf("Benchmarking AST cache...\n");
+    const char* cache_path = "csark_benchmark.csast";
+    char* source = build_source_from(declaration_snippet, BENCHMARK_SOURCE_BYTES);
+    int length = (int)strlen(source);
+
+    double parse_time = 1e9, write_time = 1e9, open_time = 1e9, load_time = 1e9;
+    Arena arena;
+    arena_init(&arena, 0);
+    ASTNode* program = NULL;
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        arena_reset(&arena);
+        double start = wall_seconds();
+        int token_count = 0;
+        Token* tokens = tokenize_zero_copy(source, &token_count);
+        program = parse_program_in(tokens, token_count, &arena);
+        free_tokens(tokens, token_count);
+        double elapsed = wall_seconds() - start;
+        if (elapsed < parse_time) parse_time = elapsed;
+    }
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        double start = wall_seconds();
+        assert(ast_cache_write(cache_path, program, source, length));
+        double elapsed = wall_seconds() - start;
+        if (elapsed < write_time) write_time = elapsed;
+    }
+
+    AstCache cache;
+    Arena loaded_arena;
+    arena_init(&loaded_arena, 0);
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        double start = wall_seconds();
+        assert(ast_cache_open(&cache, cache_path, source, length));
+        double elapsed = wall_seconds() - start;
+        if (elapsed < open_time) open_time = elapsed;
+
+        arena_reset(&loaded_arena);
+        start = wall_seconds();
+        ASTNode* loaded = ast_cache_to_ast(&cache, &loaded_arena);
+        elapsed = wall_seconds() - start;
+        if (elapsed < load_time) load_time = elapsed;
+        assert(loaded && loaded->child_count == program->child_count);
+        if (run < BENCHMARK_RUNS - 1) ast_cache_close(&cache);
+    }
+
+    printf("  %u nodes, %u strings, %.1f MB cache file\n", cache.node_count, cache.header->string_count,
+        (cache.header->text_offset + cache.header->text_size) / (1024.0 * 1024.0));
+    printf("  Lex and parse:     %8.4f s\n", parse_time);
+    printf("  Write cache:       %8.4f s\n", write_time);
+    printf("  Open cache:        %8.4f s (%.1fx faster than parsing)\n", open_time, parse_time / (open_time > 0 ? open_time : 1e-9));
+    printf("  Open and rebuild:  %8.4f s (%.1fx faster than parsing)\n", open_time + load_time,
+        parse_time / (open_time + load_time > 0 ? open_time + load_time : 1e-9));
+
+    ast_cache_close(&cache);
+    remove(cache_path);
+    arena_free(&loaded_arena);
+    arena_free(&arena);
+    free(source);
+}
+
+// IR the way transpile() used to build it: a malloc'd node with strdup'd code
+// each, appended by walking the list from the head
+static IRNode* build_ir_by_tail_walk(int count) {
+    IRNode* head = NULL;
+    char code[32];
+    for (int i = 0; i < count; i++) {
+        snprintf(code, sizeof(code), "printf(\"%%s\\n\", v%d);", i);
+        IRNode* node = calloc(1, sizeof(IRNode));
+        node->code = utils_safe_strdup(code);
+        node->line = i + 1;
+        append_ir_node(&head, node);
+    }
+    return head;
+}
+
+static void free_ir_by_tail_walk(IRNode* head) {
+    while (head) {
+        IRNode* next = head->next;
+        free(head->code);
+        free(head);
+        head = next;
+    }
+}
+
+// Append IR nodes by tail walk and through an IRBuilder, then transpile a
+// 100k-statement program, which has to stay linear in the statement count
+void benchmark_ir_builder() {
+    printf("Benchmarking IR builder...\n");
+    enum { WALK_STATEMENTS = 20000, STATEMENTS = 100000 };
+
+    double start = wall_seconds();
+    IRNode* walked = build_ir_by_tail_walk(WALK_STATEMENTS);
+    double walk_time = wall_seconds() - start;
+    free_ir_by_tail_walk(walked);
+
+    double build_time[2] = { 1e9, 1e9 };
+    int sizes[2] = { WALK_STATEMENTS, STATEMENTS };
+    char code[32];
+    for (int size = 0; size < 2; size++) {
+        for (int run = 0; run < BENCHMARK_RUNS; run++) {
+            start = wall_seconds();
+            IRBuilder ir;
+            ir_builder_init(&ir);
+            for (int i = 0; i < sizes[size]; i++) {
+                snprintf(code, sizeof(code), "printf(\"%%s\\n\", v%d);", i);
+                ir_builder_emit(&ir, code, i + 1, 1, NULL, NULL);
+            }
+            assert(ir.count == sizes[size]);
+            ir_builder_free(&ir);
+            double elapsed = wall_seconds() - start;
+            if (elapsed < build_time[size]) build_time[size] = elapsed;
+        }
+    }
+
+    // Interpolated strings are transpiled without a statement around them
+    const char* text = "\"total ${v} of ${limit}\"";
+    Arena arena;
+    arena_init(&arena, 0);
+    double transpile_time[2] = { 1e9, 1e9 };
+    size_t output_length = 0;
+    for (int size = 0; size < 2; size++) {
+        Token token = { .type = TOKEN_EOF, .value = "program" };
+        ASTNode* program = create_node_in(&arena, NODE_PROGRAM, token);
+        for (int i = 0; i < sizes[size]; i++) {
+            token = (Token){ .type = TOKEN_STRING, .line = i + 1, .column = 1, .start = text, .length = (int)strlen(text) };
+            add_child(program, create_node_in(&arena, NODE_STRING_INTERPOLATION, token));
+        }
+        for (int run = 0; run < BENCHMARK_RUNS; run++) {
+            start = wall_seconds();
+            char* output = transpile(program);
+            double elapsed = wall_seconds() - start;
+            if (elapsed < transpile_time[size]) transpile_time[size] = elapsed;
+            output_length = strlen(output);
+            free(output);
+        }
+        arena_reset(&arena);
+    }
+    arena_free(&arena);
+
+    printf("  Tail walk, %d nodes:   %8.4f s\n", WALK_STATEMENTS, walk_time);
+    printf("  IRBuilder, %d nodes:   %8.4f s (%.1fx faster)\n", WALK_STATEMENTS, build_time[0],
+        walk_time / (build_time[0] > 0 ? build_time[0] : 1e-9));
+    printf("  IRBuilder, %d nodes:  %8.4f s\n", STATEMENTS, build_time[1]);
+    printf("  transpile(), %d statements: %8.4f s; %d statements: %8.4f s (%.2f us per statement); %zu bytes of C\n",
+        WALK_STATEMENTS, transpile_time[0], STATEMENTS, transpile_time[1], transpile_time[1] * 1e6 / STATEMENTS, output_length);
+}
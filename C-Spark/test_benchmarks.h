@@ -0,0 +1,21 @@
+#ifndef TEST_BENCHMARKS_H
+#define TEST_BENCHMARKS_H
+
+void benchmark_lexer_engines();
+void benchmark_scan_kernels();
+void benchmark_streaming_parser();
+void benchmark_parallel_lexer();
+void benchmark_incremental_lexer();
+void benchmark_token_stream();
+void benchmark_huge_tokens();
+void benchmark_suggestions();
+void benchmark_ast_arena();
+void benchmark_child_growth();
+void benchmark_flat_ast();
+void benchmark_operator_dispatch();
+void benchmark_parallel_parser();
+void benchmark_incremental_parser();
+void benchmark_ast_cache();
+void benchmark_ir_builder();
+
+#endif // TEST_BENCHMARKS_H
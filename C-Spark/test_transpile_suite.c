@@ -80,7 +80,7 @@ void transpile_to_ir(ASTNode* root, IRNode** ir_list) {
 
     if (root->type == NODE_VARIABLE_DECLARATION) {
         char buffer[256];
-        snprintf(buffer, sizeof(buffer), "let %s;", root->token.value);
+        snprintf(buffer, sizeof(buffer), "let " TOKEN_FMT ";", TOKEN_ARG(&root->token));
         IRNode* node = create_ir_node(buffer, root->token.line, root->token.column, NULL);
         node->next = *ir_list;
         *ir_list = node;
@@ -130,11 +130,11 @@ int test_ir_node_creation() {
 // Test transpile_to_ir with a simple AST
 int test_transpile_to_ir() {
     Token tokens[] = {
-        {TOKEN_KEYWORD, "let", 1, 1},
-        {TOKEN_IDENTIFIER, "x", 1, 5},
-        {TOKEN_OPERATOR, "=", 1, 7},
-        {TOKEN_LITERAL, "10", 1, 9},
-        {TOKEN_SYMBOL, ";", 1, 11}
+        { .type = TOKEN_KEYWORD, .value = "let", .line = 1, .column = 1 },
+        { .type = TOKEN_IDENTIFIER, .value = "x", .line = 1, .column = 5 },
+        { .type = TOKEN_OPERATOR, .value = "=", .line = 1, .column = 7 },
+        { .type = TOKEN_LITERAL, .value = "10", .line = 1, .column = 9 },
+        { .type = TOKEN_SYMBOL, .value = ";", .line = 1, .column = 11 }
     };
 
     // Create the root AST node
@@ -173,8 +173,8 @@ int test_transpile_to_ir() {
 // Test error handling for unsupported nodes
 int test_unsupported_node_handling() {
     // Unsupported node: struct
-    Token struct_token = { TOKEN_KEYWORD, "struct", 1, 1 };
-    ASTNode unsupported = { NODE_STRUCT, struct_token, NULL, 0 };
+    Token struct_token = { .type = TOKEN_KEYWORD, .value = "struct", .line = 1, .column = 1 };
+    ASTNode unsupported = { .type = NODE_STRUCT, .token = struct_token, .children = NULL, .child_count = 0 };
     IRNode* ir_list = NULL;
 
     transpile_to_ir(&unsupported, &ir_list);
@@ -303,15 +303,79 @@ int test_generate_code_from_ir() {
     return result;
 }
 
+// Test IRBuilder: nodes come out in append order and own copies of their strings
+int test_ir_builder() {
+    IRBuilder ir;
+    ir_builder_init(&ir);
+    char code[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(code, sizeof(code), "int x%d = %d;", i, i);
+        ir_builder_emit(&ir, code, i + 1, 1, i == 0 ? "let x0 = 0;" : NULL, NULL);
+    }
+    strcpy_s(code, sizeof(code), "overwritten");
+
+    int result = ir.count == 1000 && ir.tail->next == NULL && ir.tail->line == 1000 &&
+        strcmp(ir.head->code, "int x0 = 0;") == 0 && strcmp(ir.head->original_code, "let x0 = 0;") == 0 &&
+        strcmp(ir.tail->code, "int x999 = 999;") == 0 && ir.tail->original_code == NULL;
+    int count = 0;
+    for (IRNode* node = ir.head; node; node = node->next) {
+        if (node->line != ++count) result = 0;
+    }
+
+    const char* expected_start = "#include <stdio.h>\n\nint x0 = 0;\nint x1 = 1;\n";
+    const char* expected_end = "int x998 = 998;\nint x999 = 999;\n";
+    char* generated = generate_code_from_ir(ir.head, "c");
+    size_t length = strlen(generated);
+    result = result && count == 1000 && length > strlen(expected_start) + strlen(expected_end) &&
+        strncmp(generated, expected_start, strlen(expected_start)) == 0 &&
+        strcmp(generated + length - strlen(expected_end), expected_end) == 0;
+    if (!result) {
+        fprintf(stderr, "Error: IRBuilder list or generated code did not match.\n");
+    }
+
+    free(generated);
+    ir_builder_free(&ir);
+    return result && ir.head == NULL && ir.count == 0;
+}
+
+
+static int count_occurrences(const char* text, const char* pattern) {
+    int count = 0;
+    for (const char* at = strstr(text, pattern); at; at = strstr(at + 1, pattern)) count++;
+    return count;
+}
+
+// Test that functions, structs and interpolated strings emit their children once
+int test_transpile_children_once() {
+    const char* input = "func f(a) { let x = 1; { print(\"v ${x}\"); } } struct P { int x; float y; }";
+    int token_count = 0;
+    Token* tokens = tokenize(input, &token_count);
+    ASTNode* tree = parse_program(tokens, token_count);
+    char* output = transpile(tree);
+
+    // The function body and the block inside it, each opened and closed once
+    int result = count_occurrences(output, "// Start of block") == 2 &&
+        count_occurrences(output, "// End of block") == 2 &&
+        count_occurrences(output, "printf(\"v %s\\n\", x);") == 1 &&
+        strstr(output, "struct P {\nint x;\nfloat y;\n};\n") != NULL;
+    if (!result) {
+        fprintf(stderr, "Error: Transpiled children were missing or repeated:\n%s", output);
+    }
+
+    free(output);
+    free_ast(tree);
+    free_tokens(tokens, token_count);
+    return result;
+}
 
 // test_transpile function
 int test_transpile() {
     Token tokens[] = {
-        {TOKEN_KEYWORD, "let", 1, 1},
-        {TOKEN_IDENTIFIER, "x", 1, 5},
-        {TOKEN_OPERATOR, "=", 1, 7},
-        {TOKEN_LITERAL, "10", 1, 9},
-        {TOKEN_SYMBOL, ";", 1, 11}
+        { .type = TOKEN_KEYWORD, .value = "let", .line = 1, .column = 1 },
+        { .type = TOKEN_IDENTIFIER, .value = "x", .line = 1, .column = 5 },
+        { .type = TOKEN_OPERATOR, .value = "=", .line = 1, .column = 7 },
+        { .type = TOKEN_LITERAL, .value = "10", .line = 1, .column = 9 },
+        { .type = TOKEN_SYMBOL, .value = ";", .line = 1, .column = 11 }
     };
 
     ASTNode* root = create_node(NODE_PROGRAM, tokens[0]);
@@ -350,34 +414,39 @@ int test_transpile() {
 void test_string_interpolation() {
     ASTNode node = {
         .type = NODE_STRING_INTERPOLATION,
-        .token = {TOKEN_STRING, "Hello, ${name}!", 1, 1},
+        .token = { .type = TOKEN_STRING, .value = "Hello, ${name}!", .line = 1, .column = 1 },
         .children = NULL,
         .child_count = 0
     };
 
-    IRNode* ir_list = NULL;
-    transpile_string_interpolation(&node, &ir_list);
+    IRBuilder ir;
+    ir_builder_init(&ir);
+    transpile_string_interpolation(&node, &ir);
 
-    printf("Generated Code:\n%s\n", ir_list->code);
+    printf("Generated Code:\n%s\n", ir.head->code);
     // Expected: printf("Hello, %s\\n", name);
 
-    free_ir_list(ir_list);
+    ir_builder_free(&ir);
 }
 
 void test_transpile_function() {
     printf("Testing transpile_function...\n");
     ASTNode node;
-    IRNode* ir_list = NULL;
-    transpile_function(&node, &ir_list);
-    assert(ir_list != NULL);
+    IRBuilder ir;
+    ir_builder_init(&ir);
+    transpile_function(&node, &ir);
+    assert(ir.head != NULL);
+    ir_builder_free(&ir);
     printf("--> transpile_function passed\n");
 }
 
 void test_transpile_string_interpolation() {
     printf("Testing transpile_string_interpolation...\n");
     ASTNode node;
-    IRNode* ir_list = NULL;
-    transpile_string_interpolation(&node, &ir_list);
-    assert(ir_list != NULL);
+    IRBuilder ir;
+    ir_builder_init(&ir);
+    transpile_string_interpolation(&node, &ir);
+    assert(ir.head != NULL);
+    ir_builder_free(&ir);
     printf("--> transpile_string_interpolation passed\n");
 }
\ No newline at end of file
@@ -9,6 +9,8 @@ int test_ir_node_creation();
 int test_transpile_to_ir();
 int test_unsupported_node_handling();
 int test_generate_code_from_ir();
+int test_ir_builder();
+int test_transpile_children_once();
 int test_transpile();
 void test_interdependent_functions();
 void test_transpile_function();
@@ -0,0 +1,92 @@
+// threads.c
+#include "threads.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct {
+    ThreadFunction function;
+    void* argument;
+} ThreadStart;
+
+#ifdef _WIN32
+static unsigned __stdcall thread_entry(void* start) {
+    ThreadStart* thread_start = start;
+    thread_start->function(thread_start->argument);
+    return 0;
+}
+#else
+static void* thread_entry(void* start) {
+    ThreadStart* thread_start = start;
+    thread_start->function(thread_start->argument);
+    return NULL;
+}
+#endif
+
+// Start a thread running function(argument)
+int thread_start(Thread* thread, ThreadFunction function, void* argument) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    if (!start) return 0;
+    start->function = function;
+    start->argument = argument;
+    thread->start = start;
+
+#ifdef _WIN32
+    thread->handle = (void*)_beginthreadex(NULL, 0, thread_entry, start, 0, NULL);
+    if (!thread->handle) {
+        free(start);
+        return 0;
+    }
+#else
+    if (pthread_create(&thread->handle, NULL, thread_entry, start) != 0) {
+        free(start);
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+// Wait for a thread to finish
+void thread_join(Thread* thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+    free(thread->start);
+    thread->start = NULL;
+}
+
+// Number of logical processors
+int thread_hardware_concurrency(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+void mutex_lock(Mutex* mutex) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void mutex_unlock(Mutex* mutex) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
@@ -0,0 +1,42 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+// Minimal portable threads: Win32 threads on Windows, pthreads elsewhere
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef void (*ThreadFunction)(void* argument);
+
+typedef struct {
+#ifdef _WIN32
+    void* handle;
+#else
+    pthread_t handle;
+#endif
+    void* start;           // Heap block carrying the function and argument to the new thread
+} Thread;
+
+// Mutex that needs no runtime initialization: static Mutex lock = MUTEX_INIT;
+typedef struct {
+#ifdef _WIN32
+    void* lock;            // SRWLOCK
+#else
+    pthread_mutex_t lock;
+#endif
+} Mutex;
+
+#ifdef _WIN32
+#define MUTEX_INIT { 0 }
+#else
+#define MUTEX_INIT { PTHREAD_MUTEX_INITIALIZER }
+#endif
+
+int thread_start(Thread* thread, ThreadFunction function, void* argument); // Returns 1 on success, 0 on failure
+void thread_join(Thread* thread);                                          // Wait for the thread and release it
+int thread_hardware_concurrency(void);                                     // Number of logical processors (at least 1)
+void mutex_lock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+
+#endif // THREADS_H
@@ -0,0 +1,105 @@
+// token_source.c
+#include "token_source.h"
+
+#define TOKEN_WINDOW_MASK (TOKEN_WINDOW_SIZE - 1)
+
+// Start a lexer-backed source over `length` bytes of `code`
+void token_source_init(TokenSource* source, const char* code, int length) {
+    lexer_init_length(&source->lexer, code, length);
+    source->array = NULL;
+    source->array_count = 0;
+    source->stream = NULL;
+    source->cursor = 0;
+    source->produced = 0;
+    source->eof_index = -1;
+}
+
+// Start an array-backed source over already tokenized input
+void token_source_init_array(TokenSource* source, Token* tokens, int token_count) {
+    source->array = tokens;
+    source->array_count = token_count;
+    source->stream = NULL;
+    source->cursor = 0;
+    source->produced = token_count;
+    source->eof_index = token_count - 1;
+}
+
+// Start a stream-backed source over a compact token stream
+void token_source_init_stream(TokenSource* source, const TokenStream* stream) {
+    source->array = NULL;
+    source->array_count = 0;
+    source->stream = stream;
+    source->stream_line = 0;
+    source->cursor = 0;
+    source->produced = 0;
+    source->eof_index = -1;
+}
+
+// Lex until the token at `index` is in the window (or EOF has been produced)
+static void token_source_fill(TokenSource* source, int index) {
+    while (source->produced <= index && source->eof_index < 0) {
+        Token* slot = &source->window[source->produced & TOKEN_WINDOW_MASK];
+        int more;
+        if (source->stream) {
+            *slot = token_stream_expand(source->stream, source->produced, &source->stream_line);
+            more = source->produced + 1 < source->stream->count;
+        }
+        else {
+            more = lexer_next_token(&source->lexer, slot);
+        }
+        if (!more) {
+            source->eof_index = source->produced;
+        }
+        source->produced++;
+    }
+}
+
+// k-th unconsumed token (0 = current), NULL past EOF
+Token* token_source_peek(TokenSource* source, int k) {
+    int index = source->cursor + k;
+    if (k < 0 || k > TOKEN_MAX_LOOKAHEAD || index < 0) {
+        return NULL;
+    }
+    if (source->array) {
+        return index < source->array_count ? &source->array[index] : NULL;
+    }
+
+    token_source_fill(source, index);
+    if (index >= source->produced) {
+        return NULL;
+    }
+    return &source->window[index & TOKEN_WINDOW_MASK];
+}
+
+// Consume and return the current token, NULL past EOF
+Token* token_source_next(TokenSource* source) {
+    Token* token = token_source_peek(source, 0);
+    if (token) {
+        source->cursor++;
+    }
+    return token;
+}
+
+// k-th most recently consumed token (1 = last), NULL if it has left the window
+Token* token_source_previous(TokenSource* source, int k) {
+    int index = source->cursor - k;
+    if (k < 1 || index < 0) {
+        return NULL;
+    }
+    if (source->array) {
+        return &source->array[index];
+    }
+    return k <= TOKEN_HISTORY_SIZE ? &source->window[index & TOKEN_WINDOW_MASK] : NULL;
+}
+
+// Step back over the last consumed token
+void token_source_unread(TokenSource* source) {
+    if (source->cursor > 0) {
+        source->cursor--;
+    }
+}
+
+// Number of tokens consumed
+int token_source_position(const TokenSource* source) {
+    return source->cursor;
+}
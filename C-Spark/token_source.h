@@ -0,0 +1,45 @@
+#ifndef TOKEN_SOURCE_H
+#define TOKEN_SOURCE_H
+
+#include "lexer.h"
+#include "token_stream.h"
+
+// Ring buffer size; must be a power of two
+#define TOKEN_WINDOW_SIZE 256
+// Consumed tokens kept readable behind the cursor (token_source_previous, token_source_unread)
+#define TOKEN_HISTORY_SIZE 64
+// Largest lookahead token_source_peek() accepts
+#define TOKEN_MAX_LOOKAHEAD (TOKEN_WINDOW_SIZE - TOKEN_HISTORY_SIZE - 1)
+
+// Pull-based token stream. A lexer-backed source tokenizes on demand into a
+// fixed ring buffer, so token memory stays constant in the size of the input
+// and parsing overlaps lexing. An array-backed source serves an already
+// tokenized array through the same interface, and a stream-backed source
+// expands a compact TokenStream into the window as the parser advances.
+//
+// Token pointers returned by the source stay valid until TOKEN_HISTORY_SIZE
+// further tokens have been consumed; copy a token to keep it longer. They are
+// writable, and an array-backed source hands out the caller's own tokens, so a
+// token_symbol() call on one caches the symbol in the caller's array.
+typedef struct {
+    Lexer lexer;
+    Token window[TOKEN_WINDOW_SIZE];
+    Token* array;        // Token array for array-backed sources, NULL when lexer-backed
+    int array_count;
+    const TokenStream* stream; // Token stream for stream-backed sources, NULL otherwise
+    int stream_line;     // Line cursor for token_stream_expand()
+    int cursor;          // Index of the next token to consume
+    int produced;        // Tokens lexed so far
+    int eof_index;       // Index of the EOF token once produced, -1 before
+} TokenSource;
+
+void token_source_init(TokenSource* source, const char* code, int length);             // Lex `length` bytes of `code` on demand
+void token_source_init_array(TokenSource* source, Token* tokens, int token_count);     // Serve a tokenized array in place
+void token_source_init_stream(TokenSource* source, const TokenStream* stream);          // Serve a compact token stream
+Token* token_source_peek(TokenSource* source, int k);      // k-th unconsumed token (0 = current), NULL past EOF
+Token* token_source_next(TokenSource* source);             // Consume and return the current token, NULL past EOF
+Token* token_source_previous(TokenSource* source, int k);  // k-th most recently consumed token (1 = last), NULL if gone
+void token_source_unread(TokenSource* source);             // Step back over the last consumed token
+int token_source_position(const TokenSource* source);      // Number of tokens consumed
+
+#endif // TOKEN_SOURCE_H
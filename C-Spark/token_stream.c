@@ -0,0 +1,143 @@
+// token_stream.c
+#include "token_stream.h"
+#include "error_reporting.h"
+
+static void token_stream_out_of_memory(void) {
+    report_error("Lexer", 0, 0, "Memory allocation failed while building the token stream");
+    exit(1);
+}
+
+// Grow every per-token array together
+static void token_stream_grow(TokenStream* stream) {
+    int capacity = stream->capacity * 2;
+    unsigned char* kinds = realloc(stream->kinds, capacity * sizeof(unsigned char));
+    if (!kinds) token_stream_out_of_memory();
+    stream->kinds = kinds;
+    int* offsets = realloc(stream->offsets, capacity * sizeof(int));
+    if (!offsets) token_stream_out_of_memory();
+    stream->offsets = offsets;
+    int* lengths = realloc(stream->lengths, capacity * sizeof(int));
+    if (!lengths) token_stream_out_of_memory();
+    stream->lengths = lengths;
+    stream->capacity = capacity;
+}
+
+static void token_stream_add_line(TokenStream* stream, int offset, int line) {
+    if (stream->line_count >= stream->line_capacity) {
+        int capacity = stream->line_capacity * 2;
+        LineStart* lines = realloc(stream->lines, capacity * sizeof(LineStart));
+        if (!lines) token_stream_out_of_memory();
+        stream->lines = lines;
+        stream->line_capacity = capacity;
+    }
+    stream->lines[stream->line_count++] = (LineStart){ offset, line };
+}
+
+// Lex the whole source into the stream
+int token_stream_build(TokenStream* stream, const char* code, int length) {
+    stream->code = code;
+    stream->capacity = length / 4 + 16;  // Typical source averages well over 4 bytes per token
+    stream->kinds = malloc(stream->capacity * sizeof(unsigned char));
+    stream->offsets = malloc(stream->capacity * sizeof(int));
+    stream->lengths = malloc(stream->capacity * sizeof(int));
+    stream->line_capacity = length / 32 + 16;
+    stream->lines = malloc(stream->line_capacity * sizeof(LineStart));
+    if (!stream->kinds || !stream->offsets || !stream->lengths || !stream->lines) token_stream_out_of_memory();
+    stream->count = 0;
+    stream->line_count = 0;
+
+    Lexer lexer;
+    Token token;
+    int more;
+    lexer_init_length(&lexer, code, length);
+    do {
+        more = lexer_next_token(&lexer, &token);
+        if (stream->count >= stream->capacity) {
+            token_stream_grow(stream);
+        }
+        if (stream->line_count == 0 || stream->lines[stream->line_count - 1].line != token.line) {
+            token_stream_add_line(stream, token.offset - token.column + 1, token.line);
+        }
+        stream->kinds[stream->count] = (unsigned char)token.type;
+        stream->offsets[stream->count] = token.offset;
+        stream->lengths[stream->count] = token.length;
+        stream->count++;
+    } while (more);
+
+    return stream->count;
+}
+
+void token_stream_free(TokenStream* stream) {
+    free(stream->kinds);
+    free(stream->offsets);
+    free(stream->lengths);
+    free(stream->lines);
+    *stream = (TokenStream){ 0 };
+}
+
+const char* token_stream_text(const TokenStream* stream, int index) {
+    return stream->code + stream->offsets[index] + (stream->kinds[index] == TOKEN_STRING);  // String text follows the quote
+}
+
+// Index of the line-start entry holding `offset`
+static int token_stream_line_entry(const TokenStream* stream, int offset) {
+    int low = 0, high = stream->line_count - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (stream->lines[middle].offset <= offset) low = middle;
+        else high = middle - 1;
+    }
+    return low;
+}
+
+void token_stream_position(const TokenStream* stream, int index, int* line, int* column) {
+    const LineStart* start = &stream->lines[token_stream_line_entry(stream, stream->offsets[index])];
+    *line = start->line;
+    *column = stream->offsets[index] - start->offset + 1;
+}
+
+size_t token_stream_memory(const TokenStream* stream) {
+    return (size_t)stream->count * (sizeof(unsigned char) + 2 * sizeof(int)) + (size_t)stream->line_count * sizeof(LineStart);
+}
+
+// Expand one entry, advancing the line cursor; callers walking the stream in
+// order pay no search for line numbers
+Token token_stream_expand(const TokenStream* stream, int index, int* line_entry) {
+    int offset = stream->offsets[index];
+    while (*line_entry + 1 < stream->line_count && stream->lines[*line_entry + 1].offset <= offset) {
+        (*line_entry)++;
+    }
+    const LineStart* start = &stream->lines[*line_entry];
+    Token token = { .type = (TokenType)stream->kinds[index], .value = NULL, .line = start->line,
+        .column = offset - start->offset + 1, .start = token_stream_text(stream, index),
+        .length = stream->lengths[index], .offset = offset, .keyword = KEYWORD_NONE, .punctuator = PUNCT_NONE,
+        .symbol = SYMBOL_NONE, .number = { .kind = NUMBER_NONE } };
+    if (token.type == TOKEN_KEYWORD) {
+        token.keyword = keyword_lookup(token.start, token.length);
+    }
+    else if (token.type == TOKEN_OPERATOR || token.type == TOKEN_SYMBOL) {
+        token.punctuator = punctuator_lookup(token.start, token.length);
+    }
+    else if (token.type == TOKEN_LITERAL) {
+        token.number = number_literal_value(token.start, token.length);
+    }
+    return token;
+}
+
+Token token_stream_token(const TokenStream* stream, int index) {
+    int line_entry = token_stream_line_entry(stream, stream->offsets[index]);
+    return token_stream_expand(stream, index, &line_entry);
+}
+
+Token* token_stream_to_tokens(const TokenStream* stream, int* token_count) {
+    Token* tokens = malloc(stream->count * sizeof(Token));
+    if (!tokens) token_stream_out_of_memory();
+
+    int line_entry = 0;
+    for (int i = 0; i < stream->count; i++) {
+        tokens[i] = token_stream_expand(stream, i, &line_entry);
+    }
+
+    *token_count = stream->count;
+    return tokens;
+}
@@ -0,0 +1,39 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include "lexer.h"
+
+// First token on a source line, recorded while lexing
+typedef struct {
+    int offset;        // Byte offset of the line start
+    int line;          // Line number (1-based)
+} LineStart;
+
+// Compact structure-of-arrays token storage: 9 bytes per token instead of a
+// Token struct. Token text is code[offsets[i], offsets[i] + lengths[i]), except
+// that a string's offset is its opening quote. Lines and columns are derived
+// on demand from the line-start index.
+typedef struct TokenStream {
+    const char* code;      // Source buffer; must outlive the stream
+    unsigned char* kinds;  // TokenType of each token
+    int* offsets;          // Byte offset of each token
+    int* lengths;          // Text length of each token
+    int count;
+    int capacity;
+    LineStart* lines;      // Start of every line that begins a token, by offset
+    int line_count;
+    int line_capacity;
+} TokenStream;
+
+int token_stream_build(TokenStream* stream, const char* code, int length); // Lex `length` bytes of `code`; returns the token count
+void token_stream_free(TokenStream* stream);
+const char* token_stream_text(const TokenStream* stream, int index);  // Token text (not NUL-terminated)
+void token_stream_position(const TokenStream* stream, int index, int* line, int* column); // Line and column of a token
+size_t token_stream_memory(const TokenStream* stream);                // Bytes held by the stream
+
+// Adapters for Token-based callers
+Token token_stream_token(const TokenStream* stream, int index);       // Zero-copy Token for one entry
+Token token_stream_expand(const TokenStream* stream, int index, int* line_entry); // Same, for in-order walks; *line_entry starts at 0
+Token* token_stream_to_tokens(const TokenStream* stream, int* token_count); // Zero-copy Token array (free with free_tokens)
+
+#endif // TOKEN_STREAM_H
@@ -4,8 +4,17 @@
 // Debug function to print tokens
 void print_tokens(Token* tokens, int count) {
     for (int i = 0; i < count; i++) {
-        printf("Token(Type: %d, Value: '%s', Line: %d, Column: %d)\n",
-            tokens[i].type, tokens[i].value, tokens[i].line, tokens[i].column);
+        printf("Token(Type: %d, Value: '" TOKEN_FMT "', Line: %d, Column: %d)\n",
+            tokens[i].type, TOKEN_ARG(&tokens[i]), tokens[i].line, tokens[i].column);
+    }
+}
+
+// Print a compact token stream in the same format as print_tokens
+void print_token_stream(const TokenStream* stream) {
+    int line_entry = 0;
+    for (int i = 0; i < stream->count; i++) {
+        Token token = token_stream_expand(stream, i, &line_entry);
+        print_tokens(&token, 1);
     }
 }
 
@@ -2,8 +2,10 @@
 #define DEBUG_TOOLS_H
 
 #include "lexer.h" // To access Token structure and definitions
+#include "token_stream.h"
 
 // Function declarations for debugging tools
 void print_tokens(Token* tokens, int count);
+void print_token_stream(const TokenStream* stream);
 
 #endif // DEBUG_TOOLS_H
@@ -9,8 +9,8 @@
 #include "inline_hints.h"  // Include the Inline Hints system
 #define _CRT_SECURE_NO_WARNINGS
 
-void transpile_to_ir_with_scope(ASTNode* node, IRNode** ir_list, Scope* current_scope);
-static void transpile_to_ir(ASTNode* node, IRNode** ir_list);
+void transpile_to_ir_with_scope(ASTNode* node, IRBuilder* builder, Scope* current_scope);
+static void transpile_to_ir(ASTNode* node, IRBuilder* builder);
 
 // Safe memory allocation safe_strdup helper
 void* validate_input(const void* input, const char* error_message, int should_exit) {
@@ -63,29 +63,63 @@ static void add_indentation(char** code, int level) {
         *code = append_code(*code, "    ");
     }
 }
-// Intermediate Representation (IR) Node structure
-static void initialize_ir_node(IRNode* ir, const char* code, int line, int column, const char* original_code, Scope* scope) {
-    // Safely duplicate the code
-    ir->code = code ? safe_strdup(code) : NULL;// Use NULL if code is not provided
+// Start an empty IR list
+void ir_builder_init(IRBuilder* builder) {
+    builder->head = NULL;
+    builder->tail = NULL;
+    builder->count = 0;
+    arena_init(&builder->arena, 0);
+}
+
+// Link a node in after the tail
+static void ir_builder_append(IRBuilder* builder, IRNode* node) {
+    node->next = NULL;
+    if (builder->tail) {
+        builder->tail->next = node;
+    }
+    else {
+        builder->head = node;
+    }
+    builder->tail = node;
+    builder->count++;
+}
+
+// Append a node; `code` and `original_length` bytes of `original_code` are copied into the builder's arena
+static IRNode* ir_builder_emit_span(IRBuilder* builder, const char* code, int line, int column,
+    const char* original_code, int original_length, Scope* scope) {
+    IRNode* ir = arena_alloc(&builder->arena, sizeof(IRNode));
+    ir->code = code ? arena_strndup(&builder->arena, code, strlen(code)) : NULL;
     ir->line = line;
     ir->column = column;
-    ir->original_code = original_code ? safe_strdup(original_code) : NULL;
-    ir->scope = scope ? scope : NULL;  // Use NULL if scope is not provided
-    ir->next = NULL;
+    ir->original_code = original_code ? arena_strndup(&builder->arena, original_code, original_length) : NULL;
+    ir->scope = scope;
+    ir->is_async = 0;
+    ir->metadata = NULL;
+    ir->type = NULL;
+    ir_builder_append(builder, ir);
+    return ir;
 }
 
-// Create a new IR node
-static IRNode* create_ir_node(const char* code, int line, int column, const char* original_code, Scope* scope) {
-    // Allocate memory for IRNode and validate it
-    IRNode* ir = validate_input(safe_malloc(sizeof(IRNode)), "Memory allocation failed for IRNode", 1);
+IRNode* ir_builder_emit(IRBuilder* builder, const char* code, int line, int column, const char* original_code, Scope* scope) {
+    return ir_builder_emit_span(builder, code, line, column, original_code,
+        original_code ? (int)strlen(original_code) : 0, scope);
+}
 
-    // Initialize the IRNode fields
-    initialize_ir_node(ir, code, line, column, original_code, scope);
+// Append an IR node that maps back to the source text of a token
+static IRNode* ir_builder_emit_token(IRBuilder* builder, const char* code, const Token* token, Scope* scope) {
+    return ir_builder_emit_span(builder, code, token->line, token->column, token_text(token), token_length(token), scope);
+}
 
-    return ir;
+// Release every node of the list at once
+void ir_builder_free(IRBuilder* builder) {
+    arena_free(&builder->arena);
+    builder->head = NULL;
+    builder->tail = NULL;
+    builder->count = 0;
 }
 
-// Append an IR node to the list
+// Append an IR node to a list kept without a builder; this walks to the tail,
+// so long lists should be built with an IRBuilder
 void append_ir_node(IRNode** head, IRNode* new_node) {
     if (!*head) {
         *head = new_node;
@@ -99,22 +133,6 @@ void append_ir_node(IRNode** head, IRNode* new_node) {
     }
 }
 
-// Free memory allocated for IR nodes
-static void free_ir_list(IRNode* head) {
-    while (head) {
-        IRNode* temp = head;
-        head = head->next;
-
-        if (temp->code) {
-            free(temp->code);
-        }
-        if (temp->original_code) {
-            free(temp->original_code);
-        }
-        free(temp);
-    }
-}
-
 // Generate a unique name for overloaded functions
 static char* generate_overloaded_name(const char* base_name, ASTNode* parameters) {
     // Allocate memory for the name
@@ -132,10 +150,11 @@ static void append_function_parameters(char* code, size_t code_size, ASTNode* pa
         // Use a default type (e.g., int) for parameters.
         if (param->child_count > 0) {
             // If there is a default value (or initialization), include it.
-            snprintf(param_code, sizeof(param_code), "int %s = %s", param->token.value, param->children[0]->token.value);
+            snprintf(param_code, sizeof(param_code), "int " TOKEN_FMT " = " TOKEN_FMT,
+                TOKEN_ARG(&param->token), TOKEN_ARG(&param->children[0]->token));
         }
         else {
-            snprintf(param_code, sizeof(param_code), "int %s", param->token.value);
+            snprintf(param_code, sizeof(param_code), "int " TOKEN_FMT, TOKEN_ARG(&param->token));
         }
 
         strcat_s(code, code_size, param_code);
@@ -163,21 +182,20 @@ IRNode* allocate_ir_nodes(size_t batch_size) {
 }
 
 // Transpile a function node
-void transpile_function(ASTNode* node, IRNode** ir_list) {
-    char* overloaded_name = generate_overloaded_name(node->token.value, node->children[0]);
+void transpile_function(ASTNode* node, IRBuilder* builder) {
+    char* function_name = token_strdup(&node->token);
+    char* overloaded_name = generate_overloaded_name(function_name, node->children[0]);
     char code[256];
 
     snprintf(code, sizeof(code), "void %s(", overloaded_name);
     append_function_parameters(code, sizeof(code), node->children[0]);
     strcat_s(code, sizeof(code), ") {");
 
-    IRNode* func_node = create_ir_node(code, node->token.line, node->token.column, node->token.value, NULL);
-    append_ir_node(ir_list, func_node);
+    ir_builder_emit_token(builder, code, &node->token, NULL);
 
-    transpile_to_ir(node->children[1], ir_list);
+    transpile_to_ir(node->children[1], builder);
 
-    IRNode* end_node = create_ir_node("}", node->token.line, node->token.column, node->token.value, NULL);
-    append_ir_node(ir_list, end_node);
+    ir_builder_emit_token(builder, "}", &node->token, NULL);
 
     // **Fix:** Retrieve expected function parameters dynamically
     int expected_function_parameters = node->children[0]->child_count;
@@ -187,166 +205,116 @@ void transpile_function(ASTNode* node, IRNode** ir_list) {
     }
 
     free(overloaded_name);
+    free(function_name);
 }
 
-static char* ensure_buffer_space(char* buffer, size_t* buffer_size, size_t additional_space) {
-    if (strlen(buffer) + additional_space >= *buffer_size) {
-        *buffer_size *= 2;
-        buffer = safe_realloc(buffer, *buffer_size);
-        buffer = validate_input(buffer, "Memory reallocation failed in transpile_string_interpolation", 1);
-    }
-    return buffer;
-}
-static void process_embedded_expression(
-    const char* str,
-    int* i,
-    char* code,
-    size_t* buffer_size,
-    IRNode** ir_list,
-    int line,
-    int column
-) {
-    strcat_s(code, *buffer_size, "%s"); // Add placeholder for the embedded expression
-    *i += 2; // Skip the "${"
-
-    char expr[128] = { 0 };
-    int j = 0;
-
-    // Extract the embedded expression
-    while (str[*i] != '}' && str[*i] != '\0') {
-        expr[j++] = str[(*i)++];
+// End of the "${...}" expression starting at input[i] (the '$'): offset of the '}' or of the end
+static int interpolation_end(const char* input, int length, int i) {
+    i += 2;
+    while (i < length && input[i] != '}') i++;
+    return i;
+}
+
+// Transpile a string interpolation node into printf("...%s...\n", expr, ...);
+// The statement is measured first and then written once into a right-sized
+// buffer, so long strings and long embedded expressions cost one pass each.
+void transpile_string_interpolation(ASTNode* node, IRBuilder* builder) {
+    const char* input = token_text(&node->token);
+    int input_length = token_length(&node->token);
+
+    size_t size = sizeof("printf(\"\\n\");");
+    for (int i = 0; i < input_length; i++) {
+        if (input[i] == '$' && i + 1 < input_length && input[i + 1] == '{') {
+            int end = interpolation_end(input, input_length, i);
+            size += 2 + 2 + (end - i - 2);  // "%s", ", " and the expression
+            i = end;  // The loop step skips the '}'
+        }
+        else {
+            size += (input[i] == '"' || input[i] == '\\') ? 2 : 1;
+        }
     }
-    if (str[*i] == '}') (*i)++; // Skip the closing "}"
-
-    // Create an IR node for the embedded expression
-    IRNode* expr_node = create_ir_node(expr, line, column, NULL, NULL);
-    append_ir_node(ir_list, expr_node);
-}
-static void process_regular_character(const char* str, int i, char* code, size_t* buffer_size) {
-    char temp[2] = { str[i], '\0' };
-    strcat_s(code, *buffer_size, temp); // Append the character to the buffer
-}
-
-// Transpile a string interpolation node
-void transpile_string_interpolation(ASTNode* node, IRNode** ir_list) {
-    size_t fmt_size = 256;
-    char* fmt_str = safe_malloc(fmt_size);
-    fmt_str[0] = '\0';
-    strcat_s(fmt_str, fmt_size, "printf(\"");
-
-    // Prepare a separate string to collect the embedded expressions (arguments)
-    size_t args_size = 256;
-    char* args_str = safe_malloc(args_size);
-    args_str[0] = '\0';
-    int arg_count = 0;
-
-    const char* input = node->token.value;
-    for (int i = 0; input[i] != '\0'; i++) {
-        if (input[i] == '$' && input[i + 1] == '{') {
-            // Skip the "${"
-            i += 2;
-
-            // Append a placeholder into the format string
-            fmt_str = ensure_buffer_space(fmt_str, &fmt_size, 3);
-            strcat_s(fmt_str, fmt_size, "%s");
-
-            // Extract the embedded expression (up to the closing '}')
-            char expr_buffer[128] = { 0 };
-            int j = 0;
-            while (input[i] != '}' && input[i] != '\0' && j < (int)(sizeof(expr_buffer) - 1)) {
-                expr_buffer[j++] = input[i++];
-            }
-            expr_buffer[j] = '\0';
-            // (Assume a closing '}' is found; you might add error handling if not.)
 
-            // Append the expression to the arguments list
-            if (arg_count > 0) {
-                args_str = ensure_buffer_space(args_str, &args_size, 3);
-                strcat_s(args_str, args_size, ", ");
-            }
-            args_str = ensure_buffer_space(args_str, &args_size, strlen(expr_buffer) + 1);
-            strcat_s(args_str, args_size, expr_buffer);
-            arg_count++;
+    char* code = safe_malloc(size);
+    char* out = code;
+    memcpy(out, "printf(\"", 8);
+    out += 8;
+
+    // Format string: text with quotes and backslashes escaped, "%s" for each expression
+    for (int i = 0; i < input_length; i++) {
+        if (input[i] == '$' && i + 1 < input_length && input[i + 1] == '{') {
+            *out++ = '%';
+            *out++ = 's';
+            i = interpolation_end(input, input_length, i);
         }
         else {
-            // Append a regular character into the format string.
-            // If the character is a double-quote or a backslash, escape it.
-            if (input[i] == '"' || input[i] == '\\') {
-                fmt_str = ensure_buffer_space(fmt_str, &fmt_size, 2);
-                strcat_s(fmt_str, fmt_size, "\\");
-            }
-            char temp[2] = { input[i], '\0' };
-            fmt_str = ensure_buffer_space(fmt_str, &fmt_size, 2);
-            strcat_s(fmt_str, fmt_size, temp);
+            if (input[i] == '"' || input[i] == '\\') *out++ = '\\';
+            *out++ = input[i];
         }
     }
-    // Close the format string and add a newline.
-    fmt_str = ensure_buffer_space(fmt_str, &fmt_size, 6);
-    strcat_s(fmt_str, fmt_size, "\\n\"");
-
-    // If there are embedded expressions, add a comma and then the arguments.
-    if (arg_count > 0) {
-        fmt_str = ensure_buffer_space(fmt_str, &fmt_size, args_size + 3);
-        strcat_s(fmt_str, fmt_size, ", ");
-        strcat_s(fmt_str, fmt_size, args_str);
+    memcpy(out, "\\n\"", 3);
+    out += 3;
+
+    // Arguments: the embedded expressions in order
+    for (int i = 0; i < input_length; i++) {
+        if (input[i] == '$' && i + 1 < input_length && input[i + 1] == '{') {
+            int end = interpolation_end(input, input_length, i);
+            *out++ = ',';
+            *out++ = ' ';
+            memcpy(out, input + i + 2, end - i - 2);
+            out += end - i - 2;
+            i = end;
+        }
     }
-    fmt_str = ensure_buffer_space(fmt_str, &fmt_size, 3);
-    strcat_s(fmt_str, fmt_size, ");");
+    memcpy(out, ");", 3);
 
-    IRNode* ir_node = create_ir_node(fmt_str, node->token.line, node->token.column, node->token.value, NULL);
-    append_ir_node(ir_list, ir_node);
+    ir_builder_emit_token(builder, code, &node->token, NULL);
 
-    free(fmt_str);
-    free(args_str);
+    free(code);
 }
 
-static void add_struct_fields(ASTNode* node, IRNode** ir_list) {
+static void add_struct_fields(ASTNode* node, IRBuilder* builder) {
     for (int i = 0; i < node->child_count; i++) {
+        const ASTNode* field = node->children[i];
+        if (field->type == NODE_ERROR) continue;  // Reported by the parser
         char field_code[128];
-        snprintf(field_code, sizeof(field_code), "%s %s;", node->children[i]->token.type, node->children[i]->token.value);
-
-        IRNode* field_node = create_ir_node(
-            field_code,
-            node->children[i]->token.line,
-            node->children[i]->token.column,
-            node->children[i]->token.value,
-            NULL
-        );
+        // The parser resolved the field's type; anything but float defaults to int
+        snprintf(field_code, sizeof(field_code), "%s " TOKEN_FMT ";",
+            field->inferred_type == TYPE_FLOAT ? "float" : "int", TOKEN_ARG(&field->token));
 
-        append_ir_node(ir_list, field_node);
+        ir_builder_emit_token(builder, field_code, &field->token, NULL);
     }
 }
 
 // Transpile a struct node
-static void transpile_struct(ASTNode* node, IRNode** ir_list) {
+static void transpile_struct(ASTNode* node, IRBuilder* builder) {
     char code[256];
-    snprintf(code, sizeof(code), "struct %s {", node->token.value);
+    snprintf(code, sizeof(code), "struct " TOKEN_FMT " {", TOKEN_ARG(&node->token));
 
-    IRNode* struct_node = create_ir_node(code, node->token.line, node->token.column, node->token.value, NULL);
-    append_ir_node(ir_list, struct_node);
+    ir_builder_emit_token(builder, code, &node->token, NULL);
 
     // Add fields to the struct
-    add_struct_fields(node, ir_list);
+    add_struct_fields(node, builder);
 
-    IRNode* end_node = create_ir_node("};", node->token.line, node->token.column, node->token.value, NULL);
-    append_ir_node(ir_list, end_node);
+    ir_builder_emit_token(builder, "};", &node->token, NULL);
 }
-static char* initialize_code_buffer() {
-    char* code = validate_input(safe_malloc(1), "Memory allocation failed for code buffer", 1);
-    code[0] = '\0';
-    return code;
-}
-
+// Join the IR code, one line per node. The output is measured first and then
+// written once, so joining costs one pass over the code rather than a realloc
+// and a strlen of everything so far per node.
 static char* process_ir_list(IRNode* ir_list) {
-    char* code = initialize_code_buffer();
-    IRNode* current = ir_list;
-
-    while (current) {
-        code = append_code(code, current->code);
-        code = append_code(code, "\n"); // Add a newline for readability
-        current = current->next;
+    size_t size = 1;
+    for (IRNode* current = ir_list; current; current = current->next) {
+        size += strlen(current->code) + 1;
     }
 
+    char* code = validate_input(safe_malloc(size), "Memory allocation failed for code buffer", 1);
+    char* out = code;
+    for (IRNode* current = ir_list; current; current = current->next) {
+        size_t length = strlen(current->code);
+        memcpy(out, current->code, length);
+        out += length;
+        *out++ = '\n'; // Add a newline for readability
+    }
+    *out = '\0';
     return code;
 }
 static char* apply_language_boilerplate(const char* lang, char* code) {
@@ -374,16 +342,17 @@ char* generate_code_from_ir(IRNode* ir_list, const char* lang) {
 // Transpile the AST into target code
 char* transpile(ASTNode* tree) {
     // Initialize the IR list
-    IRNode* ir_list = NULL;
+    IRBuilder builder;
+    ir_builder_init(&builder);
 
     // Generate IR from the AST
-    transpile_to_ir(tree, &ir_list);
+    transpile_to_ir(tree, &builder);
 
     // Convert IR to code
-    char* code = generate_code_from_ir(ir_list, "c");
+    char* code = generate_code_from_ir(builder.head, "c");
 
     // Free the IR list
-    free_ir_list(ir_list);
+    ir_builder_free(&builder);
 
     return code;
 }
@@ -394,71 +363,53 @@ static void handle_unsupported_node(ASTNode* node) {
         node->type, node->token.line, node->token.column);
 }
 
-static void process_block_children(ASTNode* block_node, IRNode** ir_list, Scope* block_scope) {
-    for (int i = 0; i < block_node->child_count; i++) {
-        ASTNode* child = block_node->children[i];
-        if (!child) {
-            fprintf(stderr, "Warning: Null child in block at index %d (line %d)\n",
-                i, block_node->token.line);
-            continue;
-        }
-
-        printf("Processing child %d of type %d\n", i, child->type);
-        transpile_to_ir_with_scope(child, ir_list, block_scope); // Recursively process children
-    }
-}
-static void add_block_comments(ASTNode* block_node, IRNode** ir_list, const char* comment_prefix, Scope* scope) {
+static void add_block_comments(ASTNode* block_node, IRBuilder* builder, const char* comment_prefix, Scope* scope) {
     char comment[256];
     snprintf(comment, sizeof(comment), "%s block (line %d, column %d)",
         comment_prefix, block_node->token.line, block_node->token.column);
-    IRNode* comment_node = create_ir_node(comment, block_node->token.line, block_node->token.column, NULL, scope);
-    append_ir_node(ir_list, comment_node);
+    ir_builder_emit(builder, comment, block_node->token.line, block_node->token.column, NULL, scope);
 }
 
-// transpile_block function
-void transpile_block(ASTNode* block_node, IRNode** ir_list, Scope* current_scope) {
-    if (!block_node || block_node->type != NODE_BLOCK) {
-        fprintf(stderr, "Error: Invalid block node (type=%d, expected=%d)\n",
-            block_node ? block_node->type : -1, NODE_BLOCK);
-        return;
-    }
-
+// Open a block: its scope and start comment. Returns the block scope, NULL on failure.
+static Scope* begin_block(ASTNode* block_node, IRBuilder* builder, Scope* current_scope) {
     printf("Transpiling block at line %d, column %d\n", block_node->token.line, block_node->token.column);
 
     Scope* block_scope = create_scope("block_scope", current_scope);
     if (!block_scope) {
         fprintf(stderr, "Error: Failed to create scope for block at line %d, column %d\n",
             block_node->token.line, block_node->token.column);
-        return;
+        return NULL;
     }
 
     // Add start comment
-    add_block_comments(block_node, ir_list, "// Start of", block_scope);
+    add_block_comments(block_node, builder, "// Start of", block_scope);
 
     // Handle empty block
     if (block_node->child_count == 0) {
         printf("Warning: Empty block at line %d, column %d\n",
             block_node->token.line, block_node->token.column);
     }
+    return block_scope;
+}
 
-    // Process children
-    process_block_children(block_node, ir_list, block_scope);
-
+// Close a block once all of its children are transpiled
+static void end_block(ASTNode* block_node, IRBuilder* builder, Scope* block_scope) {
     // Add end comment
-    add_block_comments(block_node, ir_list, "// End of", block_scope);
+    add_block_comments(block_node, builder, "// End of", block_scope);
 
     free_scope(block_scope);
 
     printf("Finished transpiling block at line %d, column %d\n",
         block_node->token.line, block_node->token.column);
 }
-static void process_ast_node_with_scope(ASTNode* node, IRNode** ir_list, Scope* current_scope) {
+
+static void process_ast_node_with_scope(ASTNode* node, IRBuilder* builder, Scope* current_scope) {
     Achievement achievements[ACH_MILESTONES_COUNT];
     initialize_achievements(achievements);
     switch (node->type) {
     case NODE_FUNCTION: {
         Scope* function_scope = create_scope("function_scope", current_scope);
-        transpile_function(node, ir_list);
+        transpile_function(node, builder);
         if (!achievements[ACH_FIRST_FUNCTION].unlocked) {
             unlock_achievement(achievements, ACH_FIRST_FUNCTION);
         }
@@ -466,18 +417,17 @@ static void process_ast_node_with_scope(ASTNode* node, IRNode** ir_list, Scope*
         break;
     }
     case NODE_STRING_INTERPOLATION:
-        transpile_string_interpolation(node, ir_list);
+        transpile_string_interpolation(node, builder);
         break;
     case NODE_STRUCT: {
         Scope* struct_scope = create_scope("struct_scope", current_scope);
-        transpile_struct(node, ir_list);
+        transpile_struct(node, builder);
         free_scope(struct_scope);
         break;
     }
-    case NODE_BLOCK:
-        transpile_block(node, ir_list, current_scope);
+    case NODE_ERROR:  // Reported by the parser; nothing to emit
         break;
-    default:
+    default:  // Blocks are opened and closed by transpile_walk()
         fprintf(stderr, "Warning: Unsupported node type %d at line %d, column %d\n",
             node->type, node->token.line, node->token.column);
         handle_unsupported_node(node);
@@ -485,13 +435,97 @@ static void process_ast_node_with_scope(ASTNode* node, IRNode** ir_list, Scope*
     }
 }
 
+#define TRANSPILE_LOCAL_STACK 32   // Open nodes held on the C stack before the walk allocates
+
+// Node of the IR walk still being visited; a block keeps its frame (and scope)
+// until its last child is done
+typedef struct {
+    ASTNode* node;
+    Scope* scope;       // Scope the children are transpiled in; a block's own scope once opened
+    int next_child;     // -1 until the node itself is processed
+} TranspileFrame;
+
+// Whether the node's handler in process_ast_node_with_scope() emits its children
+// itself: a function its body, a struct its fields, an interpolated string its
+// expressions. The walk must not visit them again.
+static int emits_children(const ASTNode* node) {
+    return node->type == NODE_FUNCTION || node->type == NODE_STRUCT || node->type == NODE_STRING_INTERPOLATION;
+}
+
+// Pre-order walk with an explicit stack, so nesting depth is bounded by the heap,
+// not the C stack. Each node is processed once; a block's children are transpiled
+// in the block scope between its start and end comments.
+static void transpile_walk(ASTNode* root, IRBuilder* builder, Scope* scope) {
+    TranspileFrame local[TRANSPILE_LOCAL_STACK];
+    TranspileFrame* stack = local;
+    int capacity = TRANSPILE_LOCAL_STACK, count = 0;
+    stack[count++] = (TranspileFrame){ root, scope, -1 };
+
+    while (count > 0) {
+        TranspileFrame* frame = &stack[count - 1];
+        ASTNode* node = frame->node;
+        int is_block = node->type == NODE_BLOCK;
+        if (frame->next_child < 0) {
+            if (is_block) {
+                frame->scope = begin_block(node, builder, frame->scope);
+                if (!frame->scope) {
+                    count--;
+                    continue;
+                }
+            } else {
+                process_ast_node_with_scope(node, builder, frame->scope);
+            }
+            frame->next_child = emits_children(node) ? node->child_count : 0;
+        }
+        if (frame->next_child == node->child_count) {
+            if (is_block) end_block(node, builder, frame->scope);
+            count--;
+            continue;
+        }
 
-static void transpile_to_ir(ASTNode* node, IRNode** ir_list) {
-    transpile_to_ir_with_scope(node, ir_list, NULL); // Call the overloaded version with NULL scope
+        int i = frame->next_child++;
+        ASTNode* child = node->children[i];
+        Scope* child_scope = frame->scope;
+        if (!child) {
+            if (is_block) {
+                fprintf(stderr, "Warning: Null child in block at index %d (line %d)\n",
+                    i, node->token.line);
+            }
+            continue;
+        }
+        if (is_block) printf("Processing child %d of type %d\n", i, child->type);
+
+        if (count == capacity) {
+            capacity *= 2;
+            if (stack == local) {
+                stack = safe_malloc(capacity * sizeof(TranspileFrame));
+                memcpy(stack, local, sizeof(local));
+            } else {
+                stack = safe_realloc(stack, capacity * sizeof(TranspileFrame));
+            }
+        }
+        stack[count++] = (TranspileFrame){ child, child_scope, -1 };
+    }
+    if (stack != local) free(stack);
 }
 
-// Transpile the AST node into IR recursively
-static void transpile_to_ir_with_scope(ASTNode* node, IRNode** ir_list, Scope* current_scope) {
+// transpile_block function
+void transpile_block(ASTNode* block_node, IRBuilder* builder, Scope* current_scope) {
+    if (!block_node || block_node->type != NODE_BLOCK) {
+        fprintf(stderr, "Error: Invalid block node (type=%d, expected=%d)\n",
+            block_node ? block_node->type : -1, NODE_BLOCK);
+        return;
+    }
+    transpile_walk(block_node, builder, current_scope);
+}
+
+
+static void transpile_to_ir(ASTNode* node, IRBuilder* builder) {
+    transpile_to_ir_with_scope(node, builder, NULL); // Call the overloaded version with NULL scope
+}
+
+// Transpile the AST node into IR
+static void transpile_to_ir_with_scope(ASTNode* node, IRBuilder* builder, Scope* current_scope) {
     if (!node) return;
 
     if (!current_scope) {
@@ -502,44 +536,34 @@ static void transpile_to_ir_with_scope(ASTNode* node, IRNode** ir_list, Scope* c
         current_scope = global_scope;
     }
 
-    // Process the current node using the new function
-    process_ast_node_with_scope(node, ir_list, current_scope);
-
-    // Recursively process children
-    for (int i = 0; i < node->child_count; i++) {
-        transpile_to_ir_with_scope(node->children[i], ir_list, current_scope);
-    }
-
+    transpile_walk(node, builder, current_scope);
 }
-static void add_record_fields(ASTNode* node, IRNode** ir_list) {
+static void add_record_fields(ASTNode* node, IRBuilder* builder) {
     char buffer[512];
     for (int i = 0; i < node->child_count; i++) {
         ASTNode* field = node->children[i];
-        snprintf(buffer, sizeof(buffer), "    int %s;", field->token.value); // Default to int
-        IRNode* field_node = create_ir_node(buffer, field->token.line, field->token.column, NULL, NULL);
-        append_ir_node(ir_list, field_node);
+        snprintf(buffer, sizeof(buffer), "    int " TOKEN_FMT ";", TOKEN_ARG(&field->token)); // Default to int
+        ir_builder_emit(builder, buffer, field->token.line, field->token.column, NULL, NULL);
     }
 }
 
 
 //This function converts record AST nodes into C struct definitions.
-void transpile_record(ASTNode* node, IRNode** ir_list) {
+void transpile_record(ASTNode* node, IRBuilder* builder) {
     if (node->type != NODE_STRUCT) return;
 
     char buffer[512];
-    snprintf(buffer, sizeof(buffer), "typedef struct %s {", node->token.value);
+    snprintf(buffer, sizeof(buffer), "typedef struct " TOKEN_FMT " {", TOKEN_ARG(&node->token));
 
     // Create the struct definition
-    IRNode* record_node = create_ir_node(buffer, node->token.line, node->token.column, NULL, NULL);
-    append_ir_node(ir_list, record_node);
+    ir_builder_emit(builder, buffer, node->token.line, node->token.column, NULL, NULL);
 
     // Add fields to the struct
-    add_record_fields(node, ir_list);
+    add_record_fields(node, builder);
 
     // End the struct definition
-    snprintf(buffer, sizeof(buffer), "} %s;", node->token.value);
-    IRNode* end_record_node = create_ir_node(buffer, node->token.line, node->token.column, NULL, NULL);
-    append_ir_node(ir_list, end_record_node);
+    snprintf(buffer, sizeof(buffer), "} " TOKEN_FMT ";", TOKEN_ARG(&node->token));
+    ir_builder_emit(builder, buffer, node->token.line, node->token.column, NULL, NULL);
 }
 
 
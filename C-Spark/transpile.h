@@ -2,6 +2,7 @@
 #define TRANSPILE_H
 
 #include "parser.h"
+#include "arena.h"
 
 // Scope structure
 typedef struct Scope {
@@ -23,6 +24,16 @@ typedef struct IRNode {
     char* type;
 } IRNode;
 
+// IR list under construction. Appends go through the tail pointer and nodes and
+// their strings come from the arena, so emitting n nodes costs O(n) and the
+// whole list is released at once by ir_builder_free().
+typedef struct {
+    IRNode* head;         // First node, NULL while the list is empty
+    IRNode* tail;         // Last node
+    int count;            // Nodes appended
+    Arena arena;          // Owns the nodes emitted through the builder
+} IRBuilder;
+
 // Public API functions
 char* safe_strdup(const char* str);                      // Safe string duplication
 char* append_code(char* dest, const char* src);          // Append strings dynamically
@@ -30,14 +41,17 @@ char* transpile(ASTNode* tree);                          // Transpile the AST in
 void handle_unsupported_node(ASTNode* node);             // Error handler for unsupported nodes
 void add_indentation(char** code, int level);            // Add indentation for code readability
 IRNode* create_ir_node(const char* code, int line, int column, const char* original_code); // Create a new IR node
-void append_ir_node(IRNode** head, IRNode* new_node);    // Append an IR node to the IR list
+void append_ir_node(IRNode** head, IRNode* new_node);    // Append an IR node to a list kept without a builder (walks to the tail)
+void ir_builder_init(IRBuilder* builder);                // Start an empty IR list
+IRNode* ir_builder_emit(IRBuilder* builder, const char* code, int line, int column, const char* original_code, Scope* scope); // Append a node; the strings are copied into the builder
+void ir_builder_free(IRBuilder* builder);                // Release the list and every node emitted into it
 void free_ir_list(IRNode* head);                         // Free the IR list
 char* generate_overloaded_name(const char* base_name, ASTNode* parameters); // Generate a unique name for overloaded functions
-void transpile_function(ASTNode* node, IRNode** ir_list);// Transpile a function node
-void transpile_string_interpolation(ASTNode* node, IRNode** ir_list); // Transpile string interpolation
-void transpile_struct(ASTNode* node, IRNode** ir_list);  // Transpile a struct node
-void transpile_record(ASTNode* node, IRNode** ir_list);  // Transpile a record node
-void transpile_block(ASTNode* block_node, IRNode** ir_list, Scope* current_scope); // Transpile a block node
+void transpile_function(ASTNode* node, IRBuilder* builder);// Transpile a function node
+void transpile_string_interpolation(ASTNode* node, IRBuilder* builder); // Transpile string interpolation
+void transpile_struct(ASTNode* node, IRBuilder* builder);  // Transpile a struct node
+void transpile_record(ASTNode* node, IRBuilder* builder);  // Transpile a record node
+void transpile_block(ASTNode* block_node, IRBuilder* builder, Scope* current_scope); // Transpile a block node
 Scope* create_scope(const char* name, Scope* parent);    // Create a new scope
 void free_scope(Scope* scope);                           // Free a scope
 char* generate_code_from_ir(IRNode* ir_list, const char* lang); // Generate code from IR
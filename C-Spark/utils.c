@@ -34,6 +34,18 @@ char* utils_safe_strdup(const char* str) {
     return copy;
 }
 
+// Safe strndup implementation (copies exactly `length` bytes and NUL-terminates)
+char* utils_safe_strndup(const char* str, size_t length) {
+    if (!str) {
+        fprintf(stderr, "Error: Attempted to duplicate a NULL string.\n");
+        return NULL;
+    }
+    char* copy = safe_malloc(length + 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
 // Centralized error logging
 void utils_log_error(const char* message, int line, int column) {
     fprintf(stderr, "Error: %s at line %d, column %d\n", message, line, column);
@@ -45,4 +57,13 @@ char* utils_append_code(char* dest, const char* src) {
     dest = safe_realloc(dest, new_size);
     strcat_s(dest, new_size, src);
     return dest;
-}
\ No newline at end of file
+}
+
+// FNV-1a hash of a span of text
+unsigned int utils_hash_span(const char* text, int length) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
@@ -10,6 +10,7 @@ void* safe_realloc(void* ptr, size_t size);
 
 // Safe string duplication
 char* utils_safe_strdup(const char* str);
+char* utils_safe_strndup(const char* str, size_t length);
 
 // Centralized error logging
 void utils_log_error(const char* message, int line, int column);
@@ -17,4 +18,7 @@ void utils_log_error(const char* message, int line, int column);
 // String appending with dynamic memory
 char* utils_append_code(char* dest, const char* src);
 
+// FNV-1a hash of `length` bytes of text, for the lexer's and interner's hash tables
+unsigned int utils_hash_span(const char* text, int length);
+
 #endif // UTILS_H